@@ -0,0 +1,533 @@
+// throughput benchmarks for the NBeeTea library.
+//
+// usage: NBeeTeaBench [--csv] [--min-time seconds] [--scale n] [filter]
+// filter is matched against "corpus/operation", e.g. "bigtest" or "/deserialize".
+// --scale multiplies the size of the generated corpora
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include "NBT.h"
+#include "NBTView.h"
+#include "NBTDocument.h"
+#include "NBTTape.h"
+#include "NBTStreamParser.h"
+#include "Compression.h"
+#include "ThreadPool.h"
+
+#ifndef NBT_DATA_DIR
+#define NBT_DATA_DIR "lib/nbtdata"
+#endif
+
+// every allocation made by the process, so per-operation allocation counts can be reported. every replaceable
+// form is defined here, the library's defaults aren't guaranteed to forward to the plain ones, and a mismatched pair
+// (counted malloc, library free) would be undefined
+static std::atomic<unsigned long> allocationCount{0};
+
+static void *countedAllocate(std::size_t size, std::size_t alignment) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size);
+
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void *countedAllocateOrThrow(std::size_t size, std::size_t alignment) {
+    if (void *pointer = countedAllocate(size, alignment))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size) {
+    return countedAllocateOrThrow(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return countedAllocateOrThrow(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return countedAllocateOrThrow(size, (std::size_t) alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return countedAllocateOrThrow(size, (std::size_t) alignment);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, (std::size_t) alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, (std::size_t) alignment);
+}
+
+// malloc and aligned_alloc memory both goes back through free
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(pointer);
+}
+
+struct Corpus {
+    std::string name;
+    std::string raw; // uncompressed
+    std::string compressed; // gzip
+    NBT tree;
+    unsigned long nodes = 0;
+};
+
+static unsigned long countNodes(const NBT &nbt) {
+    unsigned long nodes = 1;
+    for (const NBT &child: nbt.listChildren) {
+        nodes += countNodes(child);
+    }
+    for (const auto &element: nbt.compoundElements) {
+        nodes += countNodes(element.second);
+    }
+    return nodes;
+}
+
+static bool readFile(const std::string &path, std::string &out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    out = contents.str();
+    return true;
+}
+
+static void addCorpus(std::vector<Corpus> &corpora, const std::string &name, std::string bytes) {
+    Corpus corpus;
+    corpus.name = name;
+
+    std::string inflated;
+    if (decompressBuffer(bytes.data(), bytes.size(), CompressionFormat::GZIP, inflated)) {
+        corpus.raw = std::move(inflated);
+        corpus.compressed = std::move(bytes);
+    } else {
+        corpus.raw = std::move(bytes);
+        compressBuffer(corpus.raw.data(), corpus.raw.size(), CompressionFormat::GZIP, corpus.compressed);
+    }
+
+    corpus.tree = NBT::deserialize(corpus.raw.data(), corpus.raw.size());
+    corpus.nodes = countNodes(corpus.tree);
+    corpora.push_back(std::move(corpus));
+}
+
+static void addGeneratedCorpus(std::vector<Corpus> &corpora, const std::string &name, const NBT &root) {
+    std::vector<char> serialized = NBT::serialize(root);
+    addCorpus(corpora, name, std::string(serialized.begin(), serialized.end()));
+}
+
+// 4 * scale chains of 256 nested compounds, each level holding an int and a string
+static NBT deepCorpus(signed int scale) {
+    NBT chains(TAG_List);
+    chains.listType = TAG_Compound;
+
+    for (signed int chain = 0; chain < 4 * scale; chain++) {
+        NBT node(TAG_Compound);
+        for (signed int depth = 0; depth < 256; depth++) {
+            NBT parent(TAG_Compound);
+            parent.addCompoundChild("depth", NBT(TAG_Int, depth));
+            parent.addCompoundChild("label", NBT(TAG_String, std::string("level")));
+            parent.addCompoundChild("child", std::move(node));
+            node = std::move(parent);
+        }
+        chains.addListChild(std::move(node));
+    }
+
+    NBT root(TAG_Compound);
+    root.name = "";
+    root.addCompoundChild("chains", std::move(chains));
+    return root;
+}
+
+// a single compound with 2000 * scale elements of mixed types
+static NBT wideCorpus(signed int scale) {
+    NBT root(TAG_Compound);
+    root.name = "";
+
+    for (signed int i = 0; i < 2000 * scale; i++) {
+        std::string key = "key" + std::to_string(i);
+        switch (i % 4) {
+            case 0:
+                root.addCompoundChild(key, NBT(TAG_Int, i));
+                break;
+            case 1:
+                root.addCompoundChild(key, NBT(TAG_Long, (signed long) i * 1000003));
+                break;
+            case 2:
+                root.addCompoundChild(key, NBT(TAG_Double, i * 0.5));
+                break;
+            default:
+                root.addCompoundChild(key, NBT(TAG_String, "value" + std::to_string(i)));
+                break;
+        }
+    }
+    return root;
+}
+
+// 8 Long_Arrays of 64k * scale elements (4 MiB of payload per scale step)
+static NBT longArrayCorpus(signed int scale) {
+    NBT root(TAG_Compound);
+    root.name = "";
+
+    for (signed int array = 0; array < 8; array++) {
+        std::vector<long> values(64 * 1024 * (unsigned long) scale);
+        for (unsigned long i = 0; i < values.size(); i++) {
+            values[i] = (signed long) (i * 0x9E3779B97F4A7C15ul) >> array;
+        }
+        root.addCompoundChild("states" + std::to_string(array), NBT(TAG_Long_Array, values));
+    }
+    return root;
+}
+
+// 2000 * scale inventory-like compounds in one list
+static NBT compoundListCorpus(signed int scale) {
+    NBT items(TAG_List);
+    items.listType = TAG_Compound;
+    items.reserveChildren(2000 * scale);
+
+    for (signed int i = 0; i < 2000 * scale; i++) {
+        NBT tag(TAG_Compound);
+        tag.addCompoundChild("Damage", NBT(TAG_Int, i % 250));
+
+        NBT item(TAG_Compound);
+        item.addCompoundChild("id", NBT(TAG_String, std::string("minecraft:diamond_pickaxe")));
+        item.addCompoundChild("Count", NBT(TAG_Byte, (char) (i % 64 + 1)));
+        item.addCompoundChild("Slot", NBT(TAG_Byte, (char) (i % 36)));
+        item.addCompoundChild("tag", std::move(tag));
+        items.addListChild(std::move(item));
+    }
+
+    NBT root(TAG_Compound);
+    root.name = "";
+    root.addCompoundChild("Items", std::move(items));
+    return root;
+}
+
+// discards everything, for timing print() without a terminal in the way
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize count) override {
+        return count;
+    }
+};
+
+// keeps results alive so the optimizer can't drop the work
+static volatile unsigned long sink;
+
+static unsigned long sumValues(NBT &nbt) {
+    switch (nbt.tagID) {
+        case TAG_Byte:
+            return (unsigned long) nbt.getByte();
+        case TAG_Short:
+            return (unsigned long) nbt.getShort();
+        case TAG_Int:
+            return (unsigned long) nbt.getInt();
+        case TAG_Long:
+            return (unsigned long) nbt.getLong();
+        case TAG_Float:
+            return (unsigned long) nbt.getFloat();
+        case TAG_Double:
+            return (unsigned long) nbt.getDouble();
+        case TAG_String:
+            return nbt.getString().size();
+        case TAG_Byte_Array:
+            return nbt.getByteVector().size();
+        case TAG_Int_Array: {
+            std::vector<signed int> values = nbt.getIntVector();
+            return values.empty() ? 0 : (unsigned long) values.back();
+        }
+        case TAG_Long_Array: {
+            std::vector<signed long> values = nbt.getLongVector();
+            return values.empty() ? 0 : (unsigned long) values.back();
+        }
+        case TAG_List: {
+            unsigned long sum = 0;
+            for (NBT &child: nbt.listChildren) {
+                sum += sumValues(child);
+            }
+            return sum;
+        }
+        case TAG_Compound: {
+            unsigned long sum = 0;
+            for (auto &element: nbt.compoundElements) {
+                sum += sumValues(element.second);
+            }
+            return sum;
+        }
+        default:
+            return 0;
+    }
+}
+
+static unsigned long sumView(const NBTView &view) {
+    switch (view.tagID()) {
+        case TAG_Byte:
+            return (unsigned long) view.getByte();
+        case TAG_Short:
+            return (unsigned long) view.getShort();
+        case TAG_Int:
+            return (unsigned long) view.getInt();
+        case TAG_Long:
+            return (unsigned long) view.getLong();
+        case TAG_Float:
+            return (unsigned long) view.getFloat();
+        case TAG_Double:
+            return (unsigned long) view.getDouble();
+        case TAG_String:
+            return view.getString().size();
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array:
+            return view.arraySize();
+        case TAG_List:
+        case TAG_Compound: {
+            unsigned long sum = 0;
+            for (const NBTView &child: view) {
+                sum += sumView(child);
+            }
+            return sum;
+        }
+        default:
+            return 0;
+    }
+}
+
+struct Operation {
+    std::string name;
+    std::function<void(Corpus &)> run;
+};
+
+static std::vector<Operation> operations() {
+    return {
+            {"deserialize",    [](Corpus &corpus) {
+                NBT tree = NBT::deserialize(corpus.raw.data(), corpus.raw.size());
+                sink = tree.compoundElements.size();
+            }},
+            {"deserialize-gz", [](Corpus &corpus) {
+                NBT tree = NBT::deserialize(corpus.compressed.data(), corpus.compressed.size());
+                sink = tree.compoundElements.size();
+            }},
+            {"deserialize-parallel", [](Corpus &corpus) {
+                static ThreadPool pool;
+                NBT tree = NBT::deserialize(corpus.raw.data(), corpus.raw.size(), pool);
+                sink = tree.compoundElements.size();
+            }},
+            {"document",       [](Corpus &corpus) {
+                static NBTDocument document;
+                sink = document.parse(corpus.raw.data(), corpus.raw.size()).childrenCount();
+            }},
+            {"tape",           [](Corpus &corpus) {
+                static NBTTape tape;
+                tape.build(corpus.raw.data(), corpus.raw.size());
+                sink = tape.size();
+            }},
+            {"stream",         [](Corpus &corpus) {
+                NBTHandler handler;
+                NBTStreamParser parser(handler);
+                sink = parser.feed(corpus.raw.data(), corpus.raw.size()) && parser.finish();
+            }},
+            {"view-walk",      [](Corpus &corpus) {
+                sink = sumView(NBTView::root(corpus.raw));
+            }},
+            {"access",         [](Corpus &corpus) {
+                sink = sumValues(corpus.tree);
+            }},
+            {"serialize",      [](Corpus &corpus) {
+                sink = NBT::serialize(corpus.tree).size();
+            }},
+            {"serialize-gz",   [](Corpus &corpus) {
+                sink = NBT::serialize(corpus.tree, true).size();
+            }},
+            {"serialize-gz-parallel", [](Corpus &corpus) {
+                static ThreadPool pool;
+                sink = NBT::serialize(corpus.tree, ParallelCompressionOptions(), pool).size();
+            }},
+            {"gzip",           [](Corpus &corpus) {
+                static std::string out;
+                compressBuffer(corpus.raw.data(), corpus.raw.size(), CompressionFormat::GZIP, out);
+                sink = out.size();
+            }},
+            {"gunzip",         [](Corpus &corpus) {
+                static std::string out;
+                decompressBuffer(corpus.compressed.data(), corpus.compressed.size(), CompressionFormat::GZIP, out);
+                sink = out.size();
+            }},
+            {"print",          [](Corpus &corpus) {
+                NullBuffer discard;
+                std::streambuf *previous = std::cout.rdbuf(&discard);
+                corpus.tree.print();
+                std::cout.rdbuf(previous);
+            }},
+    };
+}
+
+struct Result {
+    double seconds; // median per run
+    unsigned long runs;
+    double allocations; // per run
+};
+
+static Result measure(const Operation &operation, Corpus &corpus, double minSeconds) {
+    typedef std::chrono::steady_clock Clock;
+
+    // warm up caches, static buffers and lazily picked kernels
+    operation.run(corpus);
+
+    std::vector<double> times;
+    unsigned long allocationsBefore = allocationCount.load();
+    Clock::time_point start = Clock::now();
+
+    while (times.size() < 3 || std::chrono::duration<double>(Clock::now() - start).count() < minSeconds) {
+        Clock::time_point runStart = Clock::now();
+        operation.run(corpus);
+        times.push_back(std::chrono::duration<double>(Clock::now() - runStart).count());
+    }
+
+    unsigned long allocations = allocationCount.load() - allocationsBefore;
+    std::nth_element(times.begin(), times.begin() + (long) times.size() / 2, times.end());
+
+    return {times[times.size() / 2], times.size(), (double) allocations / (double) times.size()};
+}
+
+int main(int argc, char **argv) {
+    bool csv = false;
+    double minSeconds = 0.5;
+    signed int scale = 1;
+    std::string filter;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--csv") {
+            csv = true;
+        } else if (argument == "--min-time" && i + 1 < argc) {
+            minSeconds = std::stod(argv[++i]);
+        } else if (argument == "--scale" && i + 1 < argc) {
+            scale = std::max(std::stoi(argv[++i]), 1);
+        } else if (argument == "--help" || argument == "-h") {
+            std::cout << "usage: " << argv[0] << " [--csv] [--min-time seconds] [--scale n] [filter]" << std::endl;
+            return 0;
+        } else {
+            filter = argument;
+        }
+    }
+
+    std::vector<Corpus> corpora;
+    for (const char *fixture: {"bigtest.nbt", "Player-nan-value.dat", "hello_world.nbt"}) {
+        std::string bytes;
+        if (!readFile(std::string(NBT_DATA_DIR) + "/" + fixture, bytes)) {
+            std::cerr << "missing fixture " << fixture << " (looked in " << NBT_DATA_DIR << ")" << std::endl;
+            return 1;
+        }
+        addCorpus(corpora, fixture, std::move(bytes));
+    }
+    addGeneratedCorpus(corpora, "deep-nesting", deepCorpus(scale));
+    addGeneratedCorpus(corpora, "wide-compound", wideCorpus(scale));
+    addGeneratedCorpus(corpora, "long-arrays", longArrayCorpus(scale));
+    addGeneratedCorpus(corpora, "compound-list", compoundListCorpus(scale));
+
+    if (csv) {
+        std::cout << "corpus,operation,bytes,nodes,runs,seconds,mb_per_s,nodes_per_s,allocations" << std::endl;
+    } else {
+        std::cout << std::left << std::setw(22) << "corpus" << std::setw(16) << "operation" << std::right
+                  << std::setw(12) << "MB/s" << std::setw(14) << "Mnodes/s" << std::setw(14) << "allocs/doc"
+                  << std::setw(12) << "ms/doc" << std::endl;
+    }
+
+    for (Corpus &corpus: corpora) {
+        for (const Operation &operation: operations()) {
+            std::string label = corpus.name + "/" + operation.name;
+            if (!filter.empty() && label.find(filter) == std::string::npos)
+                continue;
+
+            Result result = measure(operation, corpus, minSeconds);
+            double megabytes = (double) corpus.raw.size() / (1024.0 * 1024.0);
+
+            if (csv) {
+                std::cout << corpus.name << "," << operation.name << "," << corpus.raw.size() << "," << corpus.nodes
+                          << "," << result.runs << "," << result.seconds << "," << megabytes / result.seconds << ","
+                          << (double) corpus.nodes / result.seconds << "," << result.allocations << std::endl;
+            } else {
+                std::cout << std::left << std::setw(22) << corpus.name << std::setw(16) << operation.name
+                          << std::right << std::fixed << std::setprecision(1) << std::setw(12)
+                          << megabytes / result.seconds << std::setw(14) << std::setprecision(2)
+                          << (double) corpus.nodes / result.seconds / 1e6 << std::setw(14) << std::setprecision(1)
+                          << result.allocations << std::setw(12) << std::setprecision(3) << result.seconds * 1000
+                          << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// helpers for reading/writing big (and little) endian values straight out of (or into) a byte buffer
+
+template<unsigned long Size>
+struct UnsignedOfSize;
+
+template<>
+struct UnsignedOfSize<1> {
+    using type = uint8_t;
+};
+
+template<>
+struct UnsignedOfSize<2> {
+    using type = uint16_t;
+};
+
+template<>
+struct UnsignedOfSize<4> {
+    using type = uint32_t;
+};
+
+template<>
+struct UnsignedOfSize<8> {
+    using type = uint64_t;
+};
+
+inline uint8_t byteSwap(uint8_t val) {
+    return val;
+}
+
+inline uint16_t byteSwap(uint16_t val) {
+    return __builtin_bswap16(val);
+}
+
+inline uint32_t byteSwap(uint32_t val) {
+    return __builtin_bswap32(val);
+}
+
+inline uint64_t byteSwap(uint64_t val) {
+    return __builtin_bswap64(val);
+}
+
+template<typename T>
+inline T readBigEndian(const char *bytes) {
+    typename UnsignedOfSize<sizeof(T)>::type raw;
+    std::memcpy(&raw, bytes, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    raw = byteSwap(raw);
+#endif
+
+    T value;
+    std::memcpy(&value, &raw, sizeof(T));
+    return value;
+}
+
+template<typename T>
+inline void writeBigEndian(char *bytes, const T &value) {
+    typename UnsignedOfSize<sizeof(T)>::type raw;
+    std::memcpy(&raw, &value, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    raw = byteSwap(raw);
+#endif
+
+    std::memcpy(bytes, &raw, sizeof(T));
+}
+
+template<typename T>
+inline T readLittleEndian(const char *bytes) {
+    typename UnsignedOfSize<sizeof(T)>::type raw;
+    std::memcpy(&raw, bytes, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    raw = byteSwap(raw);
+#endif
+
+    T value;
+    std::memcpy(&value, &raw, sizeof(T));
+    return value;
+}
+
+template<typename T>
+inline void writeLittleEndian(char *bytes, const T &value) {
+    typename UnsignedOfSize<sizeof(T)>::type raw;
+    std::memcpy(&raw, &value, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    raw = byteSwap(raw);
+#endif
+
+    std::memcpy(bytes, &raw, sizeof(T));
+}
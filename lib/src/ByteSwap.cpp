@@ -0,0 +1,163 @@
+#include <cstring>
+#include "ByteSwap.h"
+#include "BigEndian.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NBT_X86_KERNELS 1
+#endif
+
+template<typename T>
+static void byteSwapScalar(const char *src, char *dst, unsigned long count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if (src != dst)
+        std::memmove(dst, src, count * sizeof(T));
+#else
+    for (unsigned long i = 0; i < count; i++) {
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        value = byteSwap(value);
+        std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+    }
+#endif
+}
+
+#ifdef NBT_X86_KERNELS
+
+// pshufb masks reversing every 2/4/8 byte group
+static const char SWAP_MASK_16[16] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+static const char SWAP_MASK_32[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+static const char SWAP_MASK_64[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+template<typename T>
+__attribute__((target("ssse3")))
+static void byteSwapSSSE3(const char *src, char *dst, unsigned long count, const char *swapMask) {
+    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(swapMask));
+    unsigned long bytes = count * sizeof(T);
+    unsigned long i = 0;
+
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(block, mask));
+    }
+
+    byteSwapScalar<T>(src + i, dst + i, (bytes - i) / sizeof(T));
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+static void byteSwapAVX2(const char *src, char *dst, unsigned long count, const char *swapMask) {
+    const __m128i halfMask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(swapMask));
+    const __m256i mask = _mm256_broadcastsi128_si256(halfMask);
+    unsigned long bytes = count * sizeof(T);
+    unsigned long i = 0;
+
+    for (; i + 64 <= bytes; i += 64) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(first, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 32), _mm256_shuffle_epi8(second, mask));
+    }
+
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(block, mask));
+    }
+
+    byteSwapScalar<T>(src + i, dst + i, (bytes - i) / sizeof(T));
+}
+
+static ByteSwapKernel detectKernel() {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return ByteSwapKernel::AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return ByteSwapKernel::SSSE3;
+    return ByteSwapKernel::SCALAR;
+}
+
+template<typename T>
+static void byteSwapKernel(ByteSwapKernel kernel, const char *src, char *dst, unsigned long count,
+                           const char *swapMask) {
+    switch (kernel) {
+        case ByteSwapKernel::AVX2:
+            byteSwapAVX2<T>(src, dst, count, swapMask);
+            break;
+        case ByteSwapKernel::SSSE3:
+            byteSwapSSSE3<T>(src, dst, count, swapMask);
+            break;
+        default:
+            byteSwapScalar<T>(src, dst, count);
+            break;
+    }
+}
+
+template<typename T>
+static void byteSwapDispatch(const char *src, char *dst, unsigned long count, const char *swapMask) {
+    static const ByteSwapKernel kernel = detectKernel();
+
+    byteSwapKernel<T>(kernel, src, dst, count, swapMask);
+}
+
+void byteSwapArray16(const char *src, char *dst, unsigned long count) {
+    byteSwapDispatch<uint16_t>(src, dst, count, SWAP_MASK_16);
+}
+
+void byteSwapArray32(const char *src, char *dst, unsigned long count) {
+    byteSwapDispatch<uint32_t>(src, dst, count, SWAP_MASK_32);
+}
+
+void byteSwapArray64(const char *src, char *dst, unsigned long count) {
+    byteSwapDispatch<uint64_t>(src, dst, count, SWAP_MASK_64);
+}
+
+bool byteSwapArrayWith(ByteSwapKernel kernel, unsigned long elementSize, const char *src, char *dst,
+                       unsigned long count) {
+    __builtin_cpu_init();
+    if ((kernel == ByteSwapKernel::AVX2 && !__builtin_cpu_supports("avx2")) ||
+        (kernel == ByteSwapKernel::SSSE3 && !__builtin_cpu_supports("ssse3")))
+        return false;
+
+    if (elementSize == 2)
+        byteSwapKernel<uint16_t>(kernel, src, dst, count, SWAP_MASK_16);
+    else if (elementSize == 4)
+        byteSwapKernel<uint32_t>(kernel, src, dst, count, SWAP_MASK_32);
+    else if (elementSize == 8)
+        byteSwapKernel<uint64_t>(kernel, src, dst, count, SWAP_MASK_64);
+    else
+        return false;
+    return true;
+}
+
+#else
+
+void byteSwapArray16(const char *src, char *dst, unsigned long count) {
+    byteSwapScalar<uint16_t>(src, dst, count);
+}
+
+void byteSwapArray32(const char *src, char *dst, unsigned long count) {
+    byteSwapScalar<uint32_t>(src, dst, count);
+}
+
+void byteSwapArray64(const char *src, char *dst, unsigned long count) {
+    byteSwapScalar<uint64_t>(src, dst, count);
+}
+
+bool byteSwapArrayWith(ByteSwapKernel kernel, unsigned long elementSize, const char *src, char *dst,
+                       unsigned long count) {
+    if (kernel != ByteSwapKernel::SCALAR)
+        return false;
+
+    if (elementSize == 2)
+        byteSwapScalar<uint16_t>(src, dst, count);
+    else if (elementSize == 4)
+        byteSwapScalar<uint32_t>(src, dst, count);
+    else if (elementSize == 8)
+        byteSwapScalar<uint64_t>(src, dst, count);
+    else
+        return false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+// bulk big endian <-> native conversion of count values from src into dst (src and dst may be the same buffer,
+// but must not overlap otherwise). picks an AVX2/SSSE3 kernel at runtime when the CPU has one
+void byteSwapArray16(const char *src, char *dst, unsigned long count);
+
+void byteSwapArray32(const char *src, char *dst, unsigned long count);
+
+void byteSwapArray64(const char *src, char *dst, unsigned long count);
+
+enum class ByteSwapKernel {
+    SCALAR,
+    SSSE3,
+    AVX2
+};
+
+// runs one specific kernel on 2, 4 or 8 byte values, for checking the kernels against each other. false if this
+// CPU (or build) doesn't have it
+bool byteSwapArrayWith(ByteSwapKernel kernel, unsigned long elementSize, const char *src, char *dst,
+                       unsigned long count);
+
+template<typename T>
+inline void readBigEndianArray(const char *src, T *dst, unsigned long count) {
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "unsupported element size");
+
+    if (sizeof(T) == 2)
+        byteSwapArray16(src, reinterpret_cast<char *>(dst), count);
+    else if (sizeof(T) == 4)
+        byteSwapArray32(src, reinterpret_cast<char *>(dst), count);
+    else
+        byteSwapArray64(src, reinterpret_cast<char *>(dst), count);
+}
+
+template<typename T>
+inline void writeBigEndianArray(const T *src, char *dst, unsigned long count) {
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "unsupported element size");
+
+    if (sizeof(T) == 2)
+        byteSwapArray16(reinterpret_cast<const char *>(src), dst, count);
+    else if (sizeof(T) == 4)
+        byteSwapArray32(reinterpret_cast<const char *>(src), dst, count);
+    else
+        byteSwapArray64(reinterpret_cast<const char *>(src), dst, count);
+}
@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <zlib.h>
+#include "Compression.h"
+#include "ThreadPool.h"
+#include "NBTSink.h"
+
+static int windowBitsFor(CompressionFormat format) {
+    switch (format) {
+        case CompressionFormat::GZIP:
+            return 16 + MAX_WBITS;
+        case CompressionFormat::ZLIB:
+            return MAX_WBITS;
+        default:
+            return -MAX_WBITS;
+    }
+}
+
+static int zlibStrategy(CompressionStrategy strategy) {
+    switch (strategy) {
+        case CompressionStrategy::FILTERED:
+            return Z_FILTERED;
+        case CompressionStrategy::HUFFMAN_ONLY:
+            return Z_HUFFMAN_ONLY;
+        case CompressionStrategy::RLE:
+            return Z_RLE;
+        case CompressionStrategy::FIXED:
+            return Z_FIXED;
+        default:
+            return Z_DEFAULT_STRATEGY;
+    }
+}
+
+// idle streams per thread, a deflate stream holds ~256 KiB so only a few are kept
+const unsigned long MAX_IDLE_STREAMS = 4;
+
+namespace {
+    struct CachedStream {
+        z_stream *stream;
+        bool deflating;
+        int windowBits;
+        int level;
+        int strategy;
+    };
+
+    struct StreamCache {
+        std::vector<CachedStream> idle;
+        std::vector<CachedStream> busy; // remembers the parameters until the stream comes back
+
+        ~StreamCache() {
+            for (const CachedStream &cached: idle) {
+                destroy(cached);
+            }
+        }
+
+        static void destroy(const CachedStream &cached) {
+            if (cached.deflating)
+                deflateEnd(cached.stream);
+            else
+                inflateEnd(cached.stream);
+            delete cached.stream;
+        }
+
+        z_stream *acquire(bool deflating, int windowBits, int level, int strategy) {
+            // inflate streams can switch formats on reset, deflate streams need the same parameters
+            for (auto cached = idle.begin(); cached != idle.end(); ++cached) {
+                if (cached->deflating != deflating)
+                    continue;
+
+                bool reused;
+                if (deflating) {
+                    reused = cached->windowBits == windowBits && cached->level == level &&
+                             cached->strategy == strategy && deflateReset(cached->stream) == Z_OK;
+                } else {
+                    reused = inflateReset2(cached->stream, windowBits) == Z_OK;
+                }
+
+                if (reused) {
+                    CachedStream stream = *cached;
+                    stream.windowBits = windowBits;
+                    idle.erase(cached);
+                    busy.push_back(stream);
+                    return stream.stream;
+                }
+            }
+
+            z_stream *stream = new z_stream();
+            int result = deflating ? deflateInit2(stream, level, Z_DEFLATED, windowBits, 8, strategy)
+                                   : inflateInit2(stream, windowBits);
+            if (result != Z_OK) {
+                delete stream;
+                return nullptr;
+            }
+
+            busy.push_back({stream, deflating, windowBits, level, strategy});
+            return stream;
+        }
+
+        void release(z_stream *stream, bool deflating) {
+            auto cached = std::find_if(busy.begin(), busy.end(), [stream](const CachedStream &candidate) {
+                return candidate.stream == stream;
+            });
+
+            // acquired on another thread, its parameters are unknown here
+            if (cached == busy.end()) {
+                destroy({stream, deflating, 0, 0, 0});
+                return;
+            }
+
+            CachedStream released = *cached;
+            busy.erase(cached);
+
+            if (idle.size() == MAX_IDLE_STREAMS) {
+                destroy(idle.front());
+                idle.erase(idle.begin());
+            }
+            idle.push_back(released);
+        }
+    };
+}
+
+static thread_local StreamCache streamCache;
+
+z_stream_s *acquireInflateStream(CompressionFormat format) {
+    return streamCache.acquire(false, windowBitsFor(format), 0, 0);
+}
+
+void releaseInflateStream(z_stream_s *stream) {
+    if (stream != nullptr)
+        streamCache.release(stream, false);
+}
+
+z_stream_s *acquireDeflateStream(const CompressionOptions &options) {
+    return streamCache.acquire(true, windowBitsFor(options.format), options.level, zlibStrategy(options.strategy));
+}
+
+void releaseDeflateStream(z_stream_s *stream) {
+    if (stream != nullptr)
+        streamCache.release(stream, true);
+}
+
+CompressionFormat detectCompression(const char *bytes, unsigned long size) {
+    if (size < 2)
+        return CompressionFormat::NONE;
+
+    uint8_t first = bytes[0];
+    uint8_t second = bytes[1];
+    if (first == 0x1F && second == 0x8B)
+        return CompressionFormat::GZIP;
+
+    // deflate method with a valid header checksum. an uncompressed NBT file starts with 0x0A, never 0x?8
+    if ((first & 0x0F) == Z_DEFLATED && (first >> 4) <= 7 && (first * 256 + second) % 31 == 0)
+        return CompressionFormat::ZLIB;
+
+    return CompressionFormat::NONE;
+}
+
+// avail_in is only 32 bits, so huge inputs are handed to zlib a round at a time
+const unsigned long ZLIB_ROUND_SIZE = 1ul << 30;
+
+// tops avail_in up from wherever next_in got to within bytes, true once the rest of the input is in
+static bool feedInput(z_stream *stream, const char *bytes, unsigned long size) {
+    unsigned long consumed = reinterpret_cast<const char *>(stream->next_in) - bytes;
+    stream->avail_in = std::min(size - consumed, ZLIB_ROUND_SIZE);
+    return consumed + stream->avail_in == size;
+}
+
+// uncompressed size of the last gzip member (mod 2^32), 0 if unknown
+static unsigned long gzipTrailerSize(const char *bytes, unsigned long size) {
+    if (size < 18)
+        return 0;
+
+    const uint8_t *trailer = reinterpret_cast<const uint8_t *>(bytes + size - 4);
+    unsigned long isize = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (unsigned long) trailer[3] << 24;
+
+    // deflate can't do better than ~1032:1, anything above that is a corrupt or truncated trailer
+    return isize <= size * 1032 ? isize : 0;
+}
+
+bool decompressBuffer(const char *bytes, unsigned long size, CompressionFormat format, std::string &out) {
+    if (format == CompressionFormat::NONE) {
+        out.assign(bytes, size);
+        return true;
+    }
+
+    z_stream *stream = acquireInflateStream(format);
+    if (stream == nullptr)
+        return false;
+
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes));
+    feedInput(stream, bytes, size);
+
+    // one spare byte so an exactly sized buffer never has to grow just to see the end of the stream.
+    // otherwise guess, NBT usually compresses somewhere around 4:1
+    unsigned long expected = format == CompressionFormat::GZIP ? gzipTrailerSize(bytes, size) : 0;
+    out.resize(expected > 0 ? expected + 1 : std::max(out.capacity(), std::max(size * 4, 64ul * 1024)));
+
+    unsigned long written = 0;
+    int result;
+    while (true) {
+        if (written == out.size())
+            out.resize(out.size() * 2);
+
+        stream->next_out = reinterpret_cast<Bytef *>(&out[written]);
+        stream->avail_out = out.size() - written;
+
+        result = inflate(stream, Z_NO_FLUSH);
+        written = out.size() - stream->avail_out;
+        feedInput(stream, bytes, size);
+
+        // another gzip member follows (multi-member files, parallel compressors), anything else is ignored
+        if (result == Z_STREAM_END && format == CompressionFormat::GZIP && stream->avail_in >= 2 &&
+            stream->next_in[0] == 0x1F && stream->next_in[1] == 0x8B) {
+            if (inflateReset(stream) != Z_OK)
+                break;
+            continue;
+        }
+
+        if (result != Z_OK)
+            break;
+    }
+
+    releaseInflateStream(stream);
+    out.resize(written);
+
+    return result == Z_STREAM_END;
+}
+
+bool compressBuffer(const char *bytes, unsigned long size, CompressionFormat format, std::string &out, int level,
+                    CompressionStrategy strategy) {
+    CompressionOptions options;
+    options.format = format;
+    options.level = level;
+    options.strategy = strategy;
+    return compressBuffer(bytes, size, options, out);
+}
+
+bool compressBuffer(const char *bytes, unsigned long size, const CompressionOptions &options, std::string &out) {
+    if (options.format == CompressionFormat::NONE) {
+        out.assign(bytes, size);
+        return true;
+    }
+
+    z_stream *stream = acquireDeflateStream(options);
+    if (stream == nullptr)
+        return false;
+
+    out.resize(deflateBound(stream, size));
+
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes));
+
+    // the bound covers the whole input in one go, the loop only grows the buffer if rounds ever cost more
+    unsigned long written = 0;
+    int result;
+    do {
+        int flush = feedInput(stream, bytes, size) ? Z_FINISH : Z_NO_FLUSH;
+        if (written == out.size())
+            out.resize(out.size() * 2);
+
+        stream->next_out = reinterpret_cast<Bytef *>(&out[written]);
+        stream->avail_out = out.size() - written;
+
+        result = deflate(stream, flush);
+        written = out.size() - stream->avail_out;
+    } while (result == Z_OK);
+
+    out.resize(written);
+    releaseDeflateStream(stream);
+
+    return result == Z_STREAM_END;
+}
+
+// deflate's window, what a block can refer back to
+const unsigned long DICTIONARY_SIZE = 32 * 1024;
+
+// gzip header extra subfield ('N', 'B') holding the total size of the member, written with independentBlocks
+const unsigned long MEMBER_HEADER_SIZE = 10 + 2 + 8;
+const char MEMBER_SIZE_SUBFIELD[2] = {'N', 'B'};
+
+static void appendLittleEndian(std::string &out, unsigned long value, unsigned int bytes) {
+    for (unsigned int i = 0; i < bytes; i++) {
+        out.push_back((char) (value >> (8 * i)));
+    }
+}
+
+static unsigned long readLittleEndian(const char *bytes, unsigned int count) {
+    unsigned long value = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        value |= (unsigned long) (uint8_t) bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+// raw deflate of one block. the last block of the stream finishes it, the others end on a byte boundary so the
+// next block's output can simply be appended
+static bool deflateBlock(const char *bytes, unsigned long start, unsigned long size, bool primed, bool last,
+                         const CompressionOptions &options, std::string &out) {
+    CompressionOptions rawOptions = options;
+    rawOptions.format = CompressionFormat::DEFLATE;
+
+    z_stream *stream = acquireDeflateStream(rawOptions);
+    if (stream == nullptr)
+        return false;
+
+    bool ok = true;
+    if (primed && start > 0) {
+        unsigned long dictionarySize = std::min(start, DICTIONARY_SIZE);
+        ok = deflateSetDictionary(stream, reinterpret_cast<const Bytef *>(bytes + start - dictionarySize),
+                                  dictionarySize) == Z_OK;
+    }
+
+    // the sync flush marker adds a few bytes on top of the bound
+    out.resize(deflateBound(stream, size) + 16);
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes + start));
+
+    unsigned long written = 0;
+    while (ok) {
+        bool allIn = feedInput(stream, bytes + start, size);
+        int flush = !allIn ? Z_NO_FLUSH : last ? Z_FINISH : Z_SYNC_FLUSH;
+        stream->next_out = reinterpret_cast<Bytef *>(&out[written]);
+        stream->avail_out = out.size() - written;
+
+        int result = deflate(stream, flush);
+        written = out.size() - stream->avail_out;
+
+        if (result == Z_STREAM_ERROR) {
+            ok = false;
+        } else if (allIn && (last ? result == Z_STREAM_END : stream->avail_out > 0)) {
+            break;
+        } else if (stream->avail_out == 0) {
+            out.resize(out.size() * 2);
+        }
+    }
+
+    releaseDeflateStream(stream);
+    out.resize(written);
+    return ok;
+}
+
+static void appendGzipHeader(std::string &out, unsigned long memberSize) {
+    out.append("\x1F\x8B\x08", 3);
+    out.push_back(memberSize > 0 ? 0x04 : 0x00); // FEXTRA
+    appendLittleEndian(out, 0, 4); // no mtime
+    out.push_back(0x00);
+    out.push_back((char) 0xFF); // unknown OS
+
+    if (memberSize > 0) {
+        appendLittleEndian(out, 8, 2);
+        out.append(MEMBER_SIZE_SUBFIELD, 2);
+        appendLittleEndian(out, 4, 2);
+        appendLittleEndian(out, memberSize, 4);
+    }
+}
+
+bool compressBufferParallel(const char *bytes, unsigned long size, const ParallelCompressionOptions &options,
+                            ThreadPool &pool, NBTSink &sink) {
+    CompressionFormat format = options.compression.format;
+    if (format == CompressionFormat::NONE)
+        return sink.write(bytes, size) && sink.finish();
+
+    bool independent = options.independentBlocks && format == CompressionFormat::GZIP;
+    unsigned long blockSize = std::max(options.blockSize, DICTIONARY_SIZE);
+    unsigned long blockCount = std::max((size + blockSize - 1) / blockSize, 1ul);
+
+    std::vector<std::string> blocks(blockCount);
+    std::vector<unsigned long> checksums(blockCount);
+    std::vector<char> blockOk(blockCount);
+
+    pool.parallelFor(blockCount, 1, [&](unsigned long begin, unsigned long end) {
+        for (unsigned long i = begin; i < end; i++) {
+            unsigned long start = i * blockSize;
+            unsigned long length = std::min(blockSize, size - std::min(start, size));
+            bool last = independent || i == blockCount - 1;
+
+            std::string deflated;
+            blockOk[i] = deflateBlock(bytes, start, length, !independent, last, options.compression, deflated);
+
+            const Bytef *input = reinterpret_cast<const Bytef *>(bytes + start);
+            checksums[i] = format == CompressionFormat::ZLIB ? adler32(adler32(0, nullptr, 0), input, length)
+                                                             : crc32(crc32(0, nullptr, 0), input, length);
+
+            if (!independent) {
+                blocks[i] = std::move(deflated);
+                continue;
+            }
+
+            // a complete member with its own size in the header
+            unsigned long memberSize = MEMBER_HEADER_SIZE + deflated.size() + 8;
+            blocks[i].reserve(memberSize);
+            appendGzipHeader(blocks[i], memberSize);
+            blocks[i] += deflated;
+            appendLittleEndian(blocks[i], checksums[i], 4);
+            appendLittleEndian(blocks[i], length, 4);
+        }
+    });
+
+    for (char ok: blockOk) {
+        if (!ok)
+            return false;
+    }
+
+    if (independent) {
+        for (const std::string &block: blocks) {
+            if (!sink.write(block.data(), block.size()))
+                return false;
+        }
+        return sink.finish();
+    }
+
+    std::string header;
+    std::string trailer;
+    unsigned long checksum = checksums[0];
+    for (unsigned long i = 1; i < blockCount; i++) {
+        unsigned long length = std::min(blockSize, size - i * blockSize);
+        checksum = format == CompressionFormat::ZLIB ? adler32_combine(checksum, checksums[i], length)
+                                                     : crc32_combine(checksum, checksums[i], length);
+    }
+
+    if (format == CompressionFormat::GZIP) {
+        appendGzipHeader(header, 0);
+        appendLittleEndian(trailer, checksum, 4);
+        appendLittleEndian(trailer, size, 4);
+    } else if (format == CompressionFormat::ZLIB) {
+        // 32 KiB window, deflate, level hint, padded to a multiple of 31
+        int level = options.compression.level;
+        unsigned int levelFlags = level < 0 || level == 6 ? 2 : level < 2 ? 0 : level < 6 ? 1 : 3;
+        unsigned int zlibHeader = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8 | levelFlags << 6;
+        zlibHeader += 31 - zlibHeader % 31;
+        header.push_back((char) (zlibHeader >> 8));
+        header.push_back((char) zlibHeader);
+
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            trailer.push_back((char) (checksum >> shift));
+        }
+    }
+
+    if (!sink.write(header.data(), header.size()))
+        return false;
+    for (const std::string &block: blocks) {
+        if (!sink.write(block.data(), block.size()))
+            return false;
+    }
+    return sink.write(trailer.data(), trailer.size()) && sink.finish();
+}
+
+// compressed and uncompressed extent of one independently inflatable gzip member
+namespace {
+    struct GzipMember {
+        unsigned long offset;
+        unsigned long size;
+        unsigned long outputOffset;
+        unsigned long outputSize;
+    };
+}
+
+// splits input written with independentBlocks into its members, false if it wasn't written that way
+static bool findMembers(const char *bytes, unsigned long size, std::vector<GzipMember> &members) {
+    unsigned long offset = 0;
+    unsigned long outputOffset = 0;
+
+    while (offset < size) {
+        const char *header = bytes + offset;
+        if (size - offset < MEMBER_HEADER_SIZE + 8 || (uint8_t) header[0] != 0x1F || (uint8_t) header[1] != 0x8B ||
+            header[3] != 0x04 || readLittleEndian(header + 10, 2) != 8 ||
+            header[12] != MEMBER_SIZE_SUBFIELD[0] || header[13] != MEMBER_SIZE_SUBFIELD[1] ||
+            readLittleEndian(header + 14, 2) != 4)
+            return false;
+
+        unsigned long memberSize = readLittleEndian(header + 16, 4);
+        if (memberSize < MEMBER_HEADER_SIZE + 8 || memberSize > size - offset)
+            return false;
+
+        // the same ~1032:1 bound as gzipTrailerSize, per member, so forged sizes can't make out huge
+        unsigned long outputSize = readLittleEndian(header + memberSize - 4, 4);
+        if (outputSize > memberSize * 1032)
+            return false;
+
+        members.push_back({offset, memberSize, outputOffset, outputSize});
+        offset += memberSize;
+        outputOffset += outputSize;
+    }
+
+    return !members.empty();
+}
+
+bool decompressBufferParallel(const char *bytes, unsigned long size, CompressionFormat format, ThreadPool &pool,
+                              std::string &out) {
+    std::vector<GzipMember> members;
+    if (format != CompressionFormat::GZIP || !findMembers(bytes, size, members) || members.size() == 1)
+        return decompressBuffer(bytes, size, format, out);
+
+    const GzipMember &lastMember = members.back();
+    out.resize(lastMember.outputOffset + lastMember.outputSize);
+
+    std::vector<char> memberOk(members.size());
+    pool.parallelFor(members.size(), 1, [&](unsigned long begin, unsigned long end) {
+        for (unsigned long i = begin; i < end; i++) {
+            const GzipMember &member = members[i];
+
+            z_stream *stream = acquireInflateStream(CompressionFormat::GZIP);
+            if (stream == nullptr)
+                continue;
+
+            // exactly outputSize bytes fit, a member claiming less than it holds fails instead of overflowing
+            stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes + member.offset));
+            stream->avail_in = member.size;
+            stream->next_out = reinterpret_cast<Bytef *>(&out[member.outputOffset]);
+            stream->avail_out = member.outputSize;
+
+            int result = inflate(stream, Z_FINISH);
+            memberOk[i] = result == Z_STREAM_END && stream->avail_out == 0 && stream->avail_in == 0;
+            releaseInflateStream(stream);
+        }
+    });
+
+    for (char ok: memberOk) {
+        if (!ok)
+            return false;
+    }
+    return true;
+}
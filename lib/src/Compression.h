@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+
+struct z_stream_s;
+
+class ThreadPool;
+
+class NBTSink;
+
+enum class CompressionFormat {
+    NONE,
+    GZIP,
+    ZLIB,
+    DEFLATE // raw deflate, no header or trailer
+};
+
+// zlib's deflate strategies
+enum class CompressionStrategy {
+    DEFAULT,
+    FILTERED,
+    HUFFMAN_ONLY,
+    RLE,
+    FIXED
+};
+
+struct CompressionOptions {
+    CompressionFormat format = CompressionFormat::GZIP;
+    int level = -1; // zlib level, -1 = default, 0-9
+    CompressionStrategy strategy = CompressionStrategy::DEFAULT;
+};
+
+struct ParallelCompressionOptions {
+    CompressionOptions compression;
+    unsigned long blockSize = 128 * 1024;
+
+    // gzip only: every block becomes its own gzip member that records its compressed size in the header, so
+    // decompressBufferParallel can inflate the blocks concurrently. costs some ratio since no dictionary is shared
+    bool independentBlocks = false;
+};
+
+// gzip and zlib are recognized by their headers. raw deflate has none and comes back as NONE
+CompressionFormat detectCompression(const char *bytes, unsigned long size);
+
+// inflate a complete buffer into out, reusing its capacity. gzip output is sized up front from the ISIZE trailer and
+// concatenated gzip members are inflated one after the other. returns false if the input is corrupt
+bool decompressBuffer(const char *bytes, unsigned long size, CompressionFormat format, std::string &out);
+
+// deflate a complete buffer into out, reusing its capacity. level is a zlib level (-1 = default, 0-9)
+bool compressBuffer(const char *bytes, unsigned long size, CompressionFormat format, std::string &out,
+                    int level = -1, CompressionStrategy strategy = CompressionStrategy::DEFAULT);
+
+bool compressBuffer(const char *bytes, unsigned long size, const CompressionOptions &options, std::string &out);
+
+// deflates blocks of the input on the pool and writes them to sink in order, then finishes the sink.
+// pigz style: each block is primed with the 32 KiB in front of it, so the output is one ordinary gzip/zlib/deflate
+// stream any reader accepts and compresses nearly as well as a serial deflate. false if zlib or the sink failed
+bool compressBufferParallel(const char *bytes, unsigned long size, const ParallelCompressionOptions &options,
+                            ThreadPool &pool, NBTSink &sink);
+
+// inflates gzip written with independentBlocks one member per task. anything else can't be split and is inflated
+// serially like decompressBuffer
+bool decompressBufferParallel(const char *bytes, unsigned long size, CompressionFormat format, ThreadPool &pool,
+                              std::string &out);
+
+// initialized zlib streams, kept per thread and reset between uses instead of being set up from scratch every time.
+// nullptr if zlib fails to initialize. releasing on another thread than the one that acquired is fine
+z_stream_s *acquireInflateStream(CompressionFormat format);
+
+void releaseInflateStream(z_stream_s *stream);
+
+z_stream_s *acquireDeflateStream(const CompressionOptions &options);
+
+void releaseDeflateStream(z_stream_s *stream);
@@ -0,0 +1,126 @@
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cassert>
+#include "MappedFile.h"
+
+MappedFile::MappedFile() = default;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this == &other)
+        return *this;
+
+    close();
+
+    fd = other.fd;
+    mapping = other.mapping;
+    mappedSize = other.mappedSize;
+    writable = other.writable;
+
+    other.fd = -1;
+    other.mapping = nullptr;
+    other.mappedSize = 0;
+
+    return *this;
+}
+
+bool MappedFile::open(const std::string &path, bool writable) {
+    close();
+
+    fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    this->writable = writable;
+
+    if (!remap()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close() {
+    unmap();
+
+    if (fd >= 0)
+        ::close(fd);
+
+    fd = -1;
+}
+
+bool MappedFile::remap() {
+    assert(fd >= 0);
+
+    // the old mapping stays in place until the new one exists, so a failure leaves the file readable as it was
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0)
+        return false;
+
+    // mmap refuses empty mappings, an empty file just has no data
+    if (fileStat.st_size == 0) {
+        unmap();
+        return true;
+    }
+
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *address = mmap(nullptr, fileStat.st_size, protection, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+        return false;
+
+    unmap();
+    mapping = static_cast<char *>(address);
+    mappedSize = fileStat.st_size;
+    return true;
+}
+
+void MappedFile::adviseSequential() const {
+    if (fd >= 0)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (mapping != nullptr) {
+        madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+        madvise(mapping, mappedSize, MADV_WILLNEED);
+    }
+}
+
+void MappedFile::unmap() {
+    if (mapping != nullptr)
+        munmap(mapping, mappedSize);
+
+    mapping = nullptr;
+    mappedSize = 0;
+}
+
+bool MappedFile::isOpen() const {
+    return fd >= 0;
+}
+
+const char *MappedFile::data() const {
+    return mapping;
+}
+
+char *MappedFile::mutableData() {
+    assert(writable);
+
+    return mapping;
+}
+
+unsigned long MappedFile::size() const {
+    return mappedSize;
+}
+
+int MappedFile::fileDescriptor() const {
+    return fd;
+}
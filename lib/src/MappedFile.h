@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+// read-only (or shared writable) memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const std::string &path, bool writable = false);
+
+    void close();
+
+    // map the file again, needed after it was grown or truncated through fileDescriptor(). on failure the old
+    // mapping is kept
+    bool remap();
+
+    // the whole file is about to be read front to back: aggressive readahead, starting right away
+    void adviseSequential() const;
+
+    bool isOpen() const;
+
+    const char *data() const;
+
+    // only valid for writable mappings
+    char *mutableData();
+
+    unsigned long size() const;
+
+    int fileDescriptor() const;
+
+private:
+    int fd = -1;
+    char *mapping = nullptr;
+    unsigned long mappedSize = 0;
+    bool writable = false;
+
+    void unmap();
+};
@@ -1,8 +1,18 @@
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
 #include "NBT.h"
-#include "gzip/utils.hpp"
-#include "gzip/decompress.hpp"
-#include "gzip/compress.hpp"
+#include "BigEndian.h"
+#include "ByteSwap.h"
+#include "NBTSink.h"
+#include "NBTStats.h"
+#include "Compression.h"
+#include "NBTSchema.h"
+#include "ThreadPool.h"
+#include "NBTFile.h"
+#include "NBTDialect.h"
 
 NBT::NBT() {
     this->tagID = -1;
@@ -13,124 +23,159 @@ NBT::NBT(char tagID) {
 }
 
 // return reference to parent to allow for chaining (e.g. a.addListChild(b).addListChild(c))
-NBT NBT::addListChild(const NBT &childNBT) {
+NBT &NBT::addListChild(const NBT &childNBT) {
     assert(this->tagID == TAG_List);
 
     listChildren.push_back(childNBT);
+    dirty = true;
 
     return *this;
 }
 
-NBT NBT::addCompoundChild(const std::string &childName, NBT childNBT) {
+NBT &NBT::addListChild(NBT &&childNBT) {
+    assert(this->tagID == TAG_List);
+
+    listChildren.push_back(std::move(childNBT));
+    dirty = true;
+
+    return *this;
+}
+
+NBT &NBT::addCompoundChild(NBTAtom childName, NBT childNBT) {
     assert(this->tagID == TAG_Compound);
 
     if (!childNBT.name.has_value())
         childNBT.name = childName;
 
-    compoundElements[childName] = childNBT; // can't use [] operator cuz NBT has no implicit constructor (i think)
+    compoundElements.insert_or_assign(childName, std::move(childNBT));
+    dirty = true;
 
     return *this;
 }
 
-char NBT::getByte() {
-    assert(tagID == TAG_Byte);
+NBT &NBT::emplaceListChild(char childTagID) {
+    assert(this->tagID == TAG_List);
 
-    return valueBytes.front();
+    dirty = true;
+    return listChildren.emplace_back(childTagID);
 }
 
-const int SHORT_BYTES = 2;
-
-union SignedShortBytesUnion {
-    char bytes[SHORT_BYTES];
-    signed short value;
-};
+NBT &NBT::emplaceCompoundChild(NBTAtom childName, char childTagID) {
+    assert(this->tagID == TAG_Compound);
 
-signed short NBT::getShort() {
-    assert(tagID == TAG_Short);
+    dirty = true;
+    NBT &child = compoundElements.insert_or_assign(childName, NBT(childTagID)).first->second;
+    child.name = childName;
+    return child;
+}
 
-    SignedShortBytesUnion shortBytes;
+void NBT::reserveChildren(unsigned long count) {
+    if (tagID == TAG_List)
+        listChildren.reserve(count);
+    else if (tagID == TAG_Compound)
+        compoundElements.reserve(count);
+}
 
-    for (int i = SHORT_BYTES - 1; i >= 0; i--) {
-        shortBytes.bytes[i] = valueBytes[SHORT_BYTES - 1 - i];
-    }
+NBT &NBT::editCompoundChild(NBTAtom childName) {
+    assert(this->tagID == TAG_Compound);
 
-    return shortBytes.value;
+    dirty = true;
+    return compoundElements.at(childName);
 }
 
-const int INT_BYTES = 4;
-
-union SignedIntBytesUnion {
-    char bytes[INT_BYTES];
-    signed int value;
-};
+NBT &NBT::editListChild(unsigned long index) {
+    assert(this->tagID == TAG_List);
 
-signed int NBT::getInt() {
-    assert(tagID == TAG_Int);
+    dirty = true;
+    return listChildren.at(index);
+}
 
-    SignedIntBytesUnion intBytes;
+void NBT::markDirty() {
+    dirty = true;
+}
 
-    for (int i = INT_BYTES - 1; i >= 0; i--) {
-        intBytes.bytes[i] = valueBytes[INT_BYTES - 1 - i];
+// the node has to be untouched, and so does everything below it: edits made through compoundElements or
+// listChildren only flag the node they were made on. every child also has to sit exactly where the source has it,
+// which catches children added, removed, reordered or swapped in from elsewhere. stops at the first difference
+bool NBT::isSpliceable() const {
+    if (dirty || source == nullptr)
+        return false;
+
+    const char *bytes = source->data();
+    unsigned long cursor = sourceOffset;
+    unsigned long end = sourceOffset + sourceSize;
+    if (tagID == TAG_Compound) {
+        for (const auto &element: compoundElements) {
+            const NBTAtom &key = element.first;
+            const NBT &child = element.second;
+
+            // tag id, name length and name in front of the payload
+            unsigned long header = cursor;
+            cursor += 3 + key.size();
+            if (cursor >= end || bytes[header] != child.tagID ||
+                readBigEndian<unsigned short>(bytes + header + 1) != key.size() ||
+                std::memcmp(bytes + header + 3, key.data(), key.size()) != 0)
+                return false;
+
+            if (child.source != source || child.sourceOffset != cursor || !child.isSpliceable())
+                return false;
+            cursor += child.sourceSize;
+        }
+        return cursor + 1 == end;
+    } else if (tagID == TAG_List) {
+        // list type and count
+        cursor += 5;
+        for (const NBT &child: listChildren) {
+            if (child.source != source || child.sourceOffset != cursor || !child.isSpliceable())
+                return false;
+            cursor += child.sourceSize;
+        }
+        return cursor == end;
     }
 
-    return intBytes.value;
+    return true;
 }
 
-const int LONG_BYTES = 8;
+char NBT::getByte() {
+    assert(tagID == TAG_Byte);
 
-union SignedLongBytesUnion {
-    char bytes[LONG_BYTES];
-    signed long value;
-};
+    return valueBytes.front();
+}
 
-signed long NBT::getLong() {
-    assert(tagID == TAG_Long);
+const int SHORT_BYTES = 2;
+const int INT_BYTES = 4;
+const int LONG_BYTES = 8;
+const int FLOAT_BYTES = 4;
+const int DOUBLE_BYTES = 8;
+
+signed short NBT::getShort() {
+    assert(tagID == TAG_Short);
 
-    SignedLongBytesUnion longBytes;
+    return readBigEndian<signed short>(valueBytes.data());
+}
 
-    for (int i = LONG_BYTES - 1; i >= 0; i--) {
-        longBytes.bytes[i] = valueBytes[LONG_BYTES - 1 - i];
-    }
+signed int NBT::getInt() {
+    assert(tagID == TAG_Int);
 
-    return longBytes.value;
+    return readBigEndian<signed int>(valueBytes.data());
 }
 
-const int FLOAT_BYTES = 4;
+signed long NBT::getLong() {
+    assert(tagID == TAG_Long);
 
-union FloatBytesUnion {
-    char bytes[FLOAT_BYTES];
-    float value;
-};
+    return readBigEndian<signed long>(valueBytes.data());
+}
 
 float NBT::getFloat() {
     assert(tagID == TAG_Float);
 
-    FloatBytesUnion floatBytes;
-
-    for (int i = FLOAT_BYTES - 1; i >= 0; i--) {
-        floatBytes.bytes[i] = valueBytes[FLOAT_BYTES - 1 - i];
-    }
-
-    return floatBytes.value;
+    return readBigEndian<float>(valueBytes.data());
 }
 
-const int DOUBLE_BYTES = 8;
-
-union DoubleBytesUnion {
-    char bytes[DOUBLE_BYTES];
-    double value;
-};
-
 double NBT::getDouble() {
     assert(tagID == TAG_Double);
 
-    DoubleBytesUnion doubleBytes;
-
-    for (int i = LONG_BYTES - 1; i >= 0; i--) {
-        doubleBytes.bytes[i] = valueBytes[DOUBLE_BYTES - 1 - i];
-    }
-
-    return doubleBytes.value;
+    return readBigEndian<double>(valueBytes.data());
 }
 
 std::vector<char> NBT::getByteVector() {
@@ -148,39 +193,62 @@ std::string NBT::getString() {
 std::vector<signed int> NBT::getIntVector() {
     assert(tagID == TAG_Int_Array);
 
-    std::vector<signed int> intVector;
-    int finalSize = (int) (valueBytes.size() / (unsigned long) INT_BYTES);
+    std::vector<signed int> intVector(valueBytes.size() / INT_BYTES);
+    readBigEndianArray(valueBytes.data(), intVector.data(), intVector.size());
 
-    for (int i = 0; i < finalSize; i++) {
-        SignedIntBytesUnion intBytes;
+    return intVector;
+}
 
-        for (int j = INT_BYTES - 1; j >= 0; j--) {
-            intBytes.bytes[j] = valueBytes[i * INT_BYTES + INT_BYTES - 1 - j];
-        }
+std::vector<signed long> NBT::getLongVector() {
+    assert(tagID == TAG_Long_Array);
 
-        intVector.push_back(intBytes.value);
-    }
+    std::vector<signed long> longVector(valueBytes.size() / LONG_BYTES);
+    readBigEndianArray(valueBytes.data(), longVector.data(), longVector.size());
 
-    return intVector;
+    return longVector;
 }
 
-std::vector<signed long> NBT::getLongVector() {
+unsigned long NBT::getArraySize() const {
+    assert(tagID == TAG_Byte_Array || tagID == TAG_Int_Array || tagID == TAG_Long_Array);
+
+    if (tagID == TAG_Int_Array)
+        return valueBytes.size() / INT_BYTES;
+    if (tagID == TAG_Long_Array)
+        return valueBytes.size() / LONG_BYTES;
+    return valueBytes.size();
+}
+
+unsigned long NBT::getIntArray(signed int *out, unsigned long count) const {
+    assert(tagID == TAG_Int_Array);
+
+    count = std::min(count, getArraySize());
+    readBigEndianArray(valueBytes.data(), out, count);
+    return count;
+}
+
+unsigned long NBT::getLongArray(signed long *out, unsigned long count) const {
     assert(tagID == TAG_Long_Array);
 
-    std::vector<signed long> longVector;
-    int finalSize = (int) (valueBytes.size() / (unsigned long) LONG_BYTES);
+    count = std::min(count, getArraySize());
+    readBigEndianArray(valueBytes.data(), out, count);
+    return count;
+}
 
-    for (int i = 0; i < finalSize; i++) {
-        SignedLongBytesUnion longBytesUnion;
+bool NBT::unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count, PackedLayout layout) const {
+    assert(tagID == TAG_Long_Array);
 
-        for (int j = LONG_BYTES - 1; j >= 0; j--) {
-            longBytesUnion.bytes[j] = valueBytes[i * LONG_BYTES + LONG_BYTES - 1 - j];
-        }
+    return ::unpackPalette(valueBytes.data(), getArraySize(), bitsPerEntry, layout, out, count);
+}
 
-        longVector.push_back(longBytesUnion.value);
-    }
+std::optional<NBT> NBT::packPalette(const uint16_t *entries, unsigned long count, unsigned int bitsPerEntry,
+                                    PackedLayout layout) {
+    if (bitsPerEntry < 1 || bitsPerEntry > 16)
+        return std::nullopt;
 
-    return longVector;
+    NBT packed(TAG_Long_Array);
+    packed.valueBytes.resize(8 * packedLongCount(count, bitsPerEntry, layout));
+    ::packPalette(entries, count, bitsPerEntry, layout, packed.valueBytes.data());
+    return packed;
 }
 
 void NBT::writeBytes(const char *byteArray, unsigned int &offset, const unsigned int size) {
@@ -188,120 +256,81 @@ void NBT::writeBytes(const char *byteArray, unsigned int &offset, const unsigned
     offset += size;
 }
 
-// TODO: Implement resizes for potential performance boost
-
 void NBT::writeVal(const char &byte) {
     assert(tagID == TAG_Byte);
 
-//    valueBytes.resize(1);
-    valueBytes.push_back(byte);
+    valueBytes.assign(1, byte);
+    dirty = true;
 }
 
 void NBT::writeVal(const short &val) {
     assert(tagID == TAG_Short);
 
-//    valueBytes.resize(SHORT_BYTES);
-
-    SignedShortBytesUnion shortBytes;
-    shortBytes.value = val;
-
-    for (int i = SHORT_BYTES - 1; i >= 0; i--) {
-        valueBytes.push_back(shortBytes.bytes[i]);
-    }
+    valueBytes.resize(SHORT_BYTES);
+    writeBigEndian(valueBytes.data(), val);
+    dirty = true;
 }
 
 void NBT::writeVal(const int &val) {
     assert(tagID == TAG_Int);
 
-//    valueBytes.resize(INT_BYTES);
-
-    SignedIntBytesUnion intBytes;
-    intBytes.value = val;
-
-    for (int i = INT_BYTES - 1; i >= 0; i--) {
-        valueBytes.push_back(intBytes.bytes[i]);
-    }
+    valueBytes.resize(INT_BYTES);
+    writeBigEndian(valueBytes.data(), val);
+    dirty = true;
 }
 
 void NBT::writeVal(const long &val) {
     assert(tagID == TAG_Long);
 
-//    valueBytes.resize(LONG_BYTES);
-
-    SignedLongBytesUnion longBytes;
-    longBytes.value = val;
-
-    for (int i = LONG_BYTES - 1; i >= 0; i--) {
-        valueBytes.push_back(longBytes.bytes[i]);
-    }
+    valueBytes.resize(LONG_BYTES);
+    writeBigEndian(valueBytes.data(), val);
+    dirty = true;
 }
 
 void NBT::writeVal(const float &val) {
     assert(tagID == TAG_Float);
 
-//    valueBytes.resize(FLOAT_BYTES);
-
-    FloatBytesUnion floatBytes;
-    floatBytes.value = val;
-
-    for (int i = FLOAT_BYTES - 1; i >= 0; i--) {
-        valueBytes.push_back(floatBytes.bytes[i]);
-    }
+    valueBytes.resize(FLOAT_BYTES);
+    writeBigEndian(valueBytes.data(), val);
+    dirty = true;
 }
 
 void NBT::writeVal(const double &val) {
     assert(tagID == TAG_Double);
 
-//    valueBytes.resize(DOUBLE_BYTES);
-
-    DoubleBytesUnion doubleBytesUnion;
-    doubleBytesUnion.value = val;
-
-    for (int i = DOUBLE_BYTES - 1; i >= 0; i--) {
-        valueBytes.push_back(doubleBytesUnion.bytes[i]);
-    }
+    valueBytes.resize(DOUBLE_BYTES);
+    writeBigEndian(valueBytes.data(), val);
+    dirty = true;
 }
 
 void NBT::writeVal(const std::vector<char> &byteVector) {
     assert(tagID == TAG_Byte_Array);
 
     valueBytes = byteVector;
+    dirty = true;
 }
 
 void NBT::writeVal(const std::string &str) {
     assert(tagID == TAG_String);
 
     valueBytes = std::vector<char>(str.begin(), str.end());
+    dirty = true;
 }
 
 void NBT::writeVal(const std::vector<int> &intVector) {
     assert(tagID == TAG_Int_Array);
 
-//    valueBytes.resize(valueBytes.size() * INT_BYTES);
-
-    for (const int &val: intVector) {
-        SignedIntBytesUnion intBytes;
-        intBytes.value = val;
-
-        for (int i = INT_BYTES - 1; i >= 0; i--) {
-            valueBytes.push_back(intBytes.bytes[i]);
-        }
-    }
+    valueBytes.resize(intVector.size() * INT_BYTES);
+    writeBigEndianArray(intVector.data(), valueBytes.data(), intVector.size());
+    dirty = true;
 }
 
 void NBT::writeVal(const std::vector<long> &longVector) {
     assert(tagID == TAG_Long_Array);
 
-//    valueBytes.resize(valueBytes.size() * LONG_BYTES);
-
-    for (const long &val: longVector) {
-        SignedLongBytesUnion longBytes;
-        longBytes.value = val;
-
-        for (int i = LONG_BYTES - 1; i >= 0; i--) {
-            valueBytes.push_back(longBytes.bytes[i]);
-        }
-    }
+    valueBytes.resize(longVector.size() * LONG_BYTES);
+    writeBigEndianArray(longVector.data(), valueBytes.data(), longVector.size());
+    dirty = true;
 }
 
 NBT::NBT(char tagID, const char &byte) : NBT(tagID) {
@@ -344,141 +373,451 @@ NBT::NBT(char tagID, const std::vector<long> &longVector) : NBT(tagID) {
     this->writeVal(longVector);
 }
 
-union UnsignedShortBytesUnion {
-    char bytes[SHORT_BYTES];
-    unsigned short value;
-};
-
 char deserializeTagID(const char *byteArray, unsigned int &offset) {
     char tagID = byteArray[offset];
     offset++;
     return tagID;
 }
 
-std::string deserializeString(const char *byteArray, unsigned int &offset) {
-    UnsignedShortBytesUnion stringLength;
+// interned straight from the buffer, repeated names don't allocate
+template<typename Dialect>
+NBTAtom deserializeName(const char *byteArray, unsigned int &offset) {
+    unsigned short length = Dialect::readStringLength(byteArray, offset);
 
-    for (int i = SHORT_BYTES - 1; i >= 0; i--) {
-        stringLength.bytes[i] = byteArray[offset + (SHORT_BYTES - 1 - i)];
-    }
-    offset += SHORT_BYTES;
-
-    std::string str;
-    for (int i = 0; i < stringLength.value; i++) {
-        str += byteArray[offset + i];
-    }
-    offset += stringLength.value;
-    return str;
+    NBTAtom name(std::string_view(byteArray + offset, length));
+    offset += length;
+    return name;
 }
 
-signed int deserializeSignedInt(const char *byteArray, unsigned int &offset) {
-    SignedIntBytesUnion intBytes;
-
-    for (int i = INT_BYTES - 1; i >= 0; i--) {
-        intBytes.bytes[i] = byteArray[offset + (INT_BYTES - 1 - i)];
+// scalars are stored big endian whatever the wire looks like
+template<typename Dialect, typename T>
+void deserializeScalar(NBT &nbt, const char *byteArray, unsigned int &offset) {
+    nbt.valueBytes.resize(sizeof(T));
+    if constexpr (Dialect::JAVA_PAYLOADS) {
+        std::memcpy(nbt.valueBytes.data(), byteArray + offset, sizeof(T));
+        offset += sizeof(T);
+    } else {
+        writeBigEndian(nbt.valueBytes.data(), Dialect::template read<T>(byteArray, offset));
     }
-    offset += INT_BYTES;
+}
 
-    return intBytes.value;
+template<typename Dialect, typename T>
+void deserializeArray(NBT &nbt, const char *byteArray, unsigned int &offset) {
+    unsigned long count = std::max(Dialect::readCount(byteArray, offset), 0);
+    nbt.valueBytes.resize(sizeof(T) * count);
+    Dialect::template readArray<T>(byteArray, offset, count, nbt.valueBytes.data());
 }
 
-std::unordered_map<char, int> TAG_BYTE_COUNT_MAP{{TAG_Byte,   1},
-                                                 {TAG_Short,  2},
-                                                 {TAG_Int,    4},
-                                                 {TAG_Long,   8},
-                                                 {TAG_Float,  4},
-                                                 {TAG_Double, 8}};
+typedef std::shared_ptr<const std::string> SourcePtr;
+
+// set when deserializing on a pool, nullptr for the plain serial parse
+struct ParallelParse {
+    ThreadPool *pool;
+    unsigned long grainSize;
+    const char *bufferEnd;
+};
 
-void deserializeTagList(NBT *const parentPtr, const char *byteArray, unsigned int &offset);
+template<typename Dialect>
+void deserializeTagList(NBT *const parentPtr, const char *byteArray, unsigned int &offset, const SourcePtr &source,
+                        const ParallelParse *parallel);
+
+template<typename Dialect>
+void deserializeTagCompound(NBT *const parentPtr, const char *byteArray, unsigned int &offset,
+                            const SourcePtr &source, const ParallelParse *parallel);
+
+// may run on several threads at once (for different nodes), so nothing shared is written
+template<typename Dialect>
+void deserializeValue(NBT &childNBT, const char *byteArray, unsigned int &offset, const SourcePtr &source,
+                      const ParallelParse *parallel) {
+    unsigned int valueOffset = offset;
+
+    switch (childNBT.tagID) {
+        case TAG_Byte:
+            childNBT.writeBytes(byteArray, offset, 1);
+            break;
+        case TAG_Short:
+            deserializeScalar<Dialect, signed short>(childNBT, byteArray, offset);
+            break;
+        case TAG_Int:
+            deserializeScalar<Dialect, signed int>(childNBT, byteArray, offset);
+            break;
+        case TAG_Long:
+            deserializeScalar<Dialect, signed long>(childNBT, byteArray, offset);
+            break;
+        case TAG_Float:
+            deserializeScalar<Dialect, float>(childNBT, byteArray, offset);
+            break;
+        case TAG_Double:
+            deserializeScalar<Dialect, double>(childNBT, byteArray, offset);
+            break;
+        case TAG_List:
+            childNBT.listType = deserializeTagID(byteArray, offset);
+            childNBT.childrenCount = Dialect::readCount(byteArray, offset);
+
+            if (childNBT.childrenCount > 0)
+                deserializeTagList<Dialect>(&childNBT, byteArray, offset, source, parallel);
+            break;
+        case TAG_Compound:
+            deserializeTagCompound<Dialect>(&childNBT, byteArray, offset, source, parallel);
+            break;
+        case TAG_String:
+            childNBT.writeBytes(byteArray, offset, Dialect::readStringLength(byteArray, offset));
+            break;
+        case TAG_Byte_Array:
+            deserializeArray<Dialect, char>(childNBT, byteArray, offset);
+            break;
+        case TAG_Int_Array:
+            deserializeArray<Dialect, signed int>(childNBT, byteArray, offset);
+            break;
+        case TAG_Long_Array:
+            deserializeArray<Dialect, signed long>(childNBT, byteArray, offset);
+            break;
+        default:
+            break;
+    }
 
-void deserializeTagCompound(NBT *const parentPtr, const char *byteArray, unsigned int &offset);
+    // the adders flag the node, but it still matches the input
+    childNBT.dirty = false;
+    if (source != nullptr) {
+        childNBT.source = source;
+        childNBT.sourceOffset = valueOffset;
+        childNBT.sourceSize = offset - valueOffset;
+    }
+}
 
-void deserializeValue(NBT &childNBT, const char *byteArray, unsigned int &offset) {
-    if (TAG_BYTE_COUNT_MAP.count(childNBT.tagID) > 0) {
-        childNBT.writeBytes(byteArray, offset, TAG_BYTE_COUNT_MAP[childNBT.tagID]);
-    } else if (childNBT.tagID == TAG_List) {
-        char listType = deserializeTagID(byteArray, offset);
+// a corrupt count shouldn't be able to allocate gigabytes up front, past this the vector grows as usual
+const unsigned long MAX_LIST_RESERVE = 64 * 1024;
+
+// a list of compounds or lists with more than grainSize children is split into blocks of grainSize. a quick skip
+// over the children finds where each block starts, then the blocks are built on the pool straight into their final
+// place, so the list comes out in input order. java input only, the skip doesn't know the other dialects
+static bool deserializeTagListParallel(NBT *const parentPtr, const char *byteArray, unsigned int &offset,
+                                       const SourcePtr &source, const ParallelParse &parallel) {
+    char listType = parentPtr->listType;
+    unsigned long count = parentPtr->childrenCount;
+    if ((listType != TAG_Compound && listType != TAG_List) || count <= parallel.grainSize)
+        return false;
+
+    // every child takes at least a byte, a count the rest of the input can't hold is corrupt
+    if (count > (unsigned long) (parallel.bufferEnd - (byteArray + offset)))
+        return false;
+
+    unsigned long blockCount = (count + parallel.grainSize - 1) / parallel.grainSize;
+    std::vector<unsigned int> blockStarts(blockCount + 1);
+
+    // bounds checked: corrupt input ends the scan at the end of the buffer, and the serial parse takes over before
+    // anything is allocated for the children
+    NBTSchemaDetail::Reader reader{byteArray + offset, parallel.bufferEnd};
+    for (unsigned long i = 0; i < count; i++) {
+        if (i % parallel.grainSize == 0)
+            blockStarts[i / parallel.grainSize] = reader.cursor - byteArray;
+        if (!reader.skip(listType))
+            return false;
+    }
+    blockStarts[blockCount] = reader.cursor - byteArray;
 
-        childNBT.listType = listType;
-        childNBT.childrenCount = deserializeSignedInt(byteArray, offset);
+    parentPtr->dirty = true;
+    parentPtr->listChildren.assign(count, NBT(listType));
 
-        if (childNBT.childrenCount > 0) {
-            deserializeTagList(&childNBT, byteArray, offset);
-        }
-    } else if (childNBT.tagID == TAG_Compound) {
-        deserializeTagCompound(&childNBT, byteArray, offset);
-    } else if (childNBT.tagID == TAG_String) {
-        UnsignedShortBytesUnion stringLength;
+    parallel.pool->parallelFor(blockCount, 1, [&](unsigned long begin, unsigned long end) {
+        for (unsigned long block = begin; block < end; block++) {
+            unsigned int blockOffset = blockStarts[block];
+            unsigned long last = std::min((block + 1) * parallel.grainSize, count);
 
-        for (int i = SHORT_BYTES - 1; i >= 0; i--) {
-            stringLength.bytes[i] = byteArray[offset + (SHORT_BYTES - 1 - i)];
+            for (unsigned long i = block * parallel.grainSize; i < last; i++) {
+                deserializeValue<JavaDialect>(parentPtr->listChildren[i], byteArray, blockOffset, source, &parallel);
+            }
+            assert(blockOffset == blockStarts[block + 1]);
         }
-        offset += SHORT_BYTES;
+    });
 
-        childNBT.writeBytes(byteArray, offset, stringLength.value);
-    } else if (childNBT.tagID == TAG_Byte_Array) {
-        signed int count = deserializeSignedInt(byteArray, offset);
-        childNBT.writeBytes(byteArray, offset, count);
-    } else if (childNBT.tagID == TAG_Int_Array) {
-        signed int count = deserializeSignedInt(byteArray, offset);
-        childNBT.writeBytes(byteArray, offset, INT_BYTES * count);
-    } else if (childNBT.tagID == TAG_Long_Array) {
-        signed int count = deserializeSignedInt(byteArray, offset);
-        childNBT.writeBytes(byteArray, offset, LONG_BYTES * count);
-    }
+    offset = blockStarts[blockCount];
+    return true;
 }
 
-void deserializeTagList(NBT *const parentPtr, const char *byteArray, unsigned int &offset) {
+// children are built in place, never copied into the parent
+template<typename Dialect>
+void deserializeTagList(NBT *const parentPtr, const char *byteArray, unsigned int &offset, const SourcePtr &source,
+                        const ParallelParse *parallel) {
     assert(parentPtr->tagID == TAG_List);
-    for (int c = 0; c < parentPtr->childrenCount; c++) {
-        NBT childNBT = NBT(parentPtr->listType);
+    if constexpr (Dialect::JAVA_PAYLOADS) {
+        if (parallel != nullptr && deserializeTagListParallel(parentPtr, byteArray, offset, source, *parallel))
+            return;
+    }
 
-        deserializeValue(childNBT, byteArray, offset);
+    parentPtr->reserveChildren(std::min((unsigned long) parentPtr->childrenCount, MAX_LIST_RESERVE));
 
-        parentPtr->addListChild(childNBT);
+    for (int c = 0; c < parentPtr->childrenCount; c++) {
+        NBT &childNBT = parentPtr->emplaceListChild(parentPtr->listType);
+
+        deserializeValue<Dialect>(childNBT, byteArray, offset, source, parallel);
     }
 }
 
-void deserializeTagCompound(NBT *const parentPtr, const char *byteArray, unsigned int &offset) {
+template<typename Dialect>
+void deserializeTagCompound(NBT *const parentPtr, const char *byteArray, unsigned int &offset,
+                            const SourcePtr &source, const ParallelParse *parallel) {
     assert(parentPtr->tagID == TAG_Compound);
     while (byteArray[offset] != TAG_End) {
         char tagID = deserializeTagID(byteArray, offset);
-        std::string name = deserializeString(byteArray, offset);
-
-        NBT childNBT = NBT(tagID);
+        NBTAtom name = deserializeName<Dialect>(byteArray, offset);
 
-        deserializeValue(childNBT, byteArray, offset);
+        NBT &childNBT = parentPtr->emplaceCompoundChild(name, tagID);
 
-        parentPtr->addCompoundChild(name, childNBT);
+        deserializeValue<Dialect>(childNBT, byteArray, offset, source, parallel);
     }
     offset++;
 }
 
-NBT NBT::deserialize(const char *byteArray, const unsigned long byteArraySize) {
+// inflated input is only needed while the tree is built, so every call on a thread reuses the same buffer.
+// one that grew past this is given back afterwards instead of being held on to
+static thread_local std::string inflateScratch;
+const unsigned long MAX_RETAINED_SCRATCH = 16 * 1024 * 1024;
+
+// parallel == nullptr parses serially, otherwise it's filled in with the end of the (inflated) input.
+// keepSource and parallel are java only
+template<typename Dialect>
+static NBT deserializeInput(const char *byteArray, const unsigned long byteArraySize, bool keepSource,
+                            ParallelParse *parallel) {
+    NBTStatsCall statsCall;
+
+    // uncompressed input (e.g. an already inflated region chunk) is parsed in place instead of being copied.
+    // with keepSource the inflated bytes outlive the call, so they can't go into the scratch buffer
     std::string readableNBT;
-    if (gzip::is_compressed(byteArray, byteArraySize)) {
-        readableNBT = gzip::decompress(byteArray, byteArraySize);
-    } else {
-        readableNBT = std::string(byteArray, byteArray + byteArraySize);
+    std::string &inflated = keepSource ? readableNBT : inflateScratch;
+    const char *readableNBTCharArray = byteArray;
+    CompressionFormat format = detectCompression(byteArray, byteArraySize);
+    bool compressed = format != CompressionFormat::NONE;
+    if (compressed) {
+        NBTTraceSpan span("inflate", &NBTStats::inflateNanos);
+        bool ok = parallel != nullptr ? decompressBufferParallel(byteArray, byteArraySize, format, *parallel->pool,
+                                                                 inflated)
+                                      : decompressBuffer(byteArray, byteArraySize, format, inflated);
+        // never parse what a broken stream left behind
+        if (!ok)
+            throw std::runtime_error("corrupt compressed input");
+        readableNBTCharArray = inflated.data();
+    }
+    unsigned long readableSize = compressed ? inflated.size() : byteArraySize;
+
+    // the nodes share ownership of the buffer their spans point into
+    SourcePtr source;
+    if (keepSource) {
+        source = std::make_shared<const std::string>(
+                compressed ? std::move(readableNBT) : std::string(byteArray, byteArraySize));
+        readableNBTCharArray = source->data();
     }
-
-    const char *readableNBTCharArray = readableNBT.data();
 
     assert(readableNBTCharArray[0] == TAG_Compound);
+    if (parallel != nullptr)
+        parallel->bufferEnd = readableNBTCharArray + readableSize;
 
     unsigned int offset = 0;
 
     char tagID = deserializeTagID(readableNBTCharArray, offset);
-    std::string name = deserializeString(readableNBTCharArray, offset);
+    NBTAtom name = deserializeName<Dialect>(readableNBTCharArray, offset);
 
     NBT root = NBT(tagID);
     root.name = name;
 
-    deserializeTagCompound(&root, readableNBTCharArray, offset);
+    {
+        NBTTraceSpan span("build", &NBTStats::buildNanos);
+        unsigned int valueOffset = offset;
+        deserializeTagCompound<Dialect>(&root, readableNBTCharArray, offset, source, parallel);
+
+        root.dirty = false;
+        if (source != nullptr) {
+            root.source = source;
+            root.sourceOffset = valueOffset;
+            root.sourceSize = offset - valueOffset;
+        }
+    }
+
+    if (statsCall.active()) {
+        NBTStats &stats = statsCall.stats();
+        stats.compressedBytes += compressed ? byteArraySize : 0;
+        stats.uncompressedBytes += offset;
+        stats.countTree(root);
+        // the inflated copy is alive until the tree is complete
+        unsigned long inputCopyBytes = source != nullptr ? source->capacity() : compressed ? inflated.size() : 0;
+        stats.peakBytes = std::max(stats.peakBytes, inputCopyBytes + stats.bytesAllocated);
+    }
+
+    if (inflateScratch.capacity() > MAX_RETAINED_SCRATCH)
+        std::string().swap(inflateScratch);
 
     return root;
 }
 
+NBT NBT::deserialize(const char *byteArray, const unsigned long byteArraySize, bool keepSource) {
+    return deserializeInput<JavaDialect>(byteArray, byteArraySize, keepSource, nullptr);
+}
+
+NBT NBT::deserialize(const char *byteArray, unsigned long byteArraySize, ThreadPool &pool, unsigned long grainSize) {
+    ParallelParse parallel{&pool, std::max(grainSize, 1ul), nullptr};
+    return deserializeInput<JavaDialect>(byteArray, byteArraySize, false, &parallel);
+}
+
+// walks one payload with the dialect's checked reads, so the codec only ever sees complete, well formed input
+template<typename Dialect>
+static bool skipDialectValue(char tagID, const char *bytes, unsigned long end, unsigned int &offset,
+                             unsigned int depth) {
+    switch (tagID) {
+        case TAG_Byte:
+            return Dialect::template skip<char>(bytes, end, offset);
+        case TAG_Short:
+            return Dialect::template skip<signed short>(bytes, end, offset);
+        case TAG_Int:
+            return Dialect::template skip<signed int>(bytes, end, offset);
+        case TAG_Long:
+            return Dialect::template skip<signed long>(bytes, end, offset);
+        case TAG_Float:
+            return Dialect::template skip<float>(bytes, end, offset);
+        case TAG_Double:
+            return Dialect::template skip<double>(bytes, end, offset);
+        case TAG_String: {
+            unsigned short length;
+            return Dialect::checkStringLength(bytes, end, offset, length) &&
+                   Dialect::template skipArray<char>(bytes, end, offset, length);
+        }
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array: {
+            signed int count;
+            if (!Dialect::checkCount(bytes, end, offset, count))
+                return false;
+
+            unsigned long elements = std::max(count, 0);
+            if (tagID == TAG_Byte_Array)
+                return Dialect::template skipArray<char>(bytes, end, offset, elements);
+            if (tagID == TAG_Int_Array)
+                return Dialect::template skipArray<signed int>(bytes, end, offset, elements);
+            return Dialect::template skipArray<signed long>(bytes, end, offset, elements);
+        }
+        case TAG_List: {
+            signed int count;
+            if (offset >= end)
+                return false;
+            char listType = bytes[offset++];
+            if (!Dialect::checkCount(bytes, end, offset, count))
+                return false;
+            if (count <= 0)
+                return true;
+
+            // every element takes at least a byte, so a bogus count runs into the end quickly
+            if (listType < TAG_Byte || listType > TAG_Long_Array || depth >= NBTSchemaDetail::MAX_DEPTH)
+                return false;
+            for (signed int i = 0; i < count; i++) {
+                if (!skipDialectValue<Dialect>(listType, bytes, end, offset, depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        case TAG_Compound:
+            if (depth >= NBTSchemaDetail::MAX_DEPTH)
+                return false;
+            while (true) {
+                if (offset >= end)
+                    return false;
+                char childTagID = bytes[offset++];
+                if (childTagID == TAG_End)
+                    return true;
+
+                unsigned short length;
+                if (!Dialect::checkStringLength(bytes, end, offset, length) ||
+                    !Dialect::template skipArray<char>(bytes, end, offset, length) ||
+                    !skipDialectValue<Dialect>(childTagID, bytes, end, offset, depth + 1))
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+template<typename Dialect>
+static std::optional<NBT> deserializeDialect(const char *byteArray, unsigned long byteArraySize) {
+    // the deserializeInput below sees plain bytes, so the inflate is recorded out here
+    NBTStatsCall statsCall;
+
+    // inflated up front, the check needs the plain bytes and corrupt input has to be refused rather than asserted
+    std::string inflated;
+    unsigned long compressedBytes = 0;
+    CompressionFormat format = detectCompression(byteArray, byteArraySize);
+    if (format != CompressionFormat::NONE) {
+        {
+            NBTTraceSpan span("inflate", &NBTStats::inflateNanos);
+            if (!decompressBuffer(byteArray, byteArraySize, format, inflated))
+                return std::nullopt;
+        }
+        compressedBytes = byteArraySize;
+        byteArray = inflated.data();
+        byteArraySize = inflated.size();
+    }
+
+    // the codec's offsets are 32 bits
+    if (byteArraySize == 0 || byteArraySize >= (1ul << 32) || byteArray[0] != TAG_Compound)
+        return std::nullopt;
+
+    unsigned int offset = 1;
+    unsigned short nameLength;
+    if (!Dialect::checkStringLength(byteArray, byteArraySize, offset, nameLength) ||
+        !Dialect::template skipArray<char>(byteArray, byteArraySize, offset, nameLength) ||
+        !skipDialectValue<Dialect>(TAG_Compound, byteArray, byteArraySize, offset, 0))
+        return std::nullopt;
+
+    NBT root = deserializeInput<Dialect>(byteArray, byteArraySize, false, nullptr);
+
+    if (statsCall.active()) {
+        NBTStats &stats = statsCall.stats();
+        stats.compressedBytes += compressedBytes;
+        // the inflated copy is alive until the tree is complete
+        stats.peakBytes = std::max(stats.peakBytes, inflated.capacity() + stats.bytesAllocated);
+    }
+
+    return root;
+}
+
+std::optional<NBT> NBT::deserialize(const char *byteArray, unsigned long byteArraySize, NBTDialect dialect) {
+    switch (dialect) {
+        case NBTDialect::BEDROCK:
+            return deserializeDialect<BedrockDialect>(byteArray, byteArraySize);
+        case NBTDialect::NETWORK:
+            return deserializeDialect<NetworkDialect>(byteArray, byteArraySize);
+        default:
+            return deserializeDialect<JavaDialect>(byteArray, byteArraySize);
+    }
+}
+
+// inflated by NBTFile, so a corrupt file is a nullopt instead of an exception. the call is opened first so the
+// inflate in open() and the deserialize below end up in one record
+std::optional<NBT> NBT::loadFile(const std::string &path, bool keepSource) {
+    NBTStatsCall statsCall;
+    NBTFile file;
+    if (!file.open(path))
+        return std::nullopt;
+
+    NBT root = deserialize(file.data(), file.size(), keepSource);
+
+    if (statsCall.active() && file.compressedSize() > 0) {
+        NBTStats &stats = statsCall.stats();
+        stats.compressedBytes += file.compressedSize();
+        stats.peakBytes = std::max(stats.peakBytes, file.size() + stats.bytesAllocated);
+    }
+
+    return root;
+}
+
+bool NBT::saveFile(const std::string &path, const NBT &root, bool compressed, bool sync) {
+    CompressionOptions options;
+    options.format = compressed ? CompressionFormat::GZIP : CompressionFormat::NONE;
+    return saveFile(path, root, options, sync);
+}
+
+bool NBT::saveFile(const std::string &path, const NBT &root, const CompressionOptions &options, bool sync) {
+    NBTSaveBatch batch(sync);
+    return batch.add(path, root, options) && batch.commit();
+}
+
 std::unordered_map<char, std::string> TAG_ID_TO_STRING_MAP{{TAG_Byte,       "TAG_Byte"},
                                                            {TAG_Short,      "TAG_Short"},
                                                            {TAG_Int,        "TAG_Int"},
@@ -494,6 +833,18 @@ std::unordered_map<char, std::string> TAG_ID_TO_STRING_MAP{{TAG_Byte,       "TAG
 
 const std::string TAB_STRING = "    ";
 
+// decodes the array once instead of once per element
+template<typename T>
+std::string joinArray(const std::vector<T> &values) {
+    std::string joinedArray = "[";
+    for (unsigned long i = 0; i < values.size(); i++) {
+        if (i > 0)
+            joinedArray += ", ";
+        joinedArray += std::to_string(values[i]);
+    }
+    return joinedArray + "]";
+}
+
 void NBT::print(unsigned long depth) {
     for (int i = 0; i < depth; i++) {
         std::cout << TAB_STRING;
@@ -502,7 +853,7 @@ void NBT::print(unsigned long depth) {
     std::cout << TAG_ID_TO_STRING_MAP[tagID];
 
     if (name.has_value())
-        std::cout << " \"" + name.value() + "\"";
+        std::cout << " \"" + name.value().str() + "\"";
 
     if (tagID == TAG_List || tagID == TAG_Compound) {
         unsigned long subChildrenCount = std::max(listChildren.size(), compoundElements.size());
@@ -510,11 +861,11 @@ void NBT::print(unsigned long depth) {
         std::cout << " [" + std::to_string(subChildrenCount) + "]" + " {";
         std::cout << std::endl;
 
-        for (NBT child: listChildren) {
+        for (NBT &child: listChildren) {
             child.print(depth + 1);
         }
 
-        for (std::pair<std::string, NBT> element: compoundElements) {
+        for (auto &element: compoundElements) {
             element.second.print(depth + 1);
         }
 
@@ -551,12 +902,7 @@ void NBT::print(unsigned long depth) {
                 break;
             }
             case TAG_Byte_Array: {
-                std::string joinedArray = "[" + std::to_string(getByteVector().front());
-                for (unsigned long i = 1; i < getByteVector().size() - 1; i++) {
-                    joinedArray += std::to_string(getByteVector()[i]) + ", ";
-                }
-                joinedArray += std::to_string(getByteVector().back()) + "]";
-                std::cout << joinedArray;
+                std::cout << joinArray(getByteVector());
                 break;
             }
             case TAG_String: {
@@ -564,21 +910,11 @@ void NBT::print(unsigned long depth) {
                 break;
             }
             case TAG_Int_Array: {
-                std::string joinedArray = "[" + std::to_string(getIntVector().front());
-                for (unsigned long i = 1; i < getIntVector().size() - 1; i++) {
-                    joinedArray += std::to_string(getIntVector()[i]) + ", ";
-                }
-                joinedArray += std::to_string(getIntVector().back()) + "]";
-                std::cout << joinedArray;
+                std::cout << joinArray(getIntVector());
                 break;
             }
             case TAG_Long_Array: {
-                std::string joinedArray = "[" + std::to_string(getLongVector().front());
-                for (unsigned long i = 1; i < getLongVector().size() - 1; i++) {
-                    joinedArray += std::to_string(getLongVector()[i]) + ", ";
-                }
-                joinedArray += std::to_string(getLongVector().back()) + "]";
-                std::cout << joinedArray;
+                std::cout << joinArray(getLongVector());
                 break;
             }
             default: {
@@ -592,97 +928,377 @@ void NBT::print(unsigned long depth) {
     std::cout << std::endl;
 }
 
-void serializeByte(const char &byte, std::vector<char> &serializedBytesVector) {
-    serializedBytesVector.push_back(byte);
+// lists built with addListChild don't necessarily have childrenCount/listType filled in
+char effectiveListType(const NBT &nbt) {
+    if (nbt.listType == TAG_End && !nbt.listChildren.empty())
+        return nbt.listChildren.front().tagID;
+
+    return nbt.listType;
 }
 
-void serializeInt(const signed int &n, std::vector<char> &serializedBytesVector) {
-    SignedIntBytesUnion intBytes;
-    intBytes.value = n;
-    for (int i = INT_BYTES - 1; i >= 0; i--) {
-        serializeByte(intBytes.bytes[i], serializedBytesVector);
+// encoded size of a scalar payload, which is always the stored size for fixed width dialects
+template<typename Dialect, typename T>
+unsigned long serializedScalarSize(const NBT &nbt) {
+    if constexpr (Dialect::JAVA_PAYLOADS) {
+        return nbt.valueBytes.size();
+    } else {
+        assert(nbt.valueBytes.size() == sizeof(T));
+        return Dialect::size(readBigEndian<T>(nbt.valueBytes.data()));
     }
 }
 
-void serializeByteVector(const std::vector<char> &byteVector, std::vector<char> &serializedBytesVector) {
-    for (const char &byte: byteVector) {
-        serializeByte(byte, serializedBytesVector);
-    }
+template<typename Dialect, typename T>
+unsigned long serializedArraySize(const NBT &nbt) {
+    unsigned long count = nbt.valueBytes.size() / sizeof(T);
+    return Dialect::countSize((signed int) count) + Dialect::template arraySize<T>(nbt.valueBytes.data(), count);
 }
 
-void serializeByteVectorIncludingLength(const std::vector<char> &byteArrayToWrite,
-                                        std::vector<char> &serializedBytesVector) {
-    SignedIntBytesUnion countBytes;
-    countBytes.value = byteArrayToWrite.size();
-    for (int i = INT_BYTES - 1; i >= 0; i--) {
-        serializeByte(countBytes.bytes[i], serializedBytesVector);
+template<typename Dialect>
+unsigned long serializedValueSize(const NBT &nbt) {
+    if (Dialect::JAVA_PAYLOADS && nbt.isSpliceable()) {
+        return nbt.sourceSize;
+    } else if (nbt.tagID == TAG_Compound) {
+        unsigned long size = 1; // TAG_End
+        for (const auto &element: nbt.compoundElements) {
+            size += 1 + Dialect::stringLengthSize(element.first.size()) + element.first.size() +
+                    serializedValueSize<Dialect>(element.second);
+        }
+        return size;
+    } else if (nbt.tagID == TAG_List) {
+        unsigned long size = 1 + Dialect::countSize((signed int) nbt.listChildren.size());
+        for (const NBT &child: nbt.listChildren) {
+            size += serializedValueSize<Dialect>(child);
+        }
+        return size;
+    } else if (nbt.tagID == TAG_String) {
+        return Dialect::stringLengthSize(nbt.valueBytes.size()) + nbt.valueBytes.size();
+    } else if (nbt.tagID == TAG_Byte_Array) {
+        return serializedArraySize<Dialect, char>(nbt);
+    } else if (nbt.tagID == TAG_Int_Array) {
+        return serializedArraySize<Dialect, signed int>(nbt);
+    } else if (nbt.tagID == TAG_Long_Array) {
+        return serializedArraySize<Dialect, signed long>(nbt);
+    } else if (nbt.tagID == TAG_Short) {
+        return serializedScalarSize<Dialect, signed short>(nbt);
+    } else if (nbt.tagID == TAG_Int) {
+        return serializedScalarSize<Dialect, signed int>(nbt);
+    } else if (nbt.tagID == TAG_Long) {
+        return serializedScalarSize<Dialect, signed long>(nbt);
     }
 
-    serializeByteVector(byteArrayToWrite, serializedBytesVector);
+    return nbt.valueBytes.size();
 }
 
-void serializeCString(char *cString, unsigned short cStringLength, std::vector<char> &serializedBytesVector) {
-    UnsignedShortBytesUnion lengthBytesUnion;
-    lengthBytesUnion.value = cStringLength;
-    for (int i = SHORT_BYTES - 1; i >= 0; i--) {
-        serializeByte(lengthBytesUnion.bytes[i], serializedBytesVector);
+// writes straight into a buffer that's known to be big enough
+struct PointerWriter {
+    char *cursor;
+
+    void write(const char *bytes, unsigned long size) {
+        std::memcpy(cursor, bytes, size);
+        cursor += size;
+    }
+
+    void writeByte(char byte) {
+        *cursor = byte;
+        cursor++;
+    }
+
+    template<typename T>
+    void writeValue(const T &value) {
+        writeBigEndian(cursor, value);
+        cursor += sizeof(T);
+    }
+};
+
+const unsigned long SINK_WRITER_BUFFER_SIZE = 64 * 1024;
+
+// batches small writes before handing them to the sink, big payloads are passed through directly
+struct SinkWriter {
+    NBTSink &sink;
+    std::vector<char> buffer;
+    unsigned long used = 0;
+    bool ok = true;
+
+    explicit SinkWriter(NBTSink &sink) : sink(sink), buffer(SINK_WRITER_BUFFER_SIZE) {
+    }
+
+    void write(const char *bytes, unsigned long size) {
+        if (size > buffer.size() - used) {
+            flush();
+
+            if (size >= buffer.size()) {
+                ok = sink.write(bytes, size) && ok;
+                return;
+            }
+        }
+
+        std::memcpy(buffer.data() + used, bytes, size);
+        used += size;
     }
 
-    for (int i = 0; i < cStringLength; i++) {
-        serializeByte(*(cString + i), serializedBytesVector);
+    void writeByte(char byte) {
+        if (used == buffer.size())
+            flush();
+
+        buffer[used] = byte;
+        used++;
+    }
+
+    template<typename T>
+    void writeValue(const T &value) {
+        char bytes[sizeof(T)];
+        writeBigEndian(bytes, value);
+        write(bytes, sizeof(T));
+    }
+
+    void flush() {
+        if (used > 0)
+            ok = sink.write(buffer.data(), used) && ok;
+        used = 0;
+    }
+};
+
+template<typename Dialect, typename Writer>
+void serializeName(const NBTAtom &name, Writer &writer) {
+    Dialect::writeStringLength(writer, (unsigned short) name.size());
+    writer.write(name.data(), name.size());
+}
+
+template<typename Dialect, typename T, typename Writer>
+void serializeScalar(const NBT &nbt, Writer &writer) {
+    if constexpr (Dialect::JAVA_PAYLOADS) {
+        writer.write(nbt.valueBytes.data(), nbt.valueBytes.size());
+    } else {
+        assert(nbt.valueBytes.size() == sizeof(T));
+        Dialect::write(writer, readBigEndian<T>(nbt.valueBytes.data()));
     }
 }
 
-void serializeValue(NBT &nbt, std::vector<char> &serializedBytesVector) {
-    if (nbt.tagID == TAG_Compound) {
-        for (std::pair<std::string, NBT> element: nbt.compoundElements) {
-            serializeByte(element.second.tagID, serializedBytesVector);
-            serializeCString(element.second.name.value().data(), element.second.name.value().size(),
-                             serializedBytesVector);
+// the length prefix counts elements, not bytes
+template<typename Dialect, typename T, typename Writer>
+void serializeArray(const NBT &nbt, Writer &writer) {
+    unsigned long count = nbt.valueBytes.size() / sizeof(T);
+    Dialect::writeCount(writer, (signed int) count);
+    Dialect::template writeArray<T>(writer, nbt.valueBytes.data(), count);
+}
 
-            // serialize value
-            serializeValue(element.second, serializedBytesVector);
+// valueBytes are already big endian, so for java every payload is a single bulk write. untouched subtrees of a
+// document deserialized with keepSource are copied from the input as a whole
+template<typename Dialect, typename Writer>
+void serializeValue(const NBT &nbt, Writer &writer) {
+    if (Dialect::JAVA_PAYLOADS && nbt.isSpliceable()) {
+        writer.write(nbt.source->data() + nbt.sourceOffset, nbt.sourceSize);
+    } else if (nbt.tagID == TAG_Compound) {
+        for (const auto &element: nbt.compoundElements) {
+            writer.writeByte(element.second.tagID);
+            serializeName<Dialect>(element.first, writer);
+            serializeValue<Dialect>(element.second, writer);
         }
 
-        serializeByte(TAG_End, serializedBytesVector);
+        writer.writeByte(TAG_End);
     } else if (nbt.tagID == TAG_List) {
-        serializeByte(nbt.listType, serializedBytesVector);
-        serializeInt(nbt.childrenCount, serializedBytesVector);
+        writer.writeByte(effectiveListType(nbt));
+        Dialect::writeCount(writer, (signed int) nbt.listChildren.size());
 
-        for (NBT child: nbt.listChildren) {
-            serializeValue(child, serializedBytesVector);
-        }
-    } else if (TAG_BYTE_COUNT_MAP.count(nbt.tagID) > 0) {
-        for (const char &byte: nbt.valueBytes) {
-            serializeByte(byte, serializedBytesVector);
+        for (const NBT &child: nbt.listChildren) {
+            serializeValue<Dialect>(child, writer);
         }
     } else if (nbt.tagID == TAG_String) {
-        serializeCString(nbt.valueBytes.data(), nbt.valueBytes.size(), serializedBytesVector);
-    } else if (nbt.tagID == TAG_Byte_Array || nbt.tagID == TAG_Int_Array || nbt.tagID == TAG_Long_Array) {
-        serializeByteVectorIncludingLength(nbt.valueBytes, serializedBytesVector);
+        Dialect::writeStringLength(writer, (unsigned short) nbt.valueBytes.size());
+        writer.write(nbt.valueBytes.data(), nbt.valueBytes.size());
+    } else if (nbt.tagID == TAG_Byte_Array) {
+        serializeArray<Dialect, char>(nbt, writer);
+    } else if (nbt.tagID == TAG_Int_Array) {
+        serializeArray<Dialect, signed int>(nbt, writer);
+    } else if (nbt.tagID == TAG_Long_Array) {
+        serializeArray<Dialect, signed long>(nbt, writer);
+    } else if (nbt.tagID == TAG_Short) {
+        serializeScalar<Dialect, signed short>(nbt, writer);
+    } else if (nbt.tagID == TAG_Int) {
+        serializeScalar<Dialect, signed int>(nbt, writer);
+    } else if (nbt.tagID == TAG_Long) {
+        serializeScalar<Dialect, signed long>(nbt, writer);
+    } else if (nbt.tagID == TAG_Float) {
+        serializeScalar<Dialect, float>(nbt, writer);
+    } else if (nbt.tagID == TAG_Double) {
+        serializeScalar<Dialect, double>(nbt, writer);
+    } else {
+        writer.write(nbt.valueBytes.data(), nbt.valueBytes.size());
     }
 }
 
-std::vector<char> NBT::serialize(NBT &root, bool compressed) {
+template<typename Dialect, typename Writer>
+void serializeRoot(const NBT &root, Writer &writer) {
+    writer.writeByte(root.tagID);
+    serializeName<Dialect>(root.name.value_or(NBTAtom()), writer);
+    serializeValue<Dialect>(root, writer);
+}
+
+template<typename Dialect>
+unsigned long serializedRootSize(const NBT &root) {
+    unsigned long nameSize = root.name.value_or(NBTAtom()).size();
+    return 1 + Dialect::stringLengthSize(nameSize) + nameSize + serializedValueSize<Dialect>(root);
+}
+
+unsigned long NBT::serializedSize(const NBT &root) {
+    return serializedRootSize<JavaDialect>(root);
+}
+
+// tree shape and footprint of the input, once per instrumented serialize call
+static void recordSerializeStats(NBTStatsCall &statsCall, const NBT &root, unsigned long uncompressedBytes,
+                                 unsigned long bufferBytes) {
+    NBTStats &stats = statsCall.stats();
+    stats.uncompressedBytes += uncompressedBytes;
+    stats.countTree(root);
+    stats.peakBytes = std::max(stats.peakBytes, stats.bytesAllocated + bufferBytes);
+}
+
+unsigned long NBT::serializeInto(const NBT &root, char *buffer) {
+    assert(root.tagID == TAG_Compound);
+
+    NBTStatsCall statsCall;
+    PointerWriter writer{buffer};
+    {
+        NBTTraceSpan span("serialize", &NBTStats::serializeNanos);
+        serializeRoot<JavaDialect>(root, writer);
+    }
+
+    unsigned long written = writer.cursor - buffer;
+    if (statsCall.active())
+        recordSerializeStats(statsCall, root, written, written);
+
+    return written;
+}
+
+bool NBT::serializeInto(const NBT &root, NBTSink &sink) {
+    assert(root.tagID == TAG_Compound);
+
+    NBTStatsCall statsCall;
+    SinkWriter writer(sink);
+    {
+        NBTTraceSpan span("serialize", &NBTStats::serializeNanos);
+        serializeRoot<JavaDialect>(root, writer);
+        writer.flush();
+    }
+
+    if (statsCall.active())
+        recordSerializeStats(statsCall, root, serializedSize(root), SINK_WRITER_BUFFER_SIZE);
+
+    return writer.ok && sink.finish();
+}
+
+std::vector<char> NBT::serialize(const NBT &root, bool compressed) {
+    CompressionOptions options;
+    options.format = compressed ? CompressionFormat::GZIP : CompressionFormat::NONE;
+    return serialize(root, options);
+}
+
+std::vector<char> NBT::serialize(const NBT &root, const CompressionOptions &options) {
     assert(root.tagID == TAG_Compound);
 
     std::vector<char> serializedBytesVector;
 
-    serializeByte(root.tagID, serializedBytesVector);
-    if (root.name.has_value())
-        serializeCString(root.name.value().data(), root.name.value().size(), serializedBytesVector);
-    else {
-        std::string emptyStr;
-        serializeCString(emptyStr.data(), 0, serializedBytesVector);
+    if (options.format != CompressionFormat::NONE) {
+        NBTStatsCall statsCall;
+
+        // deflate while encoding instead of compressing a second full-size buffer afterwards
+        VectorSink vectorSink(serializedBytesVector);
+        DeflateSink deflateSink(vectorSink, options);
+        if (!serializeInto(root, deflateSink))
+            throw std::runtime_error("deflate failed");
+
+        if (statsCall.active()) {
+            statsCall.stats().compressedBytes += serializedBytesVector.size();
+            statsCall.stats().peakBytes += serializedBytesVector.capacity();
+        }
+
+        return serializedBytesVector;
     }
 
-    serializeValue(root, serializedBytesVector);
+    serializedBytesVector.resize(serializedSize(root));
+    serializeInto(root, serializedBytesVector.data());
 
-    if (compressed) {
-        std::string compressedBinary = gzip::compress(serializedBytesVector.data(), serializedBytesVector.size());
+    return serializedBytesVector;
+}
+
+std::vector<char> NBT::serialize(const NBT &root, const ParallelCompressionOptions &options, ThreadPool &pool) {
+    assert(root.tagID == TAG_Compound);
+
+    // opened first, so the serializeInto below adds to this call's record instead of publishing its own
+    NBTStatsCall statsCall;
+    std::vector<char> uncompressed(serializedSize(root));
+    serializeInto(root, uncompressed.data());
+
+    if (options.compression.format == CompressionFormat::NONE)
+        return uncompressed;
+
+    std::vector<char> serializedBytesVector;
+    VectorSink vectorSink(serializedBytesVector);
+    bool ok;
+    {
+        NBTTraceSpan span("deflate", &NBTStats::deflateNanos);
+        ok = compressBufferParallel(uncompressed.data(), uncompressed.size(), options, pool, vectorSink);
+    }
+    if (!ok)
+        throw std::runtime_error("deflate failed");
 
-        return std::vector<char>(compressedBinary.begin(), compressedBinary.end());
+    if (statsCall.active()) {
+        statsCall.stats().compressedBytes += serializedBytesVector.size();
+        statsCall.stats().peakBytes += uncompressed.capacity() + serializedBytesVector.capacity();
     }
 
     return serializedBytesVector;
 }
+
+// the java path above splices and streams, the other dialects encode the whole tree
+template<typename Dialect>
+static std::vector<char> serializeDialect(const NBT &root, bool compressed) {
+    NBTStatsCall statsCall;
+    std::vector<char> serializedBytesVector;
+    {
+        NBTTraceSpan span("serialize", &NBTStats::serializeNanos);
+        if (compressed) {
+            VectorSink vectorSink(serializedBytesVector);
+            DeflateSink deflateSink(vectorSink);
+            SinkWriter writer(deflateSink);
+            serializeRoot<Dialect>(root, writer);
+            writer.flush();
+
+            if (!writer.ok || !deflateSink.finish())
+                throw std::runtime_error("deflate failed");
+        } else {
+            serializedBytesVector.resize(serializedRootSize<Dialect>(root));
+            PointerWriter writer{serializedBytesVector.data()};
+            serializeRoot<Dialect>(root, writer);
+        }
+    }
+
+    if (statsCall.active()) {
+        unsigned long uncompressedBytes = compressed ? serializedRootSize<Dialect>(root) : serializedBytesVector.size();
+        recordSerializeStats(statsCall, root, uncompressedBytes, serializedBytesVector.capacity());
+        statsCall.stats().compressedBytes += compressed ? serializedBytesVector.size() : 0;
+    }
+
+    return serializedBytesVector;
+}
+
+std::vector<char> NBT::serialize(const NBT &root, NBTDialect dialect, bool compressed) {
+    assert(root.tagID == TAG_Compound);
+
+    switch (dialect) {
+        case NBTDialect::BEDROCK:
+            return serializeDialect<BedrockDialect>(root, compressed);
+        case NBTDialect::NETWORK:
+            return serializeDialect<NetworkDialect>(root, compressed);
+        default:
+            return serialize(root, compressed);
+    }
+}
+
+void NBT::serializePayload(const NBT &nbt, std::vector<char> &out) {
+    unsigned long offset = out.size();
+    out.resize(offset + serializedValueSize<JavaDialect>(nbt));
+
+    PointerWriter writer{out.data() + offset};
+    serializeValue<JavaDialect>(nbt, writer);
+}
@@ -2,9 +2,25 @@
 
 #include <vector>
 #include <optional>
+#include <memory>
 #include <string>
-#include <unordered_map>
 #include <cassert>
+#include "PackedArray.h"
+#include "NBTAtom.h"
+#include "NBTCompoundMap.h"
+
+class NBTSink;
+
+struct CompressionOptions;
+
+struct ParallelCompressionOptions;
+
+class ThreadPool;
+
+enum class NBTDialect;
+
+// children per task for the parallel deserialize, a few KiB to a few hundred KiB of input for typical lists
+const unsigned long DEFAULT_PARALLEL_GRAIN = 64;
 
 const char TAG_End = 0x00;
 const char TAG_Byte = 0x01;
@@ -27,19 +43,56 @@ public:
     std::vector<NBT> listChildren{};
     char listType{};
     signed int childrenCount{};
-    std::unordered_map<std::string, NBT> compoundElements{};
+    // names are interned, keys compare and hash as pointers. iterates in insertion (= file) order
+    NBTCompoundMap<NBT> compoundElements{};
 
-    std::optional<std::string> name;
+    std::optional<NBTAtom> name;
 
     std::vector<char> valueBytes{}; // empty if TAG_List or TAG_Compound
 
+    // set by deserialize(..., keepSource): where this node's payload sits in the (inflated) input. serialize copies
+    // the span verbatim instead of re-encoding the subtree as long as the node isn't dirty
+    std::shared_ptr<const std::string> source{};
+    unsigned long sourceOffset{};
+    unsigned long sourceSize{};
+
+    // set by writeVal/addListChild/addCompoundChild/edit*Child. ancestors don't need flagging, isSpliceable looks at
+    // the whole subtree. a payload changed by hand (valueBytes, listType) needs a markDirty() on that node, otherwise
+    // the stale source bytes get written
+    bool dirty{};
+
     explicit NBT();
 
     explicit NBT(char tagID);
 
-    NBT addListChild(const NBT &childNBT);
+    // both return this node so calls can be chained (a.addListChild(b).addListChild(c)). pass children as rvalues
+    // to move them in instead of copying the subtree
+    NBT &addListChild(const NBT &childNBT);
+
+    NBT &addListChild(NBT &&childNBT);
 
-    NBT addCompoundChild(const std::string& childName, NBT childNBT);
+    NBT &addCompoundChild(NBTAtom childName, NBT childNBT);
+
+    // construct an empty child in place and return it, for building trees top down without copies.
+    // the reference is invalidated by the next child added to this node
+    NBT &emplaceListChild(char childTagID);
+
+    // replaces an existing element of that name
+    NBT &emplaceCompoundChild(NBTAtom childName, char childTagID);
+
+    // capacity for count list children or compound elements
+    void reserveChildren(unsigned long count);
+
+    // access a child for modification, marks this node dirty so the change can't be hidden by a spliced span.
+    // chain them from the root (root.editCompoundChild("Data").editCompoundChild("Time").writeVal(...))
+    NBT &editCompoundChild(NBTAtom childName);
+
+    NBT &editListChild(unsigned long index);
+
+    void markDirty();
+
+    // true if serialize would copy this subtree from the source buffer. walks the subtree until the first change
+    bool isSpliceable() const;
 
     char getByte();
 
@@ -61,6 +114,19 @@ public:
 
     std::vector<signed long> getLongVector();
 
+    // element count of a TAG_Byte_Array, TAG_Int_Array or TAG_Long_Array
+    unsigned long getArraySize() const;
+
+    // fill a caller-provided buffer with up to count elements, returns the number of elements written
+    unsigned long getIntArray(signed int *out, unsigned long count) const;
+
+    unsigned long getLongArray(signed long *out, unsigned long count) const;
+
+    // unpack count bit-packed palette indices from a TAG_Long_Array, false if it holds fewer or bitsPerEntry isn't
+    // 1 - 16
+    bool unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count,
+                       PackedLayout layout = PackedLayout::PADDED) const;
+
     void writeBytes(const char *byteArray, unsigned int &offset, const unsigned int size);
 
     void writeVal(const char &byte);
@@ -94,10 +160,61 @@ public:
     NBT(char tagID, const std::vector<int> &intVector);
     NBT(char tagID, const std::vector<long> &longVector);
 
+    // TAG_Long_Array with count palette indices packed into it, nullopt unless bitsPerEntry is 1 - 16
+    static std::optional<NBT> packPalette(const uint16_t *entries, unsigned long count, unsigned int bitsPerEntry,
+                           PackedLayout layout = PackedLayout::PADDED);
+
 
     void print(unsigned long depth = 0);
 
-    static NBT deserialize(const char *byteArray, unsigned long byteArraySize);
+    // keepSource holds on to the (inflated) input and records every node's span in it, so unchanged subtrees are
+    // written back without re-encoding. costs a copy of uncompressed input and a reference per node.
+    // throws std::runtime_error if compressed input doesn't inflate completely
+    static NBT deserialize(const char *byteArray, unsigned long byteArraySize, bool keepSource = false);
+
+    // bedrock (little endian) or network (varint) input, compressed or not. the input is checked before it's parsed,
+    // nullopt if it's truncated, corrupt or malformed (e.g. a network string length above 65535)
+    static std::optional<NBT> deserialize(const char *byteArray, unsigned long byteArraySize, NBTDialect dialect);
+
+    // opt-in parallel parse. lists of compounds or lists longer than grainSize are built on the pool in blocks of
+    // grainSize children, and gzip written with independentBlocks is inflated on it too. the tree is the same as
+    // the one the serial deserialize builds. pays off for big documents (entities, structures), not single chunks
+    static NBT deserialize(const char *byteArray, unsigned long byteArraySize, ThreadPool &pool,
+                           unsigned long grainSize = DEFAULT_PARALLEL_GRAIN);
+
+    // maps the file and parses uncompressed input in place, compressed input is inflated straight from the mapping.
+    // nullopt if it can't be read, fails to inflate or doesn't start with a compound. NBTFile gives views instead of
+    // a tree
+    static std::optional<NBT> loadFile(const std::string &path, bool keepSource = false);
+
+    // replaces the file through a temp file + rename (see NBTSaveBatch, which also syncs many files in one go).
+    // sync waits until the new contents are on disk
+    static bool saveFile(const std::string &path, const NBT &root, bool compressed = true, bool sync = true);
+
+    static bool saveFile(const std::string &path, const NBT &root, const CompressionOptions &options,
+                         bool sync = true);
+
+    // exact size of the uncompressed output of serialize(root)
+    static unsigned long serializedSize(const NBT &root);
+
+    // writes into a caller-supplied buffer of at least serializedSize(root) bytes, returns the bytes written
+    static unsigned long serializeInto(const NBT &root, char *buffer);
+
+    // streams into a sink (wrap it in a DeflateSink for compressed output), false if the sink failed
+    static bool serializeInto(const NBT &root, NBTSink &sink);
+
+    // the compressing overloads throw std::runtime_error if deflate fails
+    static std::vector<char> serialize(const NBT &root, bool compressed = false);
+
+    // compressed with any format/level/strategy, or not at all (CompressionFormat::NONE)
+    static std::vector<char> serialize(const NBT &root, const CompressionOptions &options);
+
+    // bedrock or network output (java works too and is the same as serialize(root, compressed))
+    static std::vector<char> serialize(const NBT &root, NBTDialect dialect, bool compressed = false);
+
+    // encodes serially, then deflates blocks of the output on the pool. worth it for documents of a few MiB and up
+    static std::vector<char> serialize(const NBT &root, const ParallelCompressionOptions &options, ThreadPool &pool);
 
-    static std::vector<char> serialize(NBT &root, bool compressed = false);
+    // appends just the payload of nbt (no tag id or name), the way it appears inside a compound or list
+    static void serializePayload(const NBT &nbt, std::vector<char> &out);
 };
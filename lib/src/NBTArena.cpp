@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <algorithm>
+#include "NBTArena.h"
+
+NBTArena::NBTArena(unsigned long blockSize) : blockSize(blockSize) {
+    assert(blockSize > 0);
+}
+
+NBTArena::~NBTArena() {
+    release();
+}
+
+NBTArena::NBTArena(NBTArena &&other) noexcept {
+    *this = std::move(other);
+}
+
+NBTArena &NBTArena::operator=(NBTArena &&other) noexcept {
+    if (this == &other)
+        return *this;
+
+    release();
+
+    blockSize = other.blockSize;
+    blocks = std::move(other.blocks);
+    currentBlock = other.currentBlock;
+    cursor = other.cursor;
+    limit = other.limit;
+    usedInPreviousBlocks = other.usedInPreviousBlocks;
+
+    other.blocks.clear();
+    other.currentBlock = 0;
+    other.cursor = nullptr;
+    other.limit = nullptr;
+    other.usedInPreviousBlocks = 0;
+
+    return *this;
+}
+
+static char *alignUp(char *ptr, unsigned long alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    return ptr + ((alignment - address % alignment) % alignment);
+}
+
+void *NBTArena::allocate(unsigned long size, unsigned long alignment) {
+    char *aligned = alignUp(cursor, alignment);
+    if (cursor != nullptr && aligned + size <= limit) {
+        cursor = aligned + size;
+        return aligned;
+    }
+
+    return allocateSlow(size, alignment);
+}
+
+void *NBTArena::allocateSlow(unsigned long size, unsigned long alignment) {
+    // try the blocks left over from before the last reset() first
+    while (!blocks.empty() && currentBlock + 1 < blocks.size()) {
+        usedInPreviousBlocks += cursor - blocks[currentBlock].data;
+        currentBlock++;
+        cursor = blocks[currentBlock].data;
+        limit = cursor + blocks[currentBlock].size;
+
+        char *aligned = alignUp(cursor, alignment);
+        if (aligned + size <= limit) {
+            cursor = aligned + size;
+            return aligned;
+        }
+    }
+
+    if (!blocks.empty())
+        usedInPreviousBlocks += cursor - blocks[currentBlock].data;
+
+    unsigned long newBlockSize = std::max(blockSize, size + alignment);
+    Block block{static_cast<char *>(::operator new(newBlockSize)), newBlockSize};
+    blocks.push_back(block);
+    currentBlock = blocks.size() - 1;
+
+    cursor = alignUp(block.data, alignment);
+    limit = block.data + block.size;
+
+    char *allocation = cursor;
+    cursor += size;
+    return allocation;
+}
+
+const char *NBTArena::copyBytes(const char *bytes, unsigned long size) {
+    if (size == 0)
+        return nullptr;
+
+    char *copy = static_cast<char *>(allocate(size, 1));
+    std::copy(bytes, bytes + size, copy);
+    return copy;
+}
+
+void NBTArena::reset() {
+    currentBlock = 0;
+    usedInPreviousBlocks = 0;
+
+    if (blocks.empty()) {
+        cursor = nullptr;
+        limit = nullptr;
+        return;
+    }
+
+    cursor = blocks.front().data;
+    limit = cursor + blocks.front().size;
+}
+
+void NBTArena::release() {
+    for (Block &block: blocks) {
+        ::operator delete(block.data);
+    }
+
+    blocks.clear();
+    reset();
+}
+
+unsigned long NBTArena::bytesUsed() const {
+    if (blocks.empty())
+        return 0;
+
+    return usedInPreviousBlocks + (cursor - blocks[currentBlock].data);
+}
+
+unsigned long NBTArena::bytesReserved() const {
+    unsigned long reserved = 0;
+    for (const Block &block: blocks) {
+        reserved += block.size;
+    }
+    return reserved;
+}
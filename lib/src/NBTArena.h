@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+// bump allocator: memory is handed out from big blocks and only ever given back all at once.
+// reset() keeps the blocks around so the same arena can be reused for the next document
+class NBTArena {
+public:
+    explicit NBTArena(unsigned long blockSize = 64 * 1024);
+
+    ~NBTArena();
+
+    NBTArena(const NBTArena &) = delete;
+
+    NBTArena &operator=(const NBTArena &) = delete;
+
+    NBTArena(NBTArena &&other) noexcept;
+
+    NBTArena &operator=(NBTArena &&other) noexcept;
+
+    void *allocate(unsigned long size, unsigned long alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T *allocateArray(unsigned long count) {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // copy size bytes into the arena
+    const char *copyBytes(const char *bytes, unsigned long size);
+
+    // forget every allocation, O(1) in the number of allocations
+    void reset();
+
+    // drop all blocks
+    void release();
+
+    unsigned long bytesUsed() const;
+
+    unsigned long bytesReserved() const;
+
+private:
+    struct Block {
+        char *data;
+        unsigned long size;
+    };
+
+    unsigned long blockSize;
+    std::vector<Block> blocks{};
+    unsigned long currentBlock = 0;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    unsigned long usedInPreviousBlocks = 0;
+
+    void *allocateSlow(unsigned long size, unsigned long alignment);
+};
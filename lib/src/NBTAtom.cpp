@@ -0,0 +1,142 @@
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "NBTAtom.h"
+
+namespace {
+    struct AtomTable {
+        std::shared_mutex mutex;
+        // deque so entries never move, the map and every atom point into it
+        std::deque<NBTAtom::Entry> entries;
+        std::unordered_map<std::string_view, const NBTAtom::Entry *> index;
+        unsigned long bytes = 0;
+        // set once a name didn't fit. no names are added after that, and one missing from the table may be in use
+        std::atomic<bool> overflowed{false};
+        // interned up front and outside the limits, so default atoms never end up uninterned
+        const NBTAtom::Entry *empty;
+
+        AtomTable() {
+            empty = &entries.emplace_back(std::string_view(), std::hash<std::string_view>()(std::string_view()));
+            index.emplace(empty->string, empty);
+        }
+    };
+}
+
+// never destroyed, atoms in static objects may outlive any destructor order
+static AtomTable &atomTable() {
+    static AtomTable *table = new AtomTable();
+    return *table;
+}
+
+// interned entries are immortal, so a thread can keep its own lock-free cache of what it has looked up before.
+// cleared when it gets this big instead of growing with every name the thread has seen
+const unsigned long MAX_CACHED_ATOMS = 4096;
+
+static thread_local std::unordered_map<std::string_view, const NBTAtom::Entry *> threadAtomCache;
+
+static void cacheEntry(const NBTAtom::Entry *entry) {
+    if (threadAtomCache.size() >= MAX_CACHED_ATOMS)
+        threadAtomCache.clear();
+    threadAtomCache.emplace(entry->string, entry);
+}
+
+static const NBTAtom::Entry *findEntry(std::string_view name) {
+    auto cached = threadAtomCache.find(name);
+    if (cached != threadAtomCache.end())
+        return cached->second;
+
+    AtomTable &table = atomTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+
+    auto existing = table.index.find(name);
+    if (existing == table.index.end())
+        return nullptr;
+
+    cacheEntry(existing->second);
+    return existing->second;
+}
+
+// nullptr if the name doesn't fit anymore
+static const NBTAtom::Entry *internEntry(std::string_view name) {
+    const NBTAtom::Entry *entry = findEntry(name);
+    if (entry != nullptr)
+        return entry;
+
+    AtomTable &table = atomTable();
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+
+    // another thread may have added it in between
+    auto existing = table.index.find(name);
+    if (existing != table.index.end()) {
+        entry = existing->second;
+    } else if (!table.overflowed.load(std::memory_order_relaxed) &&
+               table.entries.size() - 1 < NBTAtom::MAX_INTERNED_NAMES &&
+               table.bytes + name.size() <= NBTAtom::MAX_INTERNED_BYTES) {
+        entry = &table.entries.emplace_back(name, std::hash<std::string_view>()(name));
+        table.index.emplace(entry->string, entry);
+        table.bytes += name.size();
+    } else {
+        // closed for good, so a name that didn't make it in never does later (a shorter one could still fit)
+        table.overflowed.store(true, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    cacheEntry(entry);
+    return entry;
+}
+
+static uintptr_t uninternedBits(std::string_view name) {
+    auto *entry = new NBTAtom::Entry(name, std::hash<std::string_view>()(name));
+    return reinterpret_cast<uintptr_t>(entry) | 1;
+}
+
+static uintptr_t atomBits(std::string_view name) {
+    const NBTAtom::Entry *entry = internEntry(name);
+    return entry != nullptr ? reinterpret_cast<uintptr_t>(entry) : uninternedBits(name);
+}
+
+uintptr_t NBTAtom::emptyBits() {
+    static const uintptr_t bits = reinterpret_cast<uintptr_t>(atomTable().empty);
+    return bits;
+}
+
+NBTAtom::NBTAtom() : bits(emptyBits()) {
+}
+
+NBTAtom::NBTAtom(std::string_view name) : bits(atomBits(name)) {
+}
+
+NBTAtom::NBTAtom(const std::string &name) : bits(atomBits(name)) {
+}
+
+NBTAtom::NBTAtom(const char *name) : bits(atomBits(name)) {
+}
+
+NBTAtom::NBTAtom(uintptr_t bits) : bits(bits) {
+}
+
+void NBTAtom::retain() const noexcept {
+    entry()->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NBTAtom::release() const noexcept {
+    if (entry()->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete entry();
+}
+
+NBTAtom NBTAtom::find(std::string_view name, bool &found) {
+    const Entry *entry = findEntry(name);
+    found = entry != nullptr || atomTable().overflowed.load(std::memory_order_relaxed);
+    if (entry != nullptr)
+        return NBTAtom(reinterpret_cast<uintptr_t>(entry));
+
+    // could be an uninterned name, which only compares equal to an atom with the same characters
+    return found ? NBTAtom(uninternedBits(name)) : NBTAtom();
+}
+
+unsigned long NBTAtom::internedCount() {
+    AtomTable &table = atomTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return table.entries.size();
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// interned tag name. every distinct name is stored once for the whole process and atoms of equal names point at
+// the same entry, so comparing or hashing an atom never touches the characters. interned names are never freed,
+// which is why the table is bounded: once it holds MAX_INTERNED_NAMES names or MAX_INTERNED_BYTES characters, new
+// names get an entry of their own that is freed with the last atom using it, and those compare by their characters.
+// a peer sending endless fresh names (network NBT, patches) only costs what its trees hold on to
+class NBTAtom {
+public:
+    static constexpr unsigned long MAX_INTERNED_NAMES = 64 * 1024;
+
+    static constexpr unsigned long MAX_INTERNED_BYTES = 4 * 1024 * 1024;
+
+    // the empty name
+    NBTAtom();
+
+    // interns name (a hash lookup, cached per thread)
+    NBTAtom(std::string_view name);
+
+    NBTAtom(const std::string &name);
+
+    NBTAtom(const char *name);
+
+    NBTAtom(const NBTAtom &other) noexcept: bits(other.bits) {
+        if (!interned())
+            retain();
+    }
+
+    NBTAtom(NBTAtom &&other) noexcept: bits(other.bits) {
+        if (!interned())
+            other.bits = emptyBits();
+    }
+
+    NBTAtom &operator=(const NBTAtom &other) noexcept {
+        NBTAtom copy(other);
+        std::swap(bits, copy.bits);
+        return *this;
+    }
+
+    NBTAtom &operator=(NBTAtom &&other) noexcept {
+        std::swap(bits, other.bits);
+        return *this;
+    }
+
+    ~NBTAtom() {
+        if (!interned())
+            release();
+    }
+
+    // atom of a name without adding it to the table, for names from untrusted input that only need to be looked
+    // up. found = false (and the empty atom) if no atom of that name can exist
+    static NBTAtom find(std::string_view name, bool &found);
+
+    // number of distinct names interned so far
+    static unsigned long internedCount();
+
+    // false for names that didn't fit into the table
+    bool interned() const {
+        return (bits & UNINTERNED) == 0;
+    }
+
+    const std::string &str() const {
+        return entry()->string;
+    }
+
+    operator const std::string &() const {
+        return entry()->string;
+    }
+
+    operator std::string_view() const {
+        return entry()->string;
+    }
+
+    const char *data() const {
+        return entry()->string.data();
+    }
+
+    unsigned long size() const {
+        return entry()->string.size();
+    }
+
+    bool empty() const {
+        return entry()->string.empty();
+    }
+
+    unsigned long hash() const {
+        return entry()->hash;
+    }
+
+    // a name is either always interned or never, so an interned and an uninterned atom are never equal
+    bool operator==(const NBTAtom &other) const {
+        if (bits == other.bits)
+            return true;
+        return (bits & other.bits & UNINTERNED) != 0 && entry()->hash == other.entry()->hash &&
+               entry()->string == other.entry()->string;
+    }
+
+    bool operator!=(const NBTAtom &other) const {
+        return !(*this == other);
+    }
+
+    // comparing against plain strings doesn't intern them
+    bool operator==(std::string_view other) const {
+        return entry()->string == other;
+    }
+
+    bool operator==(const std::string &other) const {
+        return entry()->string == other;
+    }
+
+    bool operator==(const char *other) const {
+        return entry()->string == other;
+    }
+
+    bool operator!=(std::string_view other) const {
+        return entry()->string != other;
+    }
+
+    bool operator!=(const std::string &other) const {
+        return entry()->string != other;
+    }
+
+    bool operator!=(const char *other) const {
+        return entry()->string != other;
+    }
+
+    struct Entry {
+        std::string string;
+        unsigned long hash;
+        // uninterned entries only
+        mutable std::atomic<unsigned long> references{1};
+
+        Entry(std::string_view string, unsigned long hash) : string(string), hash(hash) {
+        }
+    };
+
+private:
+    // low bit of the entry pointer
+    static constexpr uintptr_t UNINTERNED = 1;
+
+    uintptr_t bits;
+
+    explicit NBTAtom(uintptr_t bits);
+
+    const Entry *entry() const {
+        return reinterpret_cast<const Entry *>(bits & ~UNINTERNED);
+    }
+
+    static uintptr_t emptyBits();
+
+    void retain() const noexcept;
+
+    void release() const noexcept;
+};
+
+namespace std {
+    template<>
+    struct hash<NBTAtom> {
+        size_t operator()(const NBTAtom &atom) const {
+            return atom.hash();
+        }
+    };
+}
@@ -0,0 +1,181 @@
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "NBTBatchLoader.h"
+#include "ThreadPool.h"
+#include "Compression.h"
+
+// the per-thread buffers outlive the batch, one that grew past this for a huge file is given back afterwards
+const unsigned long MAX_RETAINED_BUFFER = 16 * 1024 * 1024;
+
+static void trimBuffer(std::string &buffer) {
+    if (buffer.capacity() > MAX_RETAINED_BUFFER)
+        std::string().swap(buffer);
+}
+
+// whole file into out, reusing its capacity. plain reads beat mapping for the small files this is meant for
+static bool readFile(const std::string &path, std::string &out) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat status{};
+    bool ok = fstat(fd, &status) == 0;
+    out.resize(ok ? status.st_size : 0);
+
+    unsigned long done = 0;
+    while (ok && done < out.size()) {
+        ssize_t count = ::pread(fd, &out[done], out.size() - done, done);
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        if (count <= 0) {
+            // shrunk since the stat
+            ok = count == 0;
+            out.resize(done);
+            break;
+        }
+        done += count;
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+static std::optional<NBT> decode(const char *bytes, unsigned long size) {
+    // one inflate buffer per thread, reused across files and batches
+    thread_local std::string inflated;
+
+    CompressionFormat format = detectCompression(bytes, size);
+    if (format != CompressionFormat::NONE) {
+        if (!decompressBuffer(bytes, size, format, inflated))
+            return std::nullopt;
+        bytes = inflated.data();
+        size = inflated.size();
+    }
+
+    std::optional<NBT> tree;
+    if (size > 0 && bytes[0] == TAG_Compound)
+        tree = NBT::deserialize(bytes, size);
+
+    trimBuffer(inflated);
+    return tree;
+}
+
+NBTBatchLoader::NBTBatchLoader(ThreadPool &pool, NBTBatchOptions options) : pool(pool), options(options) {
+}
+
+void NBTBatchLoader::loadFiles(const std::vector<std::string> &paths, const Callback &callback) {
+    run(paths.size(), [&paths](unsigned long index) {
+        thread_local std::string fileBytes;
+
+        std::optional<NBT> tree;
+        if (readFile(paths[index], fileBytes))
+            tree = decode(fileBytes.data(), fileBytes.size());
+
+        trimBuffer(fileBytes);
+        return tree;
+    }, callback);
+}
+
+void NBTBatchLoader::loadBuffers(const std::vector<std::string_view> &buffers, const Callback &callback) {
+    run(buffers.size(), [&buffers](unsigned long index) {
+        return decode(buffers[index].data(), buffers[index].size());
+    }, callback);
+}
+
+void NBTBatchLoader::run(unsigned long count, const std::function<std::optional<NBT>(unsigned long)> &load,
+                         const Callback &callback) {
+    if (!options.ordered) {
+        pool.parallelFor(count, 1, [&](unsigned long begin, unsigned long end) {
+            for (unsigned long i = begin; i < end; i++) {
+                std::optional<NBT> tree = load(i);
+                callback(i, tree);
+            }
+        });
+        return;
+    }
+
+    // finished files wait in a ring of window slots until everything before them has been delivered.
+    // files are claimed in order, so the next one to deliver is always being loaded by a thread that isn't waiting
+    unsigned long window = options.maxInFlight > 0 ? options.maxInFlight : 2 * (pool.size() + 1);
+    std::vector<std::optional<NBT>> results(window);
+    std::vector<char> ready(window);
+    unsigned long nextDelivery = 0;
+    bool delivering = false;
+
+    // set once a load or callback threw. nothing is delivered after that, the waiting workers give up and
+    // parallelFor rethrows on the caller
+    bool aborted = false;
+
+    std::mutex mutex;
+    std::condition_variable delivered;
+
+    // ends a delivery run, whether the loop finishes or a callback throws out of it (while the lock is released)
+    struct DeliveryScope {
+        std::unique_lock<std::mutex> &lock;
+        bool &delivering;
+        bool &aborted;
+        std::condition_variable &delivered;
+        bool finished = false;
+
+        ~DeliveryScope() {
+            if (!lock.owns_lock())
+                lock.lock();
+            delivering = false;
+            if (!finished) {
+                aborted = true;
+                delivered.notify_all();
+            }
+        }
+    };
+
+    pool.parallelFor(count, 1, [&](unsigned long begin, unsigned long end) {
+        for (unsigned long i = begin; i < end; i++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                delivered.wait(lock, [&]() { return aborted || i < nextDelivery + window; });
+                if (aborted)
+                    return;
+            }
+
+            std::optional<NBT> tree;
+            try {
+                tree = load(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                aborted = true;
+                delivered.notify_all();
+                throw;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            results[i % window] = std::move(tree);
+            ready[i % window] = true;
+
+            // whoever is delivering already picks this one up when it gets to it
+            if (delivering || aborted)
+                continue;
+
+            delivering = true;
+            DeliveryScope scope{lock, delivering, aborted, delivered};
+            while (ready[nextDelivery % window]) {
+                unsigned long index = nextDelivery;
+                std::optional<NBT> next = std::move(results[index % window]);
+                results[index % window].reset();
+                ready[index % window] = false;
+
+                lock.unlock();
+                callback(index, next);
+                lock.lock();
+
+                nextDelivery++;
+                delivered.notify_all();
+            }
+            scope.finished = true;
+        }
+    });
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <functional>
+#include "NBT.h"
+
+class ThreadPool;
+
+struct NBTBatchOptions {
+    // deliver results in input order (one callback at a time) instead of as soon as each one is done
+    bool ordered = false;
+
+    // ordered only: at most this many files are being loaded or waiting for an earlier one to be delivered.
+    // workers that get too far ahead of a slow file (or a slow callback) wait for it. 0 = twice the pool size
+    unsigned long maxInFlight = 0;
+};
+
+// loads many NBT files (a playerdata directory, a world's worth of level/data files) on a pool. every worker runs
+// read -> inflate -> parse -> callback for one file at a time with its own reused read and inflate buffers, so the
+// stages of different files overlap across the workers
+class NBTBatchLoader {
+public:
+    // nullopt if the file couldn't be read, the compressed data is corrupt or it isn't a compound
+    using Callback = std::function<void(unsigned long index, std::optional<NBT> &tree)>;
+
+    explicit NBTBatchLoader(ThreadPool &pool, NBTBatchOptions options = NBTBatchOptions());
+
+    // blocks until every file has been delivered. unordered callbacks run concurrently on the worker threads (and
+    // the calling thread), ordered ones run one after another on whichever thread finished the next file.
+    // if a callback throws, the files not delivered yet are dropped and the exception is rethrown here
+    void loadFiles(const std::vector<std::string> &paths, const Callback &callback);
+
+    // same for files that are already in memory (gzip, zlib or uncompressed)
+    void loadBuffers(const std::vector<std::string_view> &buffers, const Callback &callback);
+
+private:
+    ThreadPool &pool;
+    NBTBatchOptions options;
+
+    void run(unsigned long count, const std::function<std::optional<NBT>(unsigned long index)> &load,
+             const Callback &callback);
+};
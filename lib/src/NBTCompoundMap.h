@@ -0,0 +1,268 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "NBTAtom.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// insertion ordered compound elements, so a document serializes back in the order it was read. entries are
+// contiguous, lookups scan a dense array of keys (atoms compare as pointers) and only compounds with more than
+// INDEX_THRESHOLD elements get a hash index on top.
+// a template only because NBT is still incomplete where it declares its compoundElements.
+// keys are const like in std::map, renaming an element in place would leave keys and the index stale
+template<typename Value>
+class NBTCompoundMap {
+public:
+    using value_type = std::pair<const NBTAtom, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    static constexpr unsigned long INDEX_THRESHOLD = 32;
+
+    NBTCompoundMap() = default;
+
+    NBTCompoundMap(const NBTCompoundMap &) = default;
+
+    NBTCompoundMap(NBTCompoundMap &&) noexcept = default;
+
+    NBTCompoundMap &operator=(NBTCompoundMap &&) noexcept = default;
+
+    // entries can't be assigned over, so copies are made fresh and moved in
+    NBTCompoundMap &operator=(const NBTCompoundMap &other) {
+        if (this != &other)
+            *this = NBTCompoundMap(other);
+        return *this;
+    }
+
+    iterator begin() {
+        return entries.begin();
+    }
+
+    iterator end() {
+        return entries.end();
+    }
+
+    const_iterator begin() const {
+        return entries.begin();
+    }
+
+    const_iterator end() const {
+        return entries.end();
+    }
+
+    unsigned long size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    void reserve(unsigned long count) {
+        entries.reserve(count);
+        keys.reserve(count);
+    }
+
+    void clear() {
+        entries.clear();
+        keys.clear();
+        index.clear();
+    }
+
+    iterator find(const NBTAtom &key) {
+        signed long position = findPosition(key);
+        return position < 0 ? entries.end() : entries.begin() + position;
+    }
+
+    const_iterator find(const NBTAtom &key) const {
+        signed long position = findPosition(key);
+        return position < 0 ? entries.end() : entries.begin() + position;
+    }
+
+    unsigned long count(const NBTAtom &key) const {
+        return findPosition(key) < 0 ? 0 : 1;
+    }
+
+    Value &at(const NBTAtom &key) {
+        signed long position = findPosition(key);
+        if (position < 0)
+            throw std::out_of_range("no compound element named " + key.str());
+        return entries[position].second;
+    }
+
+    const Value &at(const NBTAtom &key) const {
+        signed long position = findPosition(key);
+        if (position < 0)
+            throw std::out_of_range("no compound element named " + key.str());
+        return entries[position].second;
+    }
+
+    // appends a default constructed element if there's none with that key
+    Value &operator[](const NBTAtom &key) {
+        signed long position = findPosition(key);
+        if (position >= 0)
+            return entries[position].second;
+
+        append(key, Value());
+        return entries.back().second;
+    }
+
+    // inserts at the end unless the key exists already
+    std::pair<iterator, bool> emplace(const NBTAtom &key, Value value) {
+        signed long position = findPosition(key);
+        if (position >= 0)
+            return {entries.begin() + position, false};
+
+        append(key, std::move(value));
+        return {entries.end() - 1, true};
+    }
+
+    // existing elements keep their position
+    std::pair<iterator, bool> insert_or_assign(const NBTAtom &key, Value value) {
+        signed long position = findPosition(key);
+        if (position >= 0) {
+            entries[position].second = std::move(value);
+            return {entries.begin() + position, false};
+        }
+
+        append(key, std::move(value));
+        return {entries.end() - 1, true};
+    }
+
+    // keeps the order of the remaining elements, O(n). the entries behind it are moved into a new array, shifting
+    // them down would assign over their const keys
+    iterator erase(const_iterator element) {
+        unsigned long position = element - entries.cbegin();
+        keys.erase(keys.begin() + position);
+
+        std::vector<value_type> remaining;
+        remaining.reserve(entries.capacity());
+        for (unsigned long i = 0; i < entries.size(); i++) {
+            if (i != position)
+                remaining.emplace_back(std::move(entries[i]));
+        }
+        entries = std::move(remaining);
+
+        if (!index.empty())
+            rebuildIndex();
+        return entries.begin() + position;
+    }
+
+    unsigned long erase(const NBTAtom &key) {
+        signed long position = findPosition(key);
+        if (position < 0)
+            return 0;
+
+        erase(entries.cbegin() + position);
+        return 1;
+    }
+
+    // heap bytes of the container itself, not counting what the elements own
+    unsigned long heapBytes() const {
+        return entries.capacity() * sizeof(value_type) + keys.capacity() * sizeof(NBTAtom) +
+               index.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    std::vector<value_type> entries;
+
+    // same keys as entries, packed so a scan touches 8 bytes per element instead of a whole entry
+    std::vector<NBTAtom> keys;
+
+    // open addressing, entry position + 1 (0 = free slot). empty up to INDEX_THRESHOLD elements
+    std::vector<uint32_t> index;
+
+    static uintptr_t atomBits(const NBTAtom &atom) {
+        uintptr_t bits;
+        std::memcpy(&bits, &atom, sizeof(bits));
+        return bits;
+    }
+
+    signed long scan(const NBTAtom &key) const {
+        static_assert(sizeof(NBTAtom) == sizeof(uintptr_t), "atoms are compared as pointers");
+
+        const NBTAtom *data = keys.data();
+        unsigned long count = keys.size();
+        unsigned long i = 0;
+
+#if defined(__SSE2__) && UINTPTR_MAX == UINT64_MAX
+        // two keys per compare, a key matches if both of its 32 bit halves do. an uninterned key can equal a
+        // different entry with the same characters, so it takes the plain loop
+        if (key.interned()) {
+            __m128i needle = _mm_set1_epi64x((long long) atomBits(key));
+            for (; i + 2 <= count; i += 2) {
+                __m128i candidates = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(candidates, needle));
+                if ((mask & 0x00FF) == 0x00FF)
+                    return i;
+                if ((mask & 0xFF00) == 0xFF00)
+                    return i + 1;
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            if (data[i] == key)
+                return i;
+        }
+        return -1;
+    }
+
+    signed long findPosition(const NBTAtom &key) const {
+        if (index.empty())
+            return scan(key);
+
+        unsigned long mask = index.size() - 1;
+        for (unsigned long slot = key.hash() & mask;; slot = (slot + 1) & mask) {
+            uint32_t position = index[slot];
+            if (position == 0)
+                return -1;
+            if (keys[position - 1] == key)
+                return position - 1;
+        }
+    }
+
+    void indexPosition(uint32_t position) {
+        unsigned long mask = index.size() - 1;
+        unsigned long slot = keys[position].hash() & mask;
+        while (index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index[slot] = position + 1;
+    }
+
+    // at most half full
+    void rebuildIndex() {
+        index.clear();
+        if (keys.size() <= INDEX_THRESHOLD)
+            return;
+
+        unsigned long slots = 64;
+        while (slots < 2 * keys.size()) {
+            slots *= 2;
+        }
+
+        index.assign(slots, 0);
+        for (unsigned long i = 0; i < keys.size(); i++) {
+            indexPosition(i);
+        }
+    }
+
+    void append(const NBTAtom &key, Value value) {
+        entries.emplace_back(key, std::move(value));
+        keys.push_back(key);
+
+        if (keys.size() <= INDEX_THRESHOLD)
+            return;
+        if (2 * keys.size() > index.size())
+            rebuildIndex();
+        else
+            indexPosition(keys.size() - 1);
+    }
+};
@@ -0,0 +1,440 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include "BigEndian.h"
+#include "ByteSwap.h"
+
+// wire formats NBT comes in. the tree always stores payloads the java way (big endian, fixed width), the dialect
+// only decides how numbers and lengths look on the way in and out
+enum class NBTDialect {
+    JAVA, // big endian (files, java protocol)
+    BEDROCK, // little endian (bedrock level.dat after its 8 byte header, leveldb values)
+    NETWORK // bedrock protocol: little endian, ints, longs and all lengths as varints
+};
+
+// the codec in NBT.cpp is instantiated once per policy below, so every dialect gets its own parser and serializer
+// with the encoding decisions made at compile time. each policy reads a value at offset (advancing it), reports
+// the encoded size of a value and writes one through a writer with write(bytes, size)/writeValue(big endian value).
+// arrays are converted between the wire and big endian storage in bulk.
+// the reads don't look at the end of the input, the skip/check functions taking an end validate a document
+// before the codec gets to see it
+
+struct JavaDialect {
+    // wire payloads are exactly what the tree stores, they're copied as they are (and untouched source spans can
+    // be spliced)
+    static constexpr bool JAVA_PAYLOADS = true;
+
+    template<typename T>
+    static T read(const char *bytes, unsigned int &offset) {
+        T value = readBigEndian<T>(bytes + offset);
+        offset += sizeof(T);
+        return value;
+    }
+
+    static unsigned short readStringLength(const char *bytes, unsigned int &offset) {
+        return read<unsigned short>(bytes, offset);
+    }
+
+    static signed int readCount(const char *bytes, unsigned int &offset) {
+        return read<signed int>(bytes, offset);
+    }
+
+    template<typename T>
+    static bool skip(const char *, unsigned long end, unsigned int &offset) {
+        if (end - offset < sizeof(T))
+            return false;
+        offset += sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    static bool skipArray(const char *, unsigned long end, unsigned int &offset, unsigned long count) {
+        if ((end - offset) / sizeof(T) < count)
+            return false;
+        offset += sizeof(T) * count;
+        return true;
+    }
+
+    static bool checkStringLength(const char *bytes, unsigned long end, unsigned int &offset,
+                                  unsigned short &length) {
+        if (end - offset < 2)
+            return false;
+        length = readStringLength(bytes, offset);
+        return true;
+    }
+
+    static bool checkCount(const char *bytes, unsigned long end, unsigned int &offset, signed int &count) {
+        if (end - offset < 4)
+            return false;
+        count = readCount(bytes, offset);
+        return true;
+    }
+
+    template<typename T>
+    static void readArray(const char *bytes, unsigned int &offset, unsigned long count, char *stored) {
+        // an empty array has no storage to copy into
+        if (count > 0)
+            std::memcpy(stored, bytes + offset, sizeof(T) * count);
+        offset += sizeof(T) * count;
+    }
+
+    template<typename T>
+    static unsigned long size(T) {
+        return sizeof(T);
+    }
+
+    static unsigned long stringLengthSize(unsigned short) {
+        return 2;
+    }
+
+    static unsigned long countSize(signed int) {
+        return 4;
+    }
+
+    template<typename T>
+    static unsigned long arraySize(const char *, unsigned long count) {
+        return sizeof(T) * count;
+    }
+
+    template<typename T, typename Writer>
+    static void write(Writer &writer, T value) {
+        writer.writeValue(value);
+    }
+
+    template<typename Writer>
+    static void writeStringLength(Writer &writer, unsigned short length) {
+        writer.writeValue(length);
+    }
+
+    template<typename Writer>
+    static void writeCount(Writer &writer, signed int count) {
+        writer.writeValue(count);
+    }
+
+    template<typename T, typename Writer>
+    static void writeArray(Writer &writer, const char *stored, unsigned long count) {
+        writer.write(stored, sizeof(T) * count);
+    }
+};
+
+// little endian <-> big endian storage is a swap on every host, unlike the native conversions in ByteSwap.h
+template<typename T>
+inline void swapArray(const char *src, char *dst, unsigned long count) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (sizeof(T) == 2)
+        byteSwapArray16(src, dst, count);
+    else if (sizeof(T) == 4)
+        byteSwapArray32(src, dst, count);
+    else
+        byteSwapArray64(src, dst, count);
+#else
+    for (unsigned long i = 0; i < count; i++) {
+        writeBigEndian(dst + sizeof(T) * i, readLittleEndian<T>(src + sizeof(T) * i));
+    }
+#endif
+}
+
+struct BedrockDialect {
+    static constexpr bool JAVA_PAYLOADS = false;
+
+    // arrays are swapped through this much stack on the way out
+    static constexpr unsigned long SWAP_CHUNK_SIZE = 4096;
+
+    template<typename T>
+    static T read(const char *bytes, unsigned int &offset) {
+        T value = readLittleEndian<T>(bytes + offset);
+        offset += sizeof(T);
+        return value;
+    }
+
+    static unsigned short readStringLength(const char *bytes, unsigned int &offset) {
+        return read<unsigned short>(bytes, offset);
+    }
+
+    static signed int readCount(const char *bytes, unsigned int &offset) {
+        return read<signed int>(bytes, offset);
+    }
+
+    // same widths as java
+    template<typename T>
+    static bool skip(const char *bytes, unsigned long end, unsigned int &offset) {
+        return JavaDialect::skip<T>(bytes, end, offset);
+    }
+
+    template<typename T>
+    static bool skipArray(const char *bytes, unsigned long end, unsigned int &offset, unsigned long count) {
+        return JavaDialect::skipArray<T>(bytes, end, offset, count);
+    }
+
+    static bool checkStringLength(const char *bytes, unsigned long end, unsigned int &offset,
+                                  unsigned short &length) {
+        if (end - offset < 2)
+            return false;
+        length = readStringLength(bytes, offset);
+        return true;
+    }
+
+    static bool checkCount(const char *bytes, unsigned long end, unsigned int &offset, signed int &count) {
+        if (end - offset < 4)
+            return false;
+        count = readCount(bytes, offset);
+        return true;
+    }
+
+    template<typename T>
+    static void readArray(const char *bytes, unsigned int &offset, unsigned long count, char *stored) {
+        if constexpr (sizeof(T) == 1) {
+            JavaDialect::readArray<T>(bytes, offset, count, stored);
+        } else {
+            swapArray<T>(bytes + offset, stored, count);
+            offset += sizeof(T) * count;
+        }
+    }
+
+    template<typename T>
+    static unsigned long size(T) {
+        return sizeof(T);
+    }
+
+    static unsigned long stringLengthSize(unsigned short) {
+        return 2;
+    }
+
+    static unsigned long countSize(signed int) {
+        return 4;
+    }
+
+    template<typename T>
+    static unsigned long arraySize(const char *, unsigned long count) {
+        return sizeof(T) * count;
+    }
+
+    template<typename T, typename Writer>
+    static void write(Writer &writer, T value) {
+        char bytes[sizeof(T)];
+        writeLittleEndian(bytes, value);
+        writer.write(bytes, sizeof(T));
+    }
+
+    template<typename Writer>
+    static void writeStringLength(Writer &writer, unsigned short length) {
+        write(writer, length);
+    }
+
+    template<typename Writer>
+    static void writeCount(Writer &writer, signed int count) {
+        write(writer, count);
+    }
+
+    template<typename T, typename Writer>
+    static void writeArray(Writer &writer, const char *stored, unsigned long count) {
+        if constexpr (sizeof(T) == 1) {
+            writer.write(stored, count);
+        } else {
+            char chunk[SWAP_CHUNK_SIZE];
+            for (unsigned long done = 0; done < count;) {
+                unsigned long chunkCount = std::min(count - done, SWAP_CHUNK_SIZE / sizeof(T));
+                swapArray<T>(stored + sizeof(T) * done, chunk, chunkCount);
+                writer.write(chunk, sizeof(T) * chunkCount);
+                done += chunkCount;
+            }
+        }
+    }
+};
+
+inline uint64_t zigzagEncode(signed long value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+inline signed long zigzagDecode(uint64_t value) {
+    return (signed long) (value >> 1) ^ -(signed long) (value & 1);
+}
+
+// LEB128, at most maxBytes long so a corrupt varint can't run on. only for input that went through the checked
+// version below
+inline uint64_t readVarUnsigned(const char *bytes, unsigned int &offset, unsigned int maxBytes) {
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < maxBytes; i++) {
+        uint8_t byte = bytes[offset];
+        offset++;
+
+        value |= (uint64_t) (byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    return value;
+}
+
+// false if the varint runs past end or isn't terminated within maxBytes
+inline bool readVarUnsigned(const char *bytes, unsigned long end, unsigned int &offset, unsigned int maxBytes,
+                            uint64_t &value) {
+    value = 0;
+    for (unsigned int i = 0; i < maxBytes && offset < end; i++) {
+        uint8_t byte = bytes[offset];
+        offset++;
+
+        value |= (uint64_t) (byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline unsigned long varUnsignedSize(uint64_t value) {
+    unsigned long size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+template<typename Writer>
+inline void writeVarUnsigned(Writer &writer, uint64_t value) {
+    char bytes[10];
+    unsigned long size = 0;
+    while (value >= 0x80) {
+        bytes[size] = (char) (value | 0x80);
+        value >>= 7;
+        size++;
+    }
+    bytes[size] = (char) value;
+    writer.write(bytes, size + 1);
+}
+
+// bedrock's network NBT: like BedrockDialect, except ints and longs are zigzag varints, string lengths are
+// unsigned varints and list/array counts are zigzag varints. shorts, floats and doubles stay little endian
+struct NetworkDialect : BedrockDialect {
+    template<typename T>
+    static constexpr bool IS_VARINT = std::is_same<T, signed int>::value || std::is_same<T, signed long>::value;
+
+    template<typename T>
+    static T read(const char *bytes, unsigned int &offset) {
+        if constexpr (IS_VARINT<T>)
+            return (T) zigzagDecode(readVarUnsigned(bytes, offset, sizeof(T) == 4 ? 5 : 10));
+        else
+            return BedrockDialect::read<T>(bytes, offset);
+    }
+
+    static unsigned short readStringLength(const char *bytes, unsigned int &offset) {
+        return (unsigned short) readVarUnsigned(bytes, offset, 5);
+    }
+
+    static signed int readCount(const char *bytes, unsigned int &offset) {
+        return read<signed int>(bytes, offset);
+    }
+
+    template<typename T>
+    static bool skip(const char *bytes, unsigned long end, unsigned int &offset) {
+        if constexpr (IS_VARINT<T>) {
+            uint64_t value;
+            return readVarUnsigned(bytes, end, offset, sizeof(T) == 4 ? 5 : 10, value) &&
+                   (sizeof(T) == 8 || value <= UINT32_MAX);
+        } else {
+            return BedrockDialect::skip<T>(bytes, end, offset);
+        }
+    }
+
+    // every varint takes at least a byte, so a count past the end fails before long
+    template<typename T>
+    static bool skipArray(const char *bytes, unsigned long end, unsigned int &offset, unsigned long count) {
+        if constexpr (IS_VARINT<T>) {
+            for (unsigned long i = 0; i < count; i++) {
+                if (!skip<T>(bytes, end, offset))
+                    return false;
+            }
+            return true;
+        } else {
+            return BedrockDialect::skipArray<T>(bytes, end, offset, count);
+        }
+    }
+
+    // the varint has room for more than a 16 bit length, anything above it is rejected rather than cut off
+    static bool checkStringLength(const char *bytes, unsigned long end, unsigned int &offset,
+                                  unsigned short &length) {
+        uint64_t value;
+        if (!readVarUnsigned(bytes, end, offset, 5, value) || value > UINT16_MAX)
+            return false;
+        length = (unsigned short) value;
+        return true;
+    }
+
+    static bool checkCount(const char *bytes, unsigned long end, unsigned int &offset, signed int &count) {
+        uint64_t value;
+        if (!readVarUnsigned(bytes, end, offset, 5, value) || value > UINT32_MAX)
+            return false;
+        count = (signed int) zigzagDecode(value);
+        return true;
+    }
+
+    template<typename T>
+    static void readArray(const char *bytes, unsigned int &offset, unsigned long count, char *stored) {
+        if constexpr (IS_VARINT<T>) {
+            for (unsigned long i = 0; i < count; i++) {
+                writeBigEndian(stored + sizeof(T) * i, read<T>(bytes, offset));
+            }
+        } else {
+            BedrockDialect::readArray<T>(bytes, offset, count, stored);
+        }
+    }
+
+    template<typename T>
+    static unsigned long size(T value) {
+        if constexpr (IS_VARINT<T>)
+            return varUnsignedSize(zigzagEncode(value));
+        else
+            return sizeof(T);
+    }
+
+    static unsigned long stringLengthSize(unsigned short length) {
+        return varUnsignedSize(length);
+    }
+
+    static unsigned long countSize(signed int count) {
+        return size(count);
+    }
+
+    template<typename T>
+    static unsigned long arraySize(const char *stored, unsigned long count) {
+        if constexpr (!IS_VARINT<T>)
+            return sizeof(T) * count;
+
+        unsigned long total = 0;
+        for (unsigned long i = 0; i < count; i++) {
+            total += size(readBigEndian<T>(stored + sizeof(T) * i));
+        }
+        return total;
+    }
+
+    template<typename T, typename Writer>
+    static void write(Writer &writer, T value) {
+        if constexpr (IS_VARINT<T>)
+            writeVarUnsigned(writer, zigzagEncode(value));
+        else
+            BedrockDialect::write(writer, value);
+    }
+
+    template<typename Writer>
+    static void writeStringLength(Writer &writer, unsigned short length) {
+        writeVarUnsigned(writer, length);
+    }
+
+    template<typename Writer>
+    static void writeCount(Writer &writer, signed int count) {
+        write(writer, count);
+    }
+
+    template<typename T, typename Writer>
+    static void writeArray(Writer &writer, const char *stored, unsigned long count) {
+        if constexpr (IS_VARINT<T>) {
+            for (unsigned long i = 0; i < count; i++) {
+                write(writer, readBigEndian<T>(stored + sizeof(T) * i));
+            }
+        } else {
+            BedrockDialect::writeArray<T>(writer, stored, count);
+        }
+    }
+};
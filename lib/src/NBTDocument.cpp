@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include "NBTDocument.h"
+#include "BigEndian.h"
+#include "ByteSwap.h"
+#include "Compression.h"
+
+NBTNode::NBTNode() : longValue(0) {
+}
+
+char NBTNode::tagID() const {
+    return tag;
+}
+
+std::string_view NBTNode::name() const {
+    return std::string_view(nameBytes, nameLength);
+}
+
+char NBTNode::listType() const {
+    assert(tag == TAG_List);
+
+    return elementType;
+}
+
+signed int NBTNode::childrenCount() const {
+    assert(tag == TAG_List || tag == TAG_Compound || tag == TAG_Byte_Array || tag == TAG_Int_Array ||
+           tag == TAG_Long_Array);
+
+    return (signed int) count;
+}
+
+char NBTNode::getByte() const {
+    assert(tag == TAG_Byte);
+
+    return byteValue;
+}
+
+signed short NBTNode::getShort() const {
+    assert(tag == TAG_Short);
+
+    return shortValue;
+}
+
+signed int NBTNode::getInt() const {
+    assert(tag == TAG_Int);
+
+    return intValue;
+}
+
+signed long NBTNode::getLong() const {
+    assert(tag == TAG_Long);
+
+    return longValue;
+}
+
+float NBTNode::getFloat() const {
+    assert(tag == TAG_Float);
+
+    return floatValue;
+}
+
+double NBTNode::getDouble() const {
+    assert(tag == TAG_Double);
+
+    return doubleValue;
+}
+
+std::string_view NBTNode::getString() const {
+    assert(tag == TAG_String);
+
+    return std::string_view(bytes, count);
+}
+
+const char *NBTNode::getByteArray() const {
+    assert(tag == TAG_Byte_Array);
+
+    return bytes;
+}
+
+const signed int *NBTNode::getIntArray() const {
+    assert(tag == TAG_Int_Array);
+
+    return ints;
+}
+
+const signed long *NBTNode::getLongArray() const {
+    assert(tag == TAG_Long_Array);
+
+    return longs;
+}
+
+std::vector<char> NBTNode::getByteVector() const {
+    return std::vector<char>(getByteArray(), getByteArray() + count);
+}
+
+std::vector<signed int> NBTNode::getIntVector() const {
+    return std::vector<signed int>(getIntArray(), getIntArray() + count);
+}
+
+std::vector<signed long> NBTNode::getLongVector() const {
+    return std::vector<signed long>(getLongArray(), getLongArray() + count);
+}
+
+bool NBTNode::unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count,
+                            PackedLayout layout) const {
+    return ::unpackPalette(getLongArray(), this->count, bitsPerEntry, layout, out, count);
+}
+
+const NBTNode *NBTNode::find(std::string_view childName) const {
+    assert(tag == TAG_Compound);
+
+    for (const NBTNode &child: *this) {
+        if (child.name() == childName)
+            return &child;
+    }
+    return nullptr;
+}
+
+const NBTNode *NBTNode::begin() const {
+    assert(tag == TAG_List || tag == TAG_Compound);
+
+    return children;
+}
+
+const NBTNode *NBTNode::end() const {
+    return begin() + count;
+}
+
+template<typename T>
+static void writeBigEndianValue(std::vector<char> &valueBytes, const T &value) {
+    valueBytes.resize(sizeof(T));
+    writeBigEndian(valueBytes.data(), value);
+}
+
+template<typename T>
+static void writeBigEndianArray(std::vector<char> &valueBytes, const T *values, unsigned int count) {
+    valueBytes.resize(sizeof(T) * count);
+    for (unsigned int i = 0; i < count; i++) {
+        writeBigEndian(valueBytes.data() + sizeof(T) * i, values[i]);
+    }
+}
+
+NBT NBTNode::toNBT() const {
+    NBT nbt(tag);
+    if (nameBytes != nullptr)
+        nbt.name = NBTAtom(name());
+
+    switch (tag) {
+        case TAG_Byte:
+            nbt.valueBytes.push_back(byteValue);
+            break;
+        case TAG_Short:
+            writeBigEndianValue(nbt.valueBytes, shortValue);
+            break;
+        case TAG_Int:
+            writeBigEndianValue(nbt.valueBytes, intValue);
+            break;
+        case TAG_Long:
+            writeBigEndianValue(nbt.valueBytes, longValue);
+            break;
+        case TAG_Float:
+            writeBigEndianValue(nbt.valueBytes, floatValue);
+            break;
+        case TAG_Double:
+            writeBigEndianValue(nbt.valueBytes, doubleValue);
+            break;
+        case TAG_String:
+        case TAG_Byte_Array:
+            nbt.valueBytes.assign(bytes, bytes + count);
+            break;
+        case TAG_Int_Array:
+            writeBigEndianArray(nbt.valueBytes, ints, count);
+            break;
+        case TAG_Long_Array:
+            writeBigEndianArray(nbt.valueBytes, longs, count);
+            break;
+        case TAG_List: {
+            nbt.listType = elementType;
+            nbt.childrenCount = (signed int) count;
+            nbt.listChildren.reserve(count);
+
+            for (const NBTNode &child: *this) {
+                nbt.listChildren.push_back(child.toNBT());
+            }
+            break;
+        }
+        case TAG_Compound: {
+            for (const NBTNode &child: *this) {
+                nbt.compoundElements.emplace(NBTAtom(child.name()), child.toNBT());
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    return nbt;
+}
+
+NBTDocument::NBTDocument(unsigned long arenaBlockSize) : nodeArena(arenaBlockSize) {
+}
+
+// every read is checked against the end of the input; malformed input throws like corrupt compressed input does
+static void require(bool valid) {
+    if (!valid)
+        throw std::runtime_error("malformed NBT input");
+}
+
+static bool has(const char *cursor, const char *bufferEnd, unsigned long size) {
+    return (unsigned long) (bufferEnd - cursor) >= size;
+}
+
+// the fewest bytes a value of this tag can take, 0 for tags that can't be values
+static unsigned long minimumValueSize(char tagID) {
+    switch (tagID) {
+        case TAG_Byte:
+        case TAG_Compound:
+            return 1;
+        case TAG_Short:
+        case TAG_String:
+            return 2;
+        case TAG_Int:
+        case TAG_Float:
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array:
+            return 4;
+        case TAG_List:
+            return 5;
+        case TAG_Long:
+        case TAG_Double:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static unsigned short readShortLength(const char *&cursor, const char *bufferEnd) {
+    require(has(cursor, bufferEnd, 2));
+    unsigned short length = readBigEndian<unsigned short>(cursor);
+    cursor += 2;
+    require(has(cursor, bufferEnd, length));
+    return length;
+}
+
+static unsigned int readArrayLength(const char *&cursor, const char *bufferEnd, unsigned long elementSize) {
+    require(has(cursor, bufferEnd, 4));
+    signed int length = readBigEndian<signed int>(cursor);
+    cursor += 4;
+    require(length >= 0 && has(cursor, bufferEnd, elementSize * (unsigned long) length));
+    return (unsigned int) length;
+}
+
+template<typename T>
+static T readScalar(const char *&cursor, const char *bufferEnd) {
+    require(has(cursor, bufferEnd, sizeof(T)));
+    T value = readBigEndian<T>(cursor);
+    cursor += sizeof(T);
+    return value;
+}
+
+// count has been checked against the input by readArrayLength
+template<typename T>
+static const T *readNativeArray(NBTArena &arena, unsigned int count, const char *&cursor) {
+    T *values = arena.allocateArray<T>(count);
+    readBigEndianArray(cursor, values, count);
+    cursor += sizeof(T) * count;
+    return values;
+}
+
+// named tags always get a non-null name (even an empty one) so list elements can be told apart
+static const char *copyName(NBTArena &arena, unsigned short &nameLength, const char *&cursor,
+                            const char *bufferEnd) {
+    nameLength = readShortLength(cursor, bufferEnd);
+    const char *nameBytes = nameLength > 0 ? arena.copyBytes(cursor, nameLength) : "";
+    cursor += nameLength;
+    return nameBytes;
+}
+
+const NBTNode &NBTDocument::parse(const char *byteArray, unsigned long byteArraySize) {
+    clear();
+
+    // inflated is kept between parses, so its capacity is reused
+    CompressionFormat format = detectCompression(byteArray, byteArraySize);
+    if (format != CompressionFormat::NONE) {
+        if (!decompressBuffer(byteArray, byteArraySize, format, inflated))
+            throw std::runtime_error("corrupt compressed input");
+        byteArray = inflated.data();
+        byteArraySize = inflated.size();
+    }
+
+    require(byteArraySize > 0 && byteArray[0] == TAG_Compound);
+
+    const char *cursor = byteArray + 1;
+    const char *bufferEnd = byteArray + byteArraySize;
+
+    try {
+        rootNode = new(nodeArena.allocateArray<NBTNode>(1)) NBTNode();
+        rootNode->tag = TAG_Compound;
+        rootNode->nameBytes = copyName(nodeArena, rootNode->nameLength, cursor, bufferEnd);
+
+        parseValue(*rootNode, cursor, bufferEnd, 0);
+    } catch (...) {
+        clear();
+        throw;
+    }
+
+    return *rootNode;
+}
+
+void NBTDocument::parseValue(NBTNode &node, const char *&cursor, const char *bufferEnd, unsigned long depth) {
+    switch (node.tag) {
+        case TAG_Byte:
+            node.byteValue = readScalar<char>(cursor, bufferEnd);
+            break;
+        case TAG_Short:
+            node.shortValue = readScalar<signed short>(cursor, bufferEnd);
+            break;
+        case TAG_Int:
+            node.intValue = readScalar<signed int>(cursor, bufferEnd);
+            break;
+        case TAG_Long:
+            node.longValue = readScalar<signed long>(cursor, bufferEnd);
+            break;
+        case TAG_Float:
+            node.floatValue = readScalar<float>(cursor, bufferEnd);
+            break;
+        case TAG_Double:
+            node.doubleValue = readScalar<double>(cursor, bufferEnd);
+            break;
+        case TAG_String:
+            node.count = readShortLength(cursor, bufferEnd);
+            node.bytes = nodeArena.copyBytes(cursor, node.count);
+            cursor += node.count;
+            break;
+        case TAG_Byte_Array:
+            node.count = readArrayLength(cursor, bufferEnd, 1);
+            node.bytes = nodeArena.copyBytes(cursor, node.count);
+            cursor += node.count;
+            break;
+        case TAG_Int_Array:
+            node.count = readArrayLength(cursor, bufferEnd, sizeof(signed int));
+            node.ints = readNativeArray<signed int>(nodeArena, node.count, cursor);
+            break;
+        case TAG_Long_Array:
+            node.count = readArrayLength(cursor, bufferEnd, sizeof(signed long));
+            node.longs = readNativeArray<signed long>(nodeArena, node.count, cursor);
+            break;
+        case TAG_List: {
+            require(has(cursor, bufferEnd, 5) && depth < MAX_DEPTH);
+            node.elementType = cursor[0];
+            node.count = (unsigned int) std::max(readBigEndian<signed int>(cursor + 1), 0);
+            cursor += 5;
+
+            // caps the allocation below by what the rest of the input could hold
+            if (node.count > 0) {
+                unsigned long elementSize = minimumValueSize(node.elementType);
+                require(elementSize > 0 && node.count <= (unsigned long) (bufferEnd - cursor) / elementSize);
+            }
+
+            // the count is known up front, so children go straight into their final place
+            node.children = nodeArena.allocateArray<NBTNode>(node.count);
+            for (unsigned int i = 0; i < node.count; i++) {
+                NBTNode *child = new(node.children + i) NBTNode();
+                child->tag = node.elementType;
+                parseValue(*child, cursor, bufferEnd, depth + 1);
+            }
+            break;
+        }
+        case TAG_Compound: {
+            require(depth < MAX_DEPTH);
+
+            // elements are collected on the shared scratch stack until TAG_End tells us how many there are
+            unsigned long scratchStart = scratch.size();
+
+            while (true) {
+                require(cursor < bufferEnd);
+                char childTagID = *cursor;
+                cursor++;
+
+                if (childTagID == TAG_End)
+                    break;
+                require(minimumValueSize(childTagID) > 0);
+
+                NBTNode child;
+                child.tag = childTagID;
+                child.nameBytes = copyName(nodeArena, child.nameLength, cursor, bufferEnd);
+
+                parseValue(child, cursor, bufferEnd, depth + 1);
+                scratch.push_back(child);
+            }
+
+            node.count = (unsigned int) (scratch.size() - scratchStart);
+            node.children = nodeArena.allocateArray<NBTNode>(node.count);
+            std::copy(scratch.begin() + (long) scratchStart, scratch.end(), node.children);
+            scratch.resize(scratchStart, NBTNode());
+            break;
+        }
+        default:
+            require(false);
+    }
+}
+
+const NBTNode &NBTDocument::root() const {
+    assert(rootNode != nullptr);
+
+    return *rootNode;
+}
+
+void NBTDocument::clear() {
+    rootNode = nullptr;
+    scratch.clear();
+    nodeArena.reset();
+}
+
+const NBTArena &NBTDocument::arena() const {
+    return nodeArena;
+}
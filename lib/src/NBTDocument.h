@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "NBT.h"
+#include "NBTArena.h"
+
+// node of an NBTDocument. nodes, names and payloads all live in the document's arena,
+// so a node is only valid as long as the document it came from (and until the next parse/clear).
+// scalars are decoded once while parsing and stored inline, arrays are stored in native byte order
+class NBTNode {
+public:
+    char tagID() const;
+
+    // empty for list elements
+    std::string_view name() const;
+
+    char listType() const;
+
+    // number of list children, compound elements or array elements
+    signed int childrenCount() const;
+
+    char getByte() const;
+
+    signed short getShort() const;
+
+    signed int getInt() const;
+
+    signed long getLong() const;
+
+    float getFloat() const;
+
+    double getDouble() const;
+
+    std::string_view getString() const;
+
+    // array payloads, childrenCount() elements long
+    const char *getByteArray() const;
+
+    const signed int *getIntArray() const;
+
+    const signed long *getLongArray() const;
+
+    std::vector<char> getByteVector() const;
+
+    std::vector<signed int> getIntVector() const;
+
+    std::vector<signed long> getLongVector() const;
+
+    // unpack count bit-packed palette indices from a TAG_Long_Array, false if it holds fewer or bitsPerEntry isn't
+    // 1 - 16
+    bool unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count,
+                       PackedLayout layout = PackedLayout::PADDED) const;
+
+    // compound lookup, nullptr if there's no element with that name
+    const NBTNode *find(std::string_view childName) const;
+
+    const NBTNode *begin() const;
+
+    const NBTNode *end() const;
+
+    NBT toNBT() const;
+
+private:
+    friend class NBTDocument;
+
+    const char *nameBytes = nullptr; // nullptr for list elements
+
+    union {
+        char byteValue;
+        signed short shortValue;
+        signed int intValue;
+        signed long longValue;
+        float floatValue;
+        double doubleValue;
+        const char *bytes; // TAG_String / TAG_Byte_Array
+        const signed int *ints;
+        const signed long *longs;
+        NBTNode *children;
+    };
+
+    unsigned int count = 0; // string length, array length or children count
+    unsigned short nameLength = 0;
+    char tag = TAG_End;
+    char elementType = TAG_End; // list type
+
+    NBTNode();
+};
+
+static_assert(sizeof(NBTNode) <= 32, "NBTNode is meant to stay within half a cache line");
+
+// parsed NBT tree whose memory is carved out of a single arena.
+// tearing it down (or parsing the next file into it) costs O(1) allocator calls instead of one per node
+class NBTDocument {
+public:
+    explicit NBTDocument(unsigned long arenaBlockSize = 64 * 1024);
+
+    NBTDocument(const NBTDocument &) = delete;
+
+    NBTDocument &operator=(const NBTDocument &) = delete;
+
+    NBTDocument(NBTDocument &&) noexcept = default;
+
+    NBTDocument &operator=(NBTDocument &&) noexcept = default;
+
+    // replaces the current contents. gzip'd input is inflated like NBT::deserialize does, and likewise throws
+    // std::runtime_error if it doesn't inflate completely. malformed NBT (truncated values, unknown tags, nesting
+    // past MAX_DEPTH) throws std::runtime_error as well, leaving the document empty
+    const NBTNode &parse(const char *byteArray, unsigned long byteArraySize);
+
+    const NBTNode &root() const;
+
+    // drop the tree but keep the arena blocks for the next parse
+    void clear();
+
+    const NBTArena &arena() const;
+
+    static constexpr unsigned long MAX_DEPTH = 512;
+
+private:
+    NBTArena nodeArena;
+    NBTNode *rootNode = nullptr;
+
+    // reused between parses
+    std::string inflated{};
+    std::vector<NBTNode> scratch{};
+
+    void parseValue(NBTNode &node, const char *&cursor, const char *bufferEnd, unsigned long depth);
+};
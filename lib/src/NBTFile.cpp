@@ -0,0 +1,204 @@
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "NBTFile.h"
+#include "NBTSink.h"
+#include "Compression.h"
+#include "NBTStats.h"
+
+NBTFile::NBTFile() = default;
+
+bool NBTFile::open(const std::string &path) {
+    close();
+
+    if (!mapped.open(path))
+        return false;
+    mapped.adviseSequential();
+
+    CompressionFormat format = detectCompression(mapped.data(), mapped.size());
+    if (format == CompressionFormat::NONE) {
+        bytes = mapped.data();
+        byteCount = mapped.size();
+    } else {
+        // the compressed bytes aren't needed once inflated. timed into the caller's NBTStatsCall, if there is one
+        bool ok;
+        {
+            NBTTraceSpan span("inflate", &NBTStats::inflateNanos);
+            ok = decompressBuffer(mapped.data(), mapped.size(), format, inflated);
+        }
+        compressedByteCount = mapped.size();
+        mapped.close();
+        if (!ok) {
+            close();
+            return false;
+        }
+
+        bytes = inflated.data();
+        byteCount = inflated.size();
+    }
+
+    if (byteCount == 0 || bytes[0] != TAG_Compound) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void NBTFile::close() {
+    mapped.close();
+    inflated.clear();
+    bytes = nullptr;
+    byteCount = 0;
+    compressedByteCount = 0;
+}
+
+bool NBTFile::isOpen() const {
+    return bytes != nullptr;
+}
+
+const char *NBTFile::data() const {
+    return bytes;
+}
+
+unsigned long NBTFile::size() const {
+    return byteCount;
+}
+
+unsigned long NBTFile::compressedSize() const {
+    return compressedByteCount;
+}
+
+NBTView NBTFile::root() const {
+    assert(isOpen());
+
+    return NBTView::root(bytes, byteCount);
+}
+
+static std::string directoryOf(const std::string &path) {
+    unsigned long slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static bool syncPath(const std::string &path, int flags) {
+    int fd = ::open(path.c_str(), flags);
+    if (fd < 0)
+        return false;
+
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+NBTSaveBatch::NBTSaveBatch(bool durable) : durable(durable) {
+}
+
+NBTSaveBatch::~NBTSaveBatch() {
+    discard();
+}
+
+int NBTSaveBatch::createTempFile(const std::string &path, std::string &tempPath) {
+    tempPath = path + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0)
+        return -1;
+
+    // mkstemp makes it private, the replacement should be as readable as what it replaces
+    struct stat original{};
+    fchmod(fd, stat(path.c_str(), &original) == 0 ? original.st_mode & 07777 : 0644);
+    return fd;
+}
+
+bool NBTSaveBatch::finishTempFile(const std::string &path, const std::string &tempPath, int fd, bool ok) {
+#ifdef __linux__
+    // start writing back now so the fsync in commit() mostly just waits for it, for all files at once
+    if (ok && durable)
+        sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+
+    ok = ::close(fd) == 0 && ok;
+    if (!ok) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    pending.push_back({path, tempPath});
+    return true;
+}
+
+bool NBTSaveBatch::add(const std::string &path, const NBT &root, const CompressionOptions &options) {
+    std::string tempPath;
+    int fd = createTempFile(path, tempPath);
+    if (fd < 0)
+        return false;
+
+    // streamed, the whole document is never in memory as bytes
+    FileDescriptorSink fileSink(fd);
+    bool ok;
+    if (options.format == CompressionFormat::NONE) {
+        ok = NBT::serializeInto(root, fileSink);
+    } else {
+        DeflateSink deflateSink(fileSink, options);
+        ok = NBT::serializeInto(root, deflateSink);
+    }
+
+    return finishTempFile(path, tempPath, fd, ok);
+}
+
+bool NBTSaveBatch::add(const std::string &path, const char *bytes, unsigned long size) {
+    std::string tempPath;
+    int fd = createTempFile(path, tempPath);
+    if (fd < 0)
+        return false;
+
+    FileDescriptorSink fileSink(fd);
+    return finishTempFile(path, tempPath, fd, fileSink.write(bytes, size));
+}
+
+bool NBTSaveBatch::commit() {
+    // every temp file is on disk before the first one replaces anything
+    if (durable) {
+        for (const PendingFile &file: pending) {
+            if (!syncPath(file.tempPath, O_WRONLY)) {
+                discard();
+                return false;
+            }
+        }
+    }
+
+    bool ok = true;
+    std::set<std::string> directories;
+    for (const PendingFile &file: pending) {
+        if (rename(file.tempPath.c_str(), file.path.c_str()) != 0) {
+            unlink(file.tempPath.c_str());
+            ok = false;
+            continue;
+        }
+        directories.insert(directoryOf(file.path));
+    }
+    pending.clear();
+
+    // the renames themselves
+    if (durable) {
+        for (const std::string &directory: directories) {
+            ok = syncPath(directory, O_RDONLY | O_DIRECTORY) && ok;
+        }
+    }
+
+    return ok;
+}
+
+void NBTSaveBatch::discard() {
+    for (const PendingFile &file: pending) {
+        unlink(file.tempPath.c_str());
+    }
+    pending.clear();
+}
+
+unsigned long NBTSaveBatch::pendingCount() const {
+    return pending.size();
+}
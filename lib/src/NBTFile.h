@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "NBTView.h"
+#include "MappedFile.h"
+
+struct CompressionOptions;
+
+// an NBT file opened for reading. uncompressed files are memory mapped and read in place, compressed ones are
+// inflated into memory once. views and NBTDocument/NBTTape parses of data() stay valid until the file is closed
+class NBTFile {
+public:
+    NBTFile();
+
+    // false if the file can't be read, fails to inflate or doesn't start with a compound
+    bool open(const std::string &path);
+
+    void close();
+
+    bool isOpen() const;
+
+    // uncompressed NBT bytes
+    const char *data() const;
+
+    unsigned long size() const;
+
+    // size of the file on disk if it was compressed, 0 otherwise
+    unsigned long compressedSize() const;
+
+    NBTView root() const;
+
+private:
+    MappedFile mapped;
+    std::string inflated;
+    const char *bytes = nullptr;
+    unsigned long byteCount = 0;
+    unsigned long compressedByteCount = 0;
+};
+
+// replaces files by writing a temp file next to each one and renaming it over the original, so readers and
+// crashes only ever see the old or the new contents. with durable on, commit() flushes all temp files with one
+// fsync pass (their writeback was already started as they were written) before anything is renamed, then
+// syncs each directory once. not thread safe, use one batch per thread
+class NBTSaveBatch {
+public:
+    // without durable a crash can leave renamed but empty files behind on some filesystems
+    explicit NBTSaveBatch(bool durable = true);
+
+    // removes the temp files of anything not committed
+    ~NBTSaveBatch();
+
+    NBTSaveBatch(const NBTSaveBatch &) = delete;
+
+    NBTSaveBatch &operator=(const NBTSaveBatch &) = delete;
+
+    // streams the document into a temp file (compressed unless options.format is NONE). false and nothing
+    // pending if it couldn't be written
+    bool add(const std::string &path, const NBT &root, const CompressionOptions &options);
+
+    bool add(const std::string &path, const char *bytes, unsigned long size);
+
+    // replaces every added file. false if any of them failed, in which case nothing was replaced if the sync
+    // failed, and only the ones whose rename failed weren't if a rename did
+    bool commit();
+
+    void discard();
+
+    unsigned long pendingCount() const;
+
+private:
+    // temp files are closed once written, so a big batch doesn't run into the descriptor limit
+    struct PendingFile {
+        std::string path;
+        std::string tempPath;
+    };
+
+    bool durable;
+    std::vector<PendingFile> pending{};
+
+    // open temp file next to path, -1 on failure
+    int createTempFile(const std::string &path, std::string &tempPath);
+
+    // closes fd and queues the temp file if ok, removes it otherwise
+    bool finishTempFile(const std::string &path, const std::string &tempPath, int fd, bool ok);
+};
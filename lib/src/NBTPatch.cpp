@@ -0,0 +1,729 @@
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include "NBTPatch.h"
+#include "BigEndian.h"
+
+// patch layout (big endian):
+//   'N' 'B' 'P' version, u8 root name changed [u16 length, name], node patch
+//   node patch: OP_REPLACE tag payload
+//             | OP_COMPOUND u32 count {OP_SET name tag payload | OP_REMOVE name | OP_EDIT name node patch
+//                                    | OP_ORDER u32 count, u32 positions}
+//             | OP_LIST u32 count {OP_SPLICE u32 start, u32 removed, u32 inserted, payloads | OP_EDIT u32 index, node patch}
+//             | OP_ARRAY u32 count {OP_SPLICE u32 start, u32 removed, u32 inserted, raw elements}
+// edits are applied in order, indices refer to the list/array as left by the previous edit. OP_SET appends new keys,
+// when that doesn't leave the elements in the order of the new document OP_ORDER lists the current position of
+// each element in the new order
+const char PATCH_MAGIC[3] = {'N', 'B', 'P'};
+const char PATCH_VERSION = 1;
+
+const char OP_REPLACE = 1;
+const char OP_COMPOUND = 2;
+const char OP_SET = 3;
+const char OP_REMOVE = 4;
+const char OP_EDIT = 5;
+const char OP_LIST = 6;
+const char OP_SPLICE = 7;
+const char OP_ARRAY = 8;
+const char OP_ORDER = 9;
+
+const unsigned int MAX_PATCH_DEPTH = 512;
+
+// unchanged array elements between two changed runs are resent rather than starting a new splice, as long as
+// that's smaller than the splice header
+const unsigned long SPLICE_HEADER_SIZE = 1 + 3 * 4;
+
+static unsigned long elementSize(char tagID) {
+    return tagID == TAG_Int_Array ? 4 : tagID == TAG_Long_Array ? 8 : 1;
+}
+
+static bool isArray(char tagID) {
+    return tagID == TAG_Byte_Array || tagID == TAG_Int_Array || tagID == TAG_Long_Array;
+}
+
+// lists built with addListChild don't necessarily have listType filled in
+static char listElementType(const NBT &nbt) {
+    if (nbt.listType == TAG_End && !nbt.listChildren.empty())
+        return nbt.listChildren.front().tagID;
+
+    return nbt.listType;
+}
+
+static bool equalTrees(const NBT &a, const NBT &b) {
+    if (a.tagID != b.tagID)
+        return false;
+
+    // both still match the same bytes
+    if (a.isSpliceable() && b.isSpliceable() && a.source == b.source && a.sourceOffset == b.sourceOffset)
+        return true;
+
+    if (a.tagID == TAG_Compound) {
+        if (a.compoundElements.size() != b.compoundElements.size())
+            return false;
+
+        // in the same order too, the patched document has to serialize identically
+        auto other = b.compoundElements.begin();
+        for (const auto &element: a.compoundElements) {
+            if (element.first != other->first || !equalTrees(element.second, other->second))
+                return false;
+            ++other;
+        }
+        return true;
+    } else if (a.tagID == TAG_List) {
+        if (a.listChildren.size() != b.listChildren.size())
+            return false;
+        if (!a.listChildren.empty() && listElementType(a) != listElementType(b))
+            return false;
+
+        for (unsigned long i = 0; i < a.listChildren.size(); i++) {
+            if (!equalTrees(a.listChildren[i], b.listChildren[i]))
+                return false;
+        }
+        return true;
+    }
+
+    return a.valueBytes == b.valueBytes;
+}
+
+namespace {
+    struct PatchWriter {
+        std::vector<char> &out;
+
+        void writeByte(char byte) {
+            out.push_back(byte);
+        }
+
+        template<typename T>
+        void writeValue(const T &value) {
+            out.resize(out.size() + sizeof(T));
+            writeBigEndian(out.data() + out.size() - sizeof(T), value);
+        }
+
+        void writeName(const std::string &name) {
+            writeValue((uint16_t) name.size());
+            out.insert(out.end(), name.begin(), name.end());
+        }
+
+        // room for a count that's only known once the edits are written
+        unsigned long reserveCount() {
+            writeValue((uint32_t) 0);
+            return out.size() - 4;
+        }
+
+        void fillCount(unsigned long position, uint32_t count) {
+            writeBigEndian(out.data() + position, count);
+        }
+    };
+}
+
+static void diffNode(const NBT &from, const NBT &to, PatchWriter &writer);
+
+static void writeReplace(const NBT &to, PatchWriter &writer) {
+    writer.writeByte(OP_REPLACE);
+    writer.writeByte(to.tagID);
+    NBT::serializePayload(to, writer.out);
+}
+
+static void diffCompound(const NBT &from, const NBT &to, PatchWriter &writer) {
+    writer.writeByte(OP_COMPOUND);
+    unsigned long countPosition = writer.reserveCount();
+    uint32_t count = 0;
+
+    for (const auto &element: to.compoundElements) {
+        auto old = from.compoundElements.find(element.first);
+
+        if (old == from.compoundElements.end() || old->second.tagID != element.second.tagID) {
+            writer.writeByte(OP_SET);
+            writer.writeName(element.first);
+            writer.writeByte(element.second.tagID);
+            NBT::serializePayload(element.second, writer.out);
+            count++;
+        } else if (!equalTrees(old->second, element.second)) {
+            writer.writeByte(OP_EDIT);
+            writer.writeName(element.first);
+            diffNode(old->second, element.second, writer);
+            count++;
+        }
+    }
+
+    // the order apply leaves the elements in: removals close the gaps and new keys go at the end
+    std::vector<NBTAtom> order;
+    order.reserve(to.compoundElements.size());
+    for (const auto &element: from.compoundElements) {
+        if (to.compoundElements.count(element.first) == 0) {
+            writer.writeByte(OP_REMOVE);
+            writer.writeName(element.first);
+            count++;
+        } else {
+            order.push_back(element.first);
+        }
+    }
+    for (const auto &element: to.compoundElements) {
+        if (from.compoundElements.count(element.first) == 0)
+            order.push_back(element.first);
+    }
+
+    if (!std::equal(order.begin(), order.end(), to.compoundElements.begin(),
+                    [](const NBTAtom &key, const NBTCompoundMap<NBT>::value_type &element) { return key == element.first; })) {
+        std::unordered_map<NBTAtom, uint32_t> positions;
+        for (uint32_t i = 0; i < order.size(); i++) {
+            positions.emplace(order[i], i);
+        }
+
+        writer.writeByte(OP_ORDER);
+        writer.writeValue((uint32_t) order.size());
+        for (const auto &element: to.compoundElements) {
+            writer.writeValue(positions.at(element.first));
+        }
+        count++;
+    }
+
+    writer.fillCount(countPosition, count);
+}
+
+static void writeListSplice(const NBT &to, unsigned long start, unsigned long removed, unsigned long inserted,
+                            PatchWriter &writer) {
+    writer.writeByte(OP_SPLICE);
+    writer.writeValue((uint32_t) start);
+    writer.writeValue((uint32_t) removed);
+    writer.writeValue((uint32_t) inserted);
+
+    for (unsigned long i = start; i < start + inserted; i++) {
+        NBT::serializePayload(to.listChildren[i], writer.out);
+    }
+}
+
+static void diffList(const NBT &from, const NBT &to, PatchWriter &writer) {
+    const std::vector<NBT> &oldChildren = from.listChildren;
+    const std::vector<NBT> &newChildren = to.listChildren;
+
+    // a different element type can't be spliced in
+    if (oldChildren.empty() || newChildren.empty() || listElementType(from) != listElementType(to)) {
+        writeReplace(to, writer);
+        return;
+    }
+
+    // only the middle part that differs is looked at
+    unsigned long prefix = 0;
+    while (prefix < oldChildren.size() && prefix < newChildren.size() &&
+           equalTrees(oldChildren[prefix], newChildren[prefix])) {
+        prefix++;
+    }
+
+    unsigned long suffix = 0;
+    while (suffix < oldChildren.size() - prefix && suffix < newChildren.size() - prefix &&
+           equalTrees(oldChildren[oldChildren.size() - 1 - suffix], newChildren[newChildren.size() - 1 - suffix])) {
+        suffix++;
+    }
+
+    unsigned long oldMiddle = oldChildren.size() - prefix - suffix;
+    unsigned long newMiddle = newChildren.size() - prefix - suffix;
+    unsigned long paired = std::min(oldMiddle, newMiddle);
+    char elementType = listElementType(to);
+    bool nested = elementType == TAG_Compound || elementType == TAG_List || isArray(elementType);
+
+    writer.writeByte(OP_LIST);
+    unsigned long countPosition = writer.reserveCount();
+    uint32_t count = 0;
+
+    // elements at the same position are edited in place (containers) or overwritten in runs (everything else)
+    unsigned long i = prefix;
+    while (i < prefix + paired) {
+        if (equalTrees(oldChildren[i], newChildren[i])) {
+            i++;
+            continue;
+        }
+
+        if (nested) {
+            writer.writeByte(OP_EDIT);
+            writer.writeValue((uint32_t) i);
+            diffNode(oldChildren[i], newChildren[i], writer);
+            count++;
+            i++;
+            continue;
+        }
+
+        unsigned long runEnd = i + 1;
+        while (runEnd < prefix + paired && !equalTrees(oldChildren[runEnd], newChildren[runEnd])) {
+            runEnd++;
+        }
+        writeListSplice(to, i, runEnd - i, runEnd - i, writer);
+        count++;
+        i = runEnd;
+    }
+
+    if (oldMiddle != newMiddle) {
+        writeListSplice(to, prefix + paired, oldMiddle - paired, newMiddle - paired, writer);
+        count++;
+    }
+
+    writer.fillCount(countPosition, count);
+}
+
+static void writeArraySplice(const NBT &to, unsigned long start, unsigned long removed, unsigned long inserted,
+                             PatchWriter &writer) {
+    unsigned long size = elementSize(to.tagID);
+
+    writer.writeByte(OP_SPLICE);
+    writer.writeValue((uint32_t) start);
+    writer.writeValue((uint32_t) removed);
+    writer.writeValue((uint32_t) inserted);
+    writer.out.insert(writer.out.end(), to.valueBytes.begin() + start * size,
+                      to.valueBytes.begin() + (start + inserted) * size);
+}
+
+static void diffArray(const NBT &from, const NBT &to, PatchWriter &writer) {
+    unsigned long patchStart = writer.out.size();
+    unsigned long size = elementSize(to.tagID);
+    unsigned long oldCount = from.valueBytes.size() / size;
+    unsigned long newCount = to.valueBytes.size() / size;
+    unsigned long common = std::min(oldCount, newCount);
+    const char *oldBytes = from.valueBytes.data();
+    const char *newBytes = to.valueBytes.data();
+
+    writer.writeByte(OP_ARRAY);
+    unsigned long countPosition = writer.reserveCount();
+    uint32_t count = 0;
+
+    // runs of changed elements, short unchanged gaps are folded into the surrounding run
+    unsigned long maxGap = SPLICE_HEADER_SIZE / size;
+    unsigned long i = 0;
+    while (i < common) {
+        if (std::memcmp(oldBytes + i * size, newBytes + i * size, size) == 0) {
+            i++;
+            continue;
+        }
+
+        unsigned long runEnd = i + 1;
+        unsigned long lastChanged = i;
+        while (runEnd < common && runEnd - lastChanged <= maxGap + 1) {
+            if (std::memcmp(oldBytes + runEnd * size, newBytes + runEnd * size, size) != 0)
+                lastChanged = runEnd;
+            runEnd++;
+        }
+
+        writeArraySplice(to, i, lastChanged + 1 - i, lastChanged + 1 - i, writer);
+        count++;
+        i = lastChanged + 1;
+    }
+
+    if (oldCount != newCount) {
+        writeArraySplice(to, common, oldCount - common, newCount - common, writer);
+        count++;
+    }
+
+    writer.fillCount(countPosition, count);
+
+    // mostly rewritten, sending the new array is smaller
+    if (writer.out.size() - patchStart > 2 + 4 + to.valueBytes.size()) {
+        writer.out.resize(patchStart);
+        writeReplace(to, writer);
+    }
+}
+
+static void diffNode(const NBT &from, const NBT &to, PatchWriter &writer) {
+    if (from.tagID != to.tagID) {
+        writeReplace(to, writer);
+    } else if (to.tagID == TAG_Compound) {
+        diffCompound(from, to, writer);
+    } else if (to.tagID == TAG_List) {
+        diffList(from, to, writer);
+    } else if (isArray(to.tagID)) {
+        diffArray(from, to, writer);
+    } else {
+        writeReplace(to, writer);
+    }
+}
+
+std::vector<char> NBTPatch::diff(const NBT &from, const NBT &to) {
+    std::vector<char> patch(PATCH_MAGIC, PATCH_MAGIC + 3);
+    patch.push_back(PATCH_VERSION);
+
+    PatchWriter writer{patch};
+    NBTAtom toName = to.name.value_or(NBTAtom());
+    if (toName != from.name.value_or(NBTAtom())) {
+        writer.writeByte(1);
+        writer.writeName(toName);
+    } else {
+        writer.writeByte(0);
+    }
+
+    diffNode(from, to, writer);
+    return patch;
+}
+
+std::vector<char> NBTPatch::diff(const char *fromBytes, unsigned long fromSize, const char *toBytes,
+                                 unsigned long toSize) {
+    return diff(NBT::deserialize(fromBytes, fromSize), NBT::deserialize(toBytes, toSize));
+}
+
+// patches may come from another process, so everything is bounds checked instead of asserted
+class PatchApplier {
+public:
+    PatchApplier(const char *bytes, unsigned long size) : cursor(bytes), end(bytes + size) {
+    }
+
+    bool run(NBT &root);
+
+private:
+    const char *cursor;
+    const char *end;
+    unsigned int depth = 0;
+
+    bool has(unsigned long count) const {
+        return count <= (unsigned long) (end - cursor);
+    }
+
+    template<typename T>
+    bool read(T &value) {
+        if (!has(sizeof(T)))
+            return false;
+
+        value = readBigEndian<T>(cursor);
+        cursor += sizeof(T);
+        return true;
+    }
+
+    // points into the patch, interned only if it ends up in the tree
+    bool readName(std::string_view &name) {
+        uint16_t length;
+        if (!read(length) || !has(length))
+            return false;
+
+        name = std::string_view(cursor, length);
+        cursor += length;
+        return true;
+    }
+
+    bool readPayload(NBT &nbt);
+
+    bool applyNode(NBT &target);
+
+    bool applyCompound(NBT &target);
+
+    bool applyList(NBT &target);
+
+    bool applyArray(NBT &target);
+
+    bool applyOrder(NBT &target);
+};
+
+bool PatchApplier::readPayload(NBT &nbt) {
+    switch (nbt.tagID) {
+        case TAG_Byte:
+        case TAG_Short:
+        case TAG_Int:
+        case TAG_Long:
+        case TAG_Float:
+        case TAG_Double: {
+            unsigned long size = nbt.tagID == TAG_Byte ? 1 : nbt.tagID == TAG_Short ? 2 :
+                                 nbt.tagID == TAG_Int || nbt.tagID == TAG_Float ? 4 : 8;
+            if (!has(size))
+                return false;
+
+            nbt.valueBytes.assign(cursor, cursor + size);
+            cursor += size;
+            return true;
+        }
+        case TAG_String: {
+            uint16_t length;
+            if (!read(length) || !has(length))
+                return false;
+
+            nbt.valueBytes.assign(cursor, cursor + length);
+            cursor += length;
+            return true;
+        }
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array: {
+            signed int count;
+            if (!read(count) || count < 0 || !has(elementSize(nbt.tagID) * (unsigned long) count))
+                return false;
+
+            unsigned long size = elementSize(nbt.tagID) * (unsigned long) count;
+            nbt.valueBytes.assign(cursor, cursor + size);
+            cursor += size;
+            return true;
+        }
+        case TAG_List: {
+            signed int count;
+            if (!read(nbt.listType) || !read(count) || ++depth > MAX_PATCH_DEPTH)
+                return false;
+
+            nbt.childrenCount = std::max(count, 0);
+            for (signed int i = 0; i < count; i++) {
+                // every element takes at least a byte, checked before growing the list
+                if (!has(1))
+                    return false;
+
+                nbt.listChildren.emplace_back(nbt.listType);
+                if (!readPayload(nbt.listChildren.back()))
+                    return false;
+            }
+
+            depth--;
+            return true;
+        }
+        case TAG_Compound: {
+            if (++depth > MAX_PATCH_DEPTH)
+                return false;
+
+            while (true) {
+                char tagID;
+                std::string_view name;
+                if (!read(tagID))
+                    return false;
+                if (tagID == TAG_End)
+                    break;
+                if (!readName(name))
+                    return false;
+
+                NBT child(tagID);
+                if (!readPayload(child))
+                    return false;
+
+                NBTAtom key(name);
+                child.name = key;
+                nbt.compoundElements.insert_or_assign(key, std::move(child));
+            }
+
+            depth--;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool PatchApplier::applyNode(NBT &target) {
+    char op;
+    if (!read(op) || ++depth > MAX_PATCH_DEPTH)
+        return false;
+
+    bool ok;
+    switch (op) {
+        case OP_REPLACE: {
+            char tagID;
+            if (!read(tagID))
+                return false;
+
+            NBT replacement(tagID);
+            replacement.name = target.name;
+            ok = readPayload(replacement);
+            if (ok)
+                target = std::move(replacement);
+            break;
+        }
+        case OP_COMPOUND:
+            ok = target.tagID == TAG_Compound && applyCompound(target);
+            break;
+        case OP_LIST:
+            ok = target.tagID == TAG_List && applyList(target);
+            break;
+        case OP_ARRAY:
+            ok = isArray(target.tagID) && applyArray(target);
+            break;
+        default:
+            ok = false;
+    }
+
+    target.markDirty();
+    depth--;
+    return ok;
+}
+
+bool PatchApplier::applyCompound(NBT &target) {
+    uint32_t count;
+    if (!read(count))
+        return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        char op;
+        if (!read(op))
+            return false;
+
+        if (op == OP_ORDER) {
+            if (!applyOrder(target))
+                return false;
+            continue;
+        }
+
+        std::string_view name;
+        if (!readName(name))
+            return false;
+
+        // existing keys are looked up without interning, only a key that gets inserted is
+        bool known;
+        NBTAtom key = NBTAtom::find(name, known);
+        auto element = known ? target.compoundElements.find(key) : target.compoundElements.end();
+
+        if (op == OP_SET) {
+            char tagID;
+            if (!read(tagID))
+                return false;
+
+            NBT child(tagID);
+            if (!readPayload(child))
+                return false;
+
+            if (element != target.compoundElements.end()) {
+                child.name = element->first;
+                element->second = std::move(child);
+            } else {
+                NBTAtom inserted(name);
+                child.name = inserted;
+                target.compoundElements.emplace(inserted, std::move(child));
+            }
+        } else if (op == OP_REMOVE || op == OP_EDIT) {
+            if (element == target.compoundElements.end())
+                return false;
+
+            if (op == OP_REMOVE)
+                target.compoundElements.erase(element);
+            else if (!applyNode(element->second))
+                return false;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// every element exactly once, checked before anything is moved
+bool PatchApplier::applyOrder(NBT &target) {
+    uint32_t count;
+    if (!read(count) || count != target.compoundElements.size() || !has(4ul * count))
+        return false;
+
+    std::vector<uint32_t> positions(count);
+    std::vector<char> taken(count);
+    for (uint32_t &position: positions) {
+        read(position);
+        if (position >= count || taken[position])
+            return false;
+        taken[position] = true;
+    }
+
+    NBTCompoundMap<NBT> reordered;
+    reordered.reserve(count);
+    for (uint32_t position: positions) {
+        auto element = target.compoundElements.begin() + position;
+        reordered.emplace(element->first, std::move(element->second));
+    }
+    target.compoundElements = std::move(reordered);
+    return true;
+}
+
+bool PatchApplier::applyList(NBT &target) {
+    uint32_t count;
+    if (!read(count))
+        return false;
+
+    std::vector<NBT> &children = target.listChildren;
+    char elementType = listElementType(target);
+
+    for (uint32_t i = 0; i < count; i++) {
+        char op;
+        if (!read(op))
+            return false;
+
+        if (op == OP_SPLICE) {
+            uint32_t start, removed, inserted;
+            if (!read(start) || !read(removed) || !read(inserted) || start > children.size() ||
+                removed > children.size() - start || elementType == TAG_End)
+                return false;
+
+            std::vector<NBT> insertedChildren;
+            for (uint32_t j = 0; j < inserted; j++) {
+                if (!has(1))
+                    return false;
+
+                insertedChildren.emplace_back(elementType);
+                if (!readPayload(insertedChildren.back()))
+                    return false;
+            }
+
+            children.erase(children.begin() + start, children.begin() + start + removed);
+            children.insert(children.begin() + start, std::make_move_iterator(insertedChildren.begin()),
+                            std::make_move_iterator(insertedChildren.end()));
+        } else if (op == OP_EDIT) {
+            uint32_t index;
+            if (!read(index) || index >= children.size() || !applyNode(children[index]))
+                return false;
+            // an element can't change type inside a list
+            if (children[index].tagID != elementType)
+                return false;
+        } else {
+            return false;
+        }
+    }
+
+    target.listType = elementType;
+    target.childrenCount = (signed int) children.size();
+    return true;
+}
+
+bool PatchApplier::applyArray(NBT &target) {
+    uint32_t count;
+    if (!read(count))
+        return false;
+
+    unsigned long size = elementSize(target.tagID);
+    std::vector<char> &bytes = target.valueBytes;
+
+    for (uint32_t i = 0; i < count; i++) {
+        char op;
+        uint32_t start, removed, inserted;
+        if (!read(op) || op != OP_SPLICE || !read(start) || !read(removed) || !read(inserted))
+            return false;
+
+        unsigned long elementCount = bytes.size() / size;
+        if (start > elementCount || removed > elementCount - start || !has(size * (unsigned long) inserted))
+            return false;
+
+        // same length runs are overwritten in place
+        if (removed == inserted) {
+            std::memcpy(bytes.data() + start * size, cursor, size * inserted);
+        } else {
+            auto position = bytes.erase(bytes.begin() + start * size, bytes.begin() + (start + removed) * size);
+            bytes.insert(position, cursor, cursor + size * inserted);
+        }
+        cursor += size * inserted;
+    }
+
+    return true;
+}
+
+bool PatchApplier::run(NBT &root) {
+    char header[4];
+    if (!has(4))
+        return false;
+    std::memcpy(header, cursor, 4);
+    cursor += 4;
+    if (std::memcmp(header, PATCH_MAGIC, 3) != 0 || header[3] != PATCH_VERSION)
+        return false;
+
+    char nameChanged;
+    if (!read(nameChanged))
+        return false;
+    if (nameChanged) {
+        std::string_view name;
+        if (!readName(name))
+            return false;
+        root.name = NBTAtom(name);
+    }
+
+    // trailing bytes mean the patch isn't what we think it is
+    return applyNode(root) && cursor == end;
+}
+
+bool NBTPatch::apply(NBT &root, const char *patch, unsigned long patchSize) {
+    PatchApplier applier(patch, patchSize);
+    return applier.run(root);
+}
+
+bool NBTPatch::apply(NBT &root, const std::vector<char> &patch) {
+    return apply(root, patch.data(), patch.size());
+}
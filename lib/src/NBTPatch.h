@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include "NBT.h"
+
+// binary patches between two versions of a document, for shipping small edits instead of whole documents.
+// a patch is a tree of edits mirroring the document: compounds set/remove/edit keys, lists and arrays splice
+// element ranges (arrays at the granularity of runs of changed elements), anything else is replaced.
+// payloads inside the patch use the regular NBT encoding
+class NBTPatch {
+public:
+    // patch that turns from into to
+    static std::vector<char> diff(const NBT &from, const NBT &to);
+
+    // same for two serialized documents (uncompressed or gzip'd)
+    static std::vector<char> diff(const char *fromBytes, unsigned long fromSize, const char *toBytes,
+                                  unsigned long toSize);
+
+    // applies a patch made by diff against the same starting document, which then serializes exactly like the one
+    // diffed against (key order included). false if the patch is malformed or doesn't fit the tree, which may then
+    // be partially patched. touched nodes are marked dirty. names are only interned for keys that get inserted
+    static bool apply(NBT &root, const char *patch, unsigned long patchSize);
+
+    static bool apply(NBT &root, const std::vector<char> &patch);
+};
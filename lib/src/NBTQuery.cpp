@@ -0,0 +1,314 @@
+#include <algorithm>
+#include "NBTQuery.h"
+
+NBTPath::NBTPath() = default;
+
+static bool isPlainNameChar(char c) {
+    return c != '.' && c != '[' && c != ']' && c != '*' && c != '"';
+}
+
+std::optional<NBTPath> NBTPath::compile(std::string_view expression) {
+    NBTPath path;
+    unsigned long position = 0;
+    bool expectName = true; // at the start and after a dot
+
+    while (position < expression.size()) {
+        char c = expression[position];
+
+        if (c == '[') {
+            unsigned long close = expression.find(']', position);
+            if (close == std::string_view::npos || close == position + 1)
+                return std::nullopt;
+
+            std::string_view inside = expression.substr(position + 1, close - position - 1);
+            if (inside == "*") {
+                path.steps.push_back({StepKind::WILDCARD, "", 0});
+            } else {
+                signed long index = 0;
+                for (char digit: inside) {
+                    if (digit < '0' || digit > '9' || index > 0x7FFFFFFF / 10)
+                        return std::nullopt;
+                    index = index * 10 + (digit - '0');
+                }
+                path.steps.push_back({StepKind::INDEX, "", (signed int) index});
+            }
+
+            position = close + 1;
+            expectName = false;
+            continue;
+        }
+
+        if (c == '.') {
+            if (expectName)
+                return std::nullopt;
+            position++;
+            expectName = true;
+            continue;
+        }
+
+        if (!expectName)
+            return std::nullopt;
+
+        if (c == '*') {
+            path.steps.push_back({StepKind::WILDCARD, "", 0});
+            position++;
+        } else if (c == '"') {
+            std::string name;
+            position++;
+            while (position < expression.size() && expression[position] != '"') {
+                if (expression[position] == '\\' && position + 1 < expression.size())
+                    position++;
+                name += expression[position++];
+            }
+            if (position == expression.size())
+                return std::nullopt;
+
+            path.steps.push_back({StepKind::NAME, std::move(name), 0});
+            position++;
+        } else {
+            unsigned long end = position;
+            while (end < expression.size() && isPlainNameChar(expression[end])) {
+                end++;
+            }
+            path.steps.push_back({StepKind::NAME, std::string(expression.substr(position, end - position)), 0});
+            position = end;
+        }
+        expectName = false;
+    }
+
+    if (path.steps.empty() || expectName)
+        return std::nullopt;
+
+    path.firstWildcard = path.steps.size();
+    for (unsigned long i = 0; i < path.steps.size(); i++) {
+        if (path.steps[i].kind == StepKind::WILDCARD) {
+            path.firstWildcard = i;
+            break;
+        }
+    }
+
+    return path;
+}
+
+bool NBTPath::hasWildcard() const {
+    return firstWildcard < steps.size();
+}
+
+unsigned int NBTQuery::add(NBTPath path) {
+    paths.push_back(std::move(path));
+    return paths.size() - 1;
+}
+
+std::optional<unsigned int> NBTQuery::add(std::string_view expression) {
+    std::optional<NBTPath> path = NBTPath::compile(expression);
+    if (!path.has_value())
+        return std::nullopt;
+
+    return add(std::move(*path));
+}
+
+unsigned int NBTQuery::size() const {
+    return paths.size();
+}
+
+namespace {
+    // a path that got as far as some tag, having consumed `step` of its steps
+    struct PathState {
+        unsigned int path;
+        unsigned int step;
+    };
+}
+
+class QueryEvaluator {
+public:
+    QueryEvaluator(const std::vector<NBTPath> &paths, const NBTQuery::Callback &callback, bool firstOnly)
+            : paths(paths), callback(callback), firstOnly(firstOnly), done(paths.size(), false),
+              remaining(paths.size()) {
+    }
+
+    void visit(const NBTView &node, const std::vector<PathState> &states);
+
+    bool finished() const {
+        return remaining == 0;
+    }
+
+private:
+    const std::vector<NBTPath> &paths;
+    const NBTQuery::Callback &callback;
+    bool firstOnly;
+    std::vector<bool> done;
+    unsigned long remaining;
+
+    void finish(unsigned int path) {
+        if (!done[path]) {
+            done[path] = true;
+            remaining--;
+        }
+    }
+
+    void visitCompound(const NBTView &node, const std::vector<PathState> &states);
+
+    void visitSequence(const NBTView &node, const std::vector<PathState> &states);
+};
+
+void QueryEvaluator::visit(const NBTView &node, const std::vector<PathState> &states) {
+    std::vector<PathState> pending;
+
+    for (const PathState &state: states) {
+        if (done[state.path])
+            continue;
+
+        if (state.step < paths[state.path].steps.size()) {
+            pending.push_back(state);
+            continue;
+        }
+
+        callback(state.path, node);
+        if (firstOnly || !paths[state.path].hasWildcard())
+            finish(state.path);
+    }
+
+    if (!pending.empty() && !finished()) {
+        if (node.tagID() == TAG_Compound) {
+            visitCompound(node, pending);
+        } else if (node.tagID() == TAG_List || node.tagID() == TAG_Byte_Array || node.tagID() == TAG_Int_Array ||
+                   node.tagID() == TAG_Long_Array) {
+            visitSequence(node, pending);
+        }
+    }
+
+    // up to its first wildcard a path has exactly one candidate tag at each depth, so once that one was
+    // searched there is nothing left to find anywhere else
+    for (const PathState &state: states) {
+        if (state.step <= paths[state.path].firstWildcard)
+            finish(state.path);
+    }
+}
+
+void QueryEvaluator::visitCompound(const NBTView &node, const std::vector<PathState> &states) {
+    bool anyWildcard = false;
+    unsigned long namesLeft = 0;
+    for (const PathState &state: states) {
+        if (paths[state.path].steps[state.step].kind == NBTPath::StepKind::WILDCARD)
+            anyWildcard = true;
+        else if (paths[state.path].steps[state.step].kind == NBTPath::StepKind::NAME)
+            namesLeft++;
+    }
+
+    if (!anyWildcard && namesLeft == 0)
+        return;
+
+    std::vector<PathState> childStates;
+    for (const NBTView &child: node) {
+        childStates.clear();
+
+        for (const PathState &state: states) {
+            const NBTPath::Step &step = paths[state.path].steps[state.step];
+
+            if (step.kind == NBTPath::StepKind::WILDCARD) {
+                childStates.push_back({state.path, state.step + 1});
+            } else if (step.kind == NBTPath::StepKind::NAME && step.name == child.name()) {
+                childStates.push_back({state.path, state.step + 1});
+                namesLeft--;
+            }
+        }
+
+        if (!childStates.empty())
+            visit(child, childStates);
+
+        // names are unique within a compound, the rest of it can't match anymore
+        if (finished() || (!anyWildcard && namesLeft == 0))
+            return;
+    }
+}
+
+void QueryEvaluator::visitSequence(const NBTView &node, const std::vector<PathState> &states) {
+    bool anyWildcard = false;
+    std::vector<signed int> indices;
+    for (const PathState &state: states) {
+        const NBTPath::Step &step = paths[state.path].steps[state.step];
+
+        if (step.kind == NBTPath::StepKind::WILDCARD)
+            anyWildcard = true;
+        else if (step.kind == NBTPath::StepKind::INDEX)
+            indices.push_back(step.index);
+    }
+
+    std::vector<PathState> childStates;
+    auto visitElement = [&](const NBTView &element, signed int index) {
+        childStates.clear();
+
+        for (const PathState &state: states) {
+            const NBTPath::Step &step = paths[state.path].steps[state.step];
+
+            if (step.kind == NBTPath::StepKind::WILDCARD ||
+                (step.kind == NBTPath::StepKind::INDEX && step.index == index)) {
+                childStates.push_back({state.path, state.step + 1});
+            }
+        }
+
+        if (!childStates.empty())
+            visit(element, childStates);
+    };
+
+    if (node.tagID() != TAG_List) {
+        // array elements are fixed size, any index is a single jump
+        if (anyWildcard) {
+            for (signed int i = 0; i < node.arraySize() && !finished(); i++) {
+                visitElement(node[i], i);
+            }
+        } else {
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+            for (signed int index: indices) {
+                NBTView element = node[index];
+                if (!element.valid() || finished())
+                    break;
+                visitElement(element, index);
+            }
+        }
+        return;
+    }
+
+    if (!anyWildcard && indices.empty())
+        return;
+
+    signed int lastIndex = anyWildcard ? node.childrenCount() - 1 : *std::max_element(indices.begin(), indices.end());
+    signed int index = 0;
+    for (NBTView::Iterator it = node.begin(); it != node.end() && index <= lastIndex; ++it, index++) {
+        visitElement(*it, index);
+
+        if (finished())
+            return;
+    }
+}
+
+static void evaluate(const std::vector<NBTPath> &paths, const NBTView &root, const NBTQuery::Callback &callback,
+                     bool firstOnly) {
+    QueryEvaluator evaluator(paths, callback, firstOnly);
+
+    std::vector<PathState> states;
+    for (unsigned int i = 0; i < paths.size(); i++) {
+        states.push_back({i, 0});
+    }
+    evaluator.visit(root, states);
+}
+
+void NBTQuery::run(const NBTView &root, const Callback &callback) const {
+    evaluate(paths, root, callback, false);
+}
+
+void NBTQuery::run(const char *byteArray, unsigned long byteArraySize, const Callback &callback) const {
+    run(NBTView::root(byteArray, byteArraySize), callback);
+}
+
+std::vector<NBTView> NBTQuery::first(const char *byteArray, unsigned long byteArraySize) const {
+    std::vector<NBTView> matches(paths.size());
+
+    evaluate(paths, NBTView::root(byteArray, byteArraySize), [&matches](unsigned int pathIndex, const NBTView &match) {
+        matches[pathIndex] = match;
+    }, true);
+
+    return matches;
+}
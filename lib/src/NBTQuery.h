@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <functional>
+#include "NBTView.h"
+
+// compiled path expression like Level.Sections[*].Y, Pos[1] or Inventory[*].id, relative to the root compound.
+// steps are separated by dots, [n] picks a list/array element, [*] or * matches every element/child.
+// names with special characters can be quoted: Data."some.name"
+class NBTPath {
+public:
+    // nullopt if the expression doesn't parse
+    static std::optional<NBTPath> compile(std::string_view expression);
+
+    // true if the path can match more than one tag
+    bool hasWildcard() const;
+
+private:
+    friend class QueryEvaluator;
+
+    enum class StepKind {
+        NAME,
+        INDEX,
+        WILDCARD
+    };
+
+    struct Step {
+        StepKind kind;
+        std::string name;
+        signed int index;
+    };
+
+    std::vector<Step> steps;
+    unsigned long firstWildcard = 0; // steps.size() if there is none
+
+    NBTPath();
+};
+
+// evaluates a set of paths in a single pass over serialized (uncompressed) NBT, without building a tree.
+// subtrees no path can match are skipped by length, and the scan stops as soon as every path is done
+class NBTQuery {
+public:
+    // called for every match with the index the path got from add()
+    typedef std::function<void(unsigned int pathIndex, const NBTView &match)> Callback;
+
+    unsigned int add(NBTPath path);
+
+    // nullopt if the expression doesn't parse
+    std::optional<unsigned int> add(std::string_view expression);
+
+    unsigned int size() const;
+
+    // matches are reported in document order
+    void run(const NBTView &root, const Callback &callback) const;
+
+    void run(const char *byteArray, unsigned long byteArraySize, const Callback &callback) const;
+
+    // first match of every path, invalid views for paths that matched nothing
+    std::vector<NBTView> first(const char *byteArray, unsigned long byteArraySize) const;
+
+private:
+    std::vector<NBTPath> paths;
+};
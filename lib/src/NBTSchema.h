@@ -0,0 +1,590 @@
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include "NBT.h"
+#include "BigEndian.h"
+#include "ByteSwap.h"
+#include "Compression.h"
+#include "NBTSink.h"
+
+// binds C++ structs to NBT compounds, so documents decode straight from bytes into the struct (and back) without
+// building an NBT tree. a struct is described once by specializing NBTSchema:
+//
+//   struct Item { std::string id; char count; std::optional<char> slot; };
+//
+//   template<>
+//   struct NBTSchema<Item> {
+//       static constexpr auto fields = std::make_tuple(
+//               nbtField("id", &Item::id),
+//               nbtField("Count", &Item::count),
+//               nbtField("Slot", &Item::slot));
+//   };
+//
+//   NBTBinding<Item>::deserialize(bytes, size, item);
+//
+// member types map to tags: char/bool -> Byte, signed short/int/long, float, double, std::string -> String,
+// std::vector<char/signed int/signed long> -> Byte/Int/Long_Array, other std::vector<T> -> List, structs with a
+// schema -> Compound. std::optional<T> members are only written when set.
+// keys are matched with a perfect hash built at compile time, unknown keys and keys with an unexpected tag type are
+// skipped without being decoded
+template<typename T>
+struct NBTSchema;
+
+template<typename Struct, typename Member>
+struct NBTField {
+    using Type = Member;
+
+    std::string_view name;
+    Member Struct::*member;
+};
+
+template<typename Struct, typename Member>
+constexpr NBTField<Struct, Member> nbtField(std::string_view name, Member Struct::*member) {
+    return {name, member};
+}
+
+namespace NBTSchemaDetail {
+    const unsigned int MAX_DEPTH = 512;
+
+    struct Reader {
+        const char *cursor;
+        const char *end;
+        unsigned int depth = 0;
+
+        bool has(unsigned long count) const {
+            return count <= (unsigned long) (end - cursor);
+        }
+
+        template<typename T>
+        bool read(T &value) {
+            if (!has(sizeof(T)))
+                return false;
+
+            value = readBigEndian<T>(cursor);
+            cursor += sizeof(T);
+            return true;
+        }
+
+        bool readLength(signed int &length) {
+            return read(length) && length >= 0;
+        }
+
+        bool readName(std::string_view &name) {
+            uint16_t length;
+            if (!read(length) || !has(length))
+                return false;
+
+            name = std::string_view(cursor, length);
+            cursor += length;
+            return true;
+        }
+
+        // skips the payload of a tag nobody asked for, bounds checked since the input isn't trusted
+        bool skip(char tagID) {
+            switch (tagID) {
+                case TAG_Byte:
+                    return advance(1);
+                case TAG_Short:
+                    return advance(2);
+                case TAG_Int:
+                case TAG_Float:
+                    return advance(4);
+                case TAG_Long:
+                case TAG_Double:
+                    return advance(8);
+                case TAG_String: {
+                    std::string_view ignored;
+                    return readName(ignored);
+                }
+                case TAG_Byte_Array:
+                case TAG_Int_Array:
+                case TAG_Long_Array: {
+                    signed int length;
+                    unsigned long elementSize = tagID == TAG_Byte_Array ? 1 : tagID == TAG_Int_Array ? 4 : 8;
+                    return readLength(length) && advance(elementSize * (unsigned long) length);
+                }
+                case TAG_List: {
+                    char listType;
+                    signed int count;
+                    if (!read(listType) || !read(count) || ++depth > MAX_DEPTH)
+                        return false;
+
+                    for (signed int i = 0; i < count; i++) {
+                        if (!skip(listType))
+                            return false;
+                    }
+                    depth--;
+                    return true;
+                }
+                case TAG_Compound: {
+                    if (++depth > MAX_DEPTH)
+                        return false;
+
+                    while (true) {
+                        char childTagID;
+                        std::string_view ignored;
+                        if (!read(childTagID))
+                            return false;
+                        if (childTagID == TAG_End)
+                            break;
+                        if (!readName(ignored) || !skip(childTagID))
+                            return false;
+                    }
+                    depth--;
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+    private:
+        bool advance(unsigned long count) {
+            if (!has(count))
+                return false;
+            cursor += count;
+            return true;
+        }
+    };
+
+    struct Writer {
+        std::vector<char> &out;
+
+        void writeByte(char value) {
+            out.push_back(value);
+        }
+
+        template<typename T>
+        void write(const T &value) {
+            out.resize(out.size() + sizeof(T));
+            writeBigEndian(out.data() + out.size() - sizeof(T), value);
+        }
+
+        void writeName(std::string_view name) {
+            assert(name.size() <= 0xFFFF);
+
+            write((uint16_t) name.size());
+            out.insert(out.end(), name.begin(), name.end());
+        }
+    };
+
+    // per member type: its tag, and how to decode/encode the payload
+    template<typename T, typename = void>
+    struct Codec;
+
+    template<typename T>
+    struct ScalarCodec {
+        static bool decode(Reader &reader, T &value) {
+            return reader.read(value);
+        }
+
+        static void encode(Writer &writer, const T &value) {
+            writer.write(value);
+        }
+    };
+
+    template<>
+    struct Codec<char> : ScalarCodec<char> {
+        static const char TAG = TAG_Byte;
+    };
+
+    template<>
+    struct Codec<signed short> : ScalarCodec<signed short> {
+        static const char TAG = TAG_Short;
+    };
+
+    template<>
+    struct Codec<signed int> : ScalarCodec<signed int> {
+        static const char TAG = TAG_Int;
+    };
+
+    template<>
+    struct Codec<signed long> : ScalarCodec<signed long> {
+        static const char TAG = TAG_Long;
+    };
+
+    template<>
+    struct Codec<float> : ScalarCodec<float> {
+        static const char TAG = TAG_Float;
+    };
+
+    template<>
+    struct Codec<double> : ScalarCodec<double> {
+        static const char TAG = TAG_Double;
+    };
+
+    template<>
+    struct Codec<bool> {
+        static const char TAG = TAG_Byte;
+
+        static bool decode(Reader &reader, bool &value) {
+            char byte;
+            if (!reader.read(byte))
+                return false;
+            value = byte != 0;
+            return true;
+        }
+
+        static void encode(Writer &writer, const bool &value) {
+            writer.writeByte(value ? 1 : 0);
+        }
+    };
+
+    template<>
+    struct Codec<std::string> {
+        static const char TAG = TAG_String;
+
+        static bool decode(Reader &reader, std::string &value) {
+            std::string_view bytes;
+            if (!reader.readName(bytes))
+                return false;
+            value.assign(bytes.data(), bytes.size());
+            return true;
+        }
+
+        static void encode(Writer &writer, const std::string &value) {
+            writer.writeName(value);
+        }
+    };
+
+    template<typename Element, char Tag>
+    struct ArrayCodec {
+        static const char TAG = Tag;
+
+        static bool decode(Reader &reader, std::vector<Element> &values) {
+            signed int length;
+            if (!reader.readLength(length) || !reader.has(sizeof(Element) * (unsigned long) length))
+                return false;
+
+            values.resize(length);
+            if constexpr (sizeof(Element) == 1)
+                std::memcpy(values.data(), reader.cursor, length);
+            else
+                readBigEndianArray(reader.cursor, values.data(), length);
+            reader.cursor += sizeof(Element) * (unsigned long) length;
+            return true;
+        }
+
+        static void encode(Writer &writer, const std::vector<Element> &values) {
+            writer.write((signed int) values.size());
+
+            unsigned long offset = writer.out.size();
+            writer.out.resize(offset + sizeof(Element) * values.size());
+            if constexpr (sizeof(Element) == 1)
+                std::memcpy(writer.out.data() + offset, values.data(), values.size());
+            else
+                writeBigEndianArray(values.data(), writer.out.data() + offset, values.size());
+        }
+    };
+
+    template<>
+    struct Codec<std::vector<char>> : ArrayCodec<char, TAG_Byte_Array> {
+    };
+
+    template<>
+    struct Codec<std::vector<signed int>> : ArrayCodec<signed int, TAG_Int_Array> {
+    };
+
+    template<>
+    struct Codec<std::vector<signed long>> : ArrayCodec<signed long, TAG_Long_Array> {
+    };
+
+    // any other vector is a list
+    template<typename Element>
+    struct Codec<std::vector<Element>> {
+        static const char TAG = TAG_List;
+
+        static bool decode(Reader &reader, std::vector<Element> &values) {
+            const char *listStart = reader.cursor;
+            char listType;
+            signed int count;
+            if (!reader.read(listType) || !reader.read(count))
+                return false;
+
+            // a list of something else is left alone like any other mismatching tag
+            if (count > 0 && listType != Codec<Element>::TAG) {
+                reader.cursor = listStart;
+                return reader.skip(TAG_List);
+            }
+
+            values.clear();
+            if (count <= 0)
+                return true;
+
+            if (++reader.depth > MAX_DEPTH)
+                return false;
+
+            // every element takes at least a byte, a bogus count can't make us reserve more than the input
+            values.reserve(std::min((unsigned long) count, (unsigned long) (reader.end - reader.cursor)));
+            for (signed int i = 0; i < count; i++) {
+                values.emplace_back();
+                if (!Codec<Element>::decode(reader, values.back()))
+                    return false;
+            }
+
+            reader.depth--;
+            return true;
+        }
+
+        static void encode(Writer &writer, const std::vector<Element> &values) {
+            writer.writeByte(values.empty() ? TAG_End : Codec<Element>::TAG);
+            writer.write((signed int) values.size());
+
+            for (const Element &value: values) {
+                Codec<Element>::encode(writer, value);
+            }
+        }
+    };
+
+    template<typename T>
+    struct Codec<std::optional<T>> {
+        static const char TAG = Codec<T>::TAG;
+
+        static bool decode(Reader &reader, std::optional<T> &value) {
+            value.emplace();
+            return Codec<T>::decode(reader, *value);
+        }
+
+        static void encode(Writer &writer, const std::optional<T> &value) {
+            Codec<T>::encode(writer, *value);
+        }
+    };
+
+    template<typename T>
+    bool isPresent(const T &) {
+        return true;
+    }
+
+    template<typename T>
+    bool isPresent(const std::optional<T> &value) {
+        return value.has_value();
+    }
+
+    constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+        // FNV-1a, the seed is mixed into the offset basis
+        uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c: name) {
+            hash = (hash ^ (uint8_t) c) * 16777619u;
+        }
+        return hash;
+    }
+
+    constexpr unsigned long nextPowerOfTwo(unsigned long value) {
+        unsigned long power = 1;
+        while (power < value) {
+            power *= 2;
+        }
+        return power;
+    }
+
+    // slot -> field index + 1 (0 = empty), collision free for the field names
+    template<unsigned long Count>
+    struct PerfectHash {
+        static constexpr unsigned long MAX_SLOTS = 8 * nextPowerOfTwo(Count == 0 ? 1 : Count);
+
+        uint32_t seed = 0;
+        uint32_t mask = 0;
+        std::array<uint16_t, MAX_SLOTS> slots{};
+        bool found = false;
+
+        constexpr PerfectHash(const std::array<std::string_view, Count> &names) {
+            for (unsigned long size = MAX_SLOTS / 8; size <= MAX_SLOTS && !found; size *= 2) {
+                for (uint32_t candidate = 0; candidate < 256 && !found; candidate++) {
+                    std::array<uint16_t, MAX_SLOTS> table{};
+                    bool collision = false;
+
+                    for (unsigned long i = 0; i < Count && !collision; i++) {
+                        uint32_t slot = hashName(names[i], candidate) & (size - 1);
+                        if (table[slot] != 0)
+                            collision = true;
+                        table[slot] = i + 1;
+                    }
+
+                    if (!collision) {
+                        seed = candidate;
+                        mask = size - 1;
+                        slots = table;
+                        found = true;
+                    }
+                }
+            }
+        }
+
+        // field index, or -1 if the name isn't one of the fields
+        signed long find(std::string_view name, const std::array<std::string_view, Count> &names) const {
+            uint16_t slot = slots[hashName(name, seed) & mask];
+            if (slot == 0 || names[slot - 1] != name)
+                return -1;
+            return slot - 1;
+        }
+    };
+
+    template<typename Struct>
+    struct StructCodec {
+        using Fields = std::decay_t<decltype(NBTSchema<Struct>::fields)>;
+
+        static constexpr unsigned long COUNT = std::tuple_size<Fields>::value;
+
+        template<unsigned long Index>
+        using MemberType = typename std::tuple_element<Index, Fields>::type::Type;
+
+        template<unsigned long... Indices>
+        static constexpr std::array<std::string_view, COUNT> fieldNames(std::index_sequence<Indices...>) {
+            return {{std::get<Indices>(NBTSchema<Struct>::fields).name...}};
+        }
+
+        template<unsigned long... Indices>
+        static constexpr std::array<char, COUNT> fieldTags(std::index_sequence<Indices...>) {
+            return {{Codec<MemberType<Indices>>::TAG...}};
+        }
+
+        static constexpr std::array<std::string_view, COUNT> NAMES = fieldNames(std::make_index_sequence<COUNT>());
+
+        static constexpr std::array<char, COUNT> TAGS = fieldTags(std::make_index_sequence<COUNT>());
+
+        static constexpr PerfectHash<COUNT> HASH{NAMES};
+
+        static_assert(HASH.found, "no perfect hash found for the field names (duplicate names?)");
+
+        typedef bool (*FieldDecoder)(Reader &reader, Struct &value);
+
+        template<unsigned long Index>
+        static bool decodeField(Reader &reader, Struct &value) {
+            return Codec<MemberType<Index>>::decode(reader, value.*(std::get<Index>(NBTSchema<Struct>::fields).member));
+        }
+
+        template<unsigned long... Indices>
+        static constexpr std::array<FieldDecoder, COUNT> fieldDecoders(std::index_sequence<Indices...>) {
+            return {{&decodeField<Indices>...}};
+        }
+
+        static constexpr std::array<FieldDecoder, COUNT> DECODERS =
+                fieldDecoders(std::make_index_sequence<COUNT>());
+
+        // compound payload: elements up to and including TAG_End
+        static bool decode(Reader &reader, Struct &value) {
+            if (++reader.depth > MAX_DEPTH)
+                return false;
+
+            while (true) {
+                char tagID;
+                std::string_view name;
+                if (!reader.read(tagID))
+                    return false;
+                if (tagID == TAG_End)
+                    break;
+                if (!reader.readName(name))
+                    return false;
+
+                signed long field = HASH.find(name, NAMES);
+                bool ok = field >= 0 && TAGS[field] == tagID ? DECODERS[field](reader, value) : reader.skip(tagID);
+                if (!ok)
+                    return false;
+            }
+
+            reader.depth--;
+            return true;
+        }
+
+        template<unsigned long Index>
+        static void encodeField(Writer &writer, const Struct &value) {
+            const auto &field = std::get<Index>(NBTSchema<Struct>::fields);
+            const MemberType<Index> &member = value.*(field.member);
+
+            if (!isPresent(member))
+                return;
+
+            writer.writeByte(TAGS[Index]);
+            writer.writeName(field.name);
+            Codec<MemberType<Index>>::encode(writer, member);
+        }
+
+        template<unsigned long... Indices>
+        static void encodeFields(Writer &writer, const Struct &value, std::index_sequence<Indices...>) {
+            (encodeField<Indices>(writer, value), ...);
+        }
+
+        static void encode(Writer &writer, const Struct &value) {
+            encodeFields(writer, value, std::make_index_sequence<COUNT>());
+            writer.writeByte(TAG_End);
+        }
+    };
+
+    // everything else has to be a struct with a schema
+    template<typename T, typename>
+    struct Codec : StructCodec<T> {
+        static const char TAG = TAG_Compound;
+    };
+
+    // reused between calls so decoding gzip'd files doesn't allocate once warmed up
+    inline std::string &inflateBuffer() {
+        static thread_local std::string buffer;
+        return buffer;
+    }
+}
+
+template<typename T>
+class NBTBinding {
+public:
+    // decode a whole document (uncompressed, gzip'd or zlib'd) into value. false if the input is malformed, in which case
+    // value may be partially filled. members whose key is missing or has another tag type keep their value
+    static bool deserialize(const char *byteArray, unsigned long byteArraySize, T &value) {
+        CompressionFormat format = detectCompression(byteArray, byteArraySize);
+        if (format != CompressionFormat::NONE) {
+            std::string &inflated = NBTSchemaDetail::inflateBuffer();
+            if (!decompressBuffer(byteArray, byteArraySize, format, inflated))
+                return false;
+
+            byteArray = inflated.data();
+            byteArraySize = inflated.size();
+        }
+
+        NBTSchemaDetail::Reader reader{byteArray, byteArray + byteArraySize};
+        char tagID;
+        std::string_view rootName;
+
+        if (!reader.read(tagID) || tagID != TAG_Compound || !reader.readName(rootName))
+            return false;
+
+        return NBTSchemaDetail::Codec<T>::decode(reader, value);
+    }
+
+    // encode value as a root compound, members in declaration order. throws std::runtime_error if compression
+    // fails, like NBT::serialize
+    static std::vector<char> serialize(const T &value, bool compressed = false, std::string_view rootName = "") {
+        std::vector<char> out;
+        NBTSchemaDetail::Writer writer{out};
+
+        writer.writeByte(TAG_Compound);
+        writer.writeName(rootName);
+        NBTSchemaDetail::Codec<T>::encode(writer, value);
+
+        if (!compressed)
+            return out;
+
+        std::vector<char> deflated;
+        VectorSink vectorSink(deflated);
+        DeflateSink deflateSink(vectorSink, CompressionFormat::GZIP);
+        if (!deflateSink.write(out.data(), out.size()) || !deflateSink.finish())
+            throw std::runtime_error("deflate failed");
+        return deflated;
+    }
+
+    // streams into a sink (wrap it in a DeflateSink for compressed output), false if the sink failed
+    static bool serializeInto(const T &value, NBTSink &sink, std::string_view rootName = "") {
+        std::vector<char> out = serialize(value, false, rootName);
+        return sink.write(out.data(), out.size()) && sink.finish();
+    }
+};
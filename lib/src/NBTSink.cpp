@@ -0,0 +1,133 @@
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <zlib.h>
+#include "NBTSink.h"
+#include "NBTStats.h"
+
+BufferSink::BufferSink(char *buffer, unsigned long capacity) : buffer(buffer), capacity(capacity) {
+}
+
+bool BufferSink::write(const char *bytes, unsigned long size) {
+    if (size > capacity - written)
+        return false;
+
+    std::memcpy(buffer + written, bytes, size);
+    written += size;
+    return true;
+}
+
+unsigned long BufferSink::size() const {
+    return written;
+}
+
+VectorSink::VectorSink(std::vector<char> &vector) : vector(vector) {
+}
+
+bool VectorSink::write(const char *bytes, unsigned long size) {
+    vector.insert(vector.end(), bytes, bytes + size);
+    return true;
+}
+
+FileDescriptorSink::FileDescriptorSink(int fd) : fd(fd) {
+}
+
+bool FileDescriptorSink::write(const char *bytes, unsigned long size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+FileSink::FileSink(FILE *file) : file(file) {
+}
+
+bool FileSink::write(const char *bytes, unsigned long size) {
+    return std::fwrite(bytes, 1, size, file) == size;
+}
+
+bool FileSink::finish() {
+    return std::fflush(file) == 0;
+}
+
+DeflateSink::DeflateSink(NBTSink &downstream, CompressionFormat format, int level, unsigned long bufferSize)
+        : DeflateSink(downstream, CompressionOptions{format, level, CompressionStrategy::DEFAULT}, bufferSize) {
+}
+
+DeflateSink::DeflateSink(NBTSink &downstream, const CompressionOptions &options, unsigned long bufferSize)
+        : downstream(downstream), stream(acquireDeflateStream(options)), buffer(std::max(bufferSize, 1024ul)) {
+    assert(options.format != CompressionFormat::NONE);
+
+    if (stream == nullptr)
+        failed = true;
+}
+
+DeflateSink::~DeflateSink() {
+    releaseDeflateStream(stream);
+}
+
+bool DeflateSink::write(const char *bytes, unsigned long size) {
+    NBTTraceSpan span("deflate", &NBTStats::deflateNanos);
+
+    while (size > 0 && !failed) {
+        // avail_in is only 32 bits
+        unsigned long roundSize = std::min(size, 1ul << 30);
+        stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes));
+        stream->avail_in = roundSize;
+        bytes += roundSize;
+        size -= roundSize;
+
+        deflateInput(Z_NO_FLUSH);
+    }
+
+    return !failed;
+}
+
+bool DeflateSink::finish() {
+    if (failed)
+        return false;
+
+    stream->next_in = nullptr;
+    stream->avail_in = 0;
+    {
+        NBTTraceSpan span("deflate", &NBTStats::deflateNanos);
+        if (!deflateInput(Z_FINISH))
+            return false;
+    }
+
+    deflateReset(stream);
+    return downstream.finish();
+}
+
+bool DeflateSink::deflateInput(int flush) {
+    while (!failed) {
+        stream->next_out = reinterpret_cast<Bytef *>(buffer.data());
+        stream->avail_out = buffer.size();
+
+        int result = deflate(stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            failed = true;
+            break;
+        }
+
+        unsigned long produced = buffer.size() - stream->avail_out;
+        if (produced > 0 && !downstream.write(buffer.data(), produced)) {
+            failed = true;
+            break;
+        }
+
+        if (flush == Z_FINISH ? result == Z_STREAM_END : (stream->avail_in == 0 && stream->avail_out > 0))
+            break;
+    }
+
+    return !failed;
+}
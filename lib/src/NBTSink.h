@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include "Compression.h"
+
+struct z_stream_s;
+
+// destination for serialized bytes. the serializer batches its output, so write() sees few large calls
+class NBTSink {
+public:
+    virtual ~NBTSink() = default;
+
+    // returns false if the bytes couldn't be written
+    virtual bool write(const char *bytes, unsigned long size) = 0;
+
+    // called by the serializer once a whole document was written
+    virtual bool finish() {
+        return true;
+    }
+};
+
+// fixed, caller-owned buffer (e.g. sized with NBT::serializedSize)
+class BufferSink : public NBTSink {
+public:
+    BufferSink(char *buffer, unsigned long capacity);
+
+    bool write(const char *bytes, unsigned long size) override;
+
+    unsigned long size() const;
+
+private:
+    char *buffer;
+    unsigned long capacity;
+    unsigned long written = 0;
+};
+
+// appends to a vector
+class VectorSink : public NBTSink {
+public:
+    explicit VectorSink(std::vector<char> &vector);
+
+    bool write(const char *bytes, unsigned long size) override;
+
+private:
+    std::vector<char> &vector;
+};
+
+class FileDescriptorSink : public NBTSink {
+public:
+    explicit FileDescriptorSink(int fd);
+
+    bool write(const char *bytes, unsigned long size) override;
+
+private:
+    int fd;
+};
+
+class FileSink : public NBTSink {
+public:
+    explicit FileSink(FILE *file);
+
+    bool write(const char *bytes, unsigned long size) override;
+
+    bool finish() override;
+
+private:
+    FILE *file;
+};
+
+// compresses everything written to it on the fly and passes the compressed bytes on to another sink.
+// finish() ends the current gzip member/zlib stream, writing again afterwards starts a new one
+class DeflateSink : public NBTSink {
+public:
+    explicit DeflateSink(NBTSink &downstream, CompressionFormat format = CompressionFormat::GZIP, int level = -1,
+                         unsigned long bufferSize = 64 * 1024);
+
+    DeflateSink(NBTSink &downstream, const CompressionOptions &options, unsigned long bufferSize = 64 * 1024);
+
+    ~DeflateSink() override;
+
+    DeflateSink(const DeflateSink &) = delete;
+
+    DeflateSink &operator=(const DeflateSink &) = delete;
+
+    bool write(const char *bytes, unsigned long size) override;
+
+    bool finish() override;
+
+private:
+    NBTSink &downstream;
+    z_stream_s *stream; // borrowed from the per-thread stream cache
+    std::vector<char> buffer;
+    bool failed = false;
+
+    bool deflateInput(int flush);
+};
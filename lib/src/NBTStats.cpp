@@ -0,0 +1,171 @@
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include "NBTStats.h"
+#include "NBT.h"
+
+static std::atomic<bool> statsEnabled{false};
+
+static std::atomic<NBTStats::TraceCallback> traceCallback{nullptr};
+static std::atomic<void *> traceContext{nullptr};
+
+static std::mutex processTotalMutex;
+static NBTStats processTotalStats;
+
+namespace {
+    struct ThreadStats {
+        NBTStats current;
+        NBTStats last;
+        NBTStats total;
+        unsigned int callDepth = 0;
+        NBTTraceSpan *openSpan = nullptr;
+    };
+}
+
+static thread_local ThreadStats threadStats;
+
+static unsigned long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+NBTStats &NBTStats::operator+=(const NBTStats &other) {
+    calls += other.calls;
+    compressedBytes += other.compressedBytes;
+    uncompressedBytes += other.uncompressedBytes;
+    inflateNanos += other.inflateNanos;
+    buildNanos += other.buildNanos;
+    serializeNanos += other.serializeNanos;
+    deflateNanos += other.deflateNanos;
+
+    for (unsigned long i = 0; i < 13; i++) {
+        tagCounts[i] += other.tagCounts[i];
+    }
+    maxDepth = std::max(maxDepth, other.maxDepth);
+
+    bytesAllocated += other.bytesAllocated;
+    peakBytes = std::max(peakBytes, other.peakBytes);
+    return *this;
+}
+
+static void countNode(NBTStats &stats, const NBT &nbt, unsigned long depth) {
+    if (nbt.tagID >= 0 && nbt.tagID < 13)
+        stats.tagCounts[(int) nbt.tagID]++;
+    stats.maxDepth = std::max(stats.maxDepth, depth);
+
+    // names are interned, they cost nothing per node
+    stats.bytesAllocated += nbt.valueBytes.capacity() + nbt.listChildren.capacity() * sizeof(NBT);
+
+    for (const NBT &child: nbt.listChildren) {
+        countNode(stats, child, depth + 1);
+    }
+
+    stats.bytesAllocated += nbt.compoundElements.heapBytes();
+    for (const auto &element: nbt.compoundElements) {
+        countNode(stats, element.second, depth + 1);
+    }
+}
+
+void NBTStats::countTree(const NBT &root) {
+    bytesAllocated += sizeof(NBT);
+    countNode(*this, root, 1);
+}
+
+void NBTStats::setEnabled(bool enabled) {
+    statsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool NBTStats::enabled() {
+    return statsEnabled.load(std::memory_order_relaxed);
+}
+
+NBTStats NBTStats::last() {
+    return threadStats.last;
+}
+
+NBTStats NBTStats::threadTotal() {
+    return threadStats.total;
+}
+
+NBTStats NBTStats::processTotal() {
+    std::lock_guard<std::mutex> lock(processTotalMutex);
+    return processTotalStats;
+}
+
+void NBTStats::resetTotals() {
+    threadStats.total = NBTStats();
+
+    std::lock_guard<std::mutex> lock(processTotalMutex);
+    processTotalStats = NBTStats();
+}
+
+void NBTStats::setTraceCallback(TraceCallback callback, void *context) {
+    traceContext.store(context);
+    traceCallback.store(callback);
+}
+
+NBTStatsCall::NBTStatsCall() {
+    recording = threadStats.callDepth > 0 || NBTStats::enabled();
+    outermost = threadStats.callDepth == 0;
+
+    if (!recording)
+        return;
+
+    if (outermost)
+        threadStats.current = NBTStats();
+    threadStats.callDepth++;
+}
+
+NBTStatsCall::~NBTStatsCall() {
+    if (!recording)
+        return;
+
+    threadStats.callDepth--;
+    if (!outermost)
+        return;
+
+    NBTStats &current = threadStats.current;
+    current.calls = 1;
+
+    threadStats.last = current;
+    threadStats.total += current;
+
+    // one lock per call, not per node
+    std::lock_guard<std::mutex> lock(processTotalMutex);
+    processTotalStats += current;
+}
+
+bool NBTStatsCall::active() const {
+    return recording;
+}
+
+NBTStats &NBTStatsCall::stats() {
+    return threadStats.current;
+}
+
+NBTTraceSpan::NBTTraceSpan(const char *name, unsigned long NBTStats::*counter)
+        : name(name), counter(counter), active(threadStats.callDepth > 0) {
+    if (!active)
+        return;
+
+    parent = threadStats.openSpan;
+    threadStats.openSpan = this;
+    start = nowNanos();
+}
+
+NBTTraceSpan::~NBTTraceSpan() {
+    if (!active)
+        return;
+
+    unsigned long elapsed = nowNanos() - start;
+    threadStats.current.*counter += elapsed - std::min(childNanos, elapsed);
+
+    threadStats.openSpan = parent;
+    if (parent != nullptr)
+        parent->childNanos += elapsed;
+
+    NBTStats::TraceCallback callback = traceCallback.load(std::memory_order_relaxed);
+    if (callback != nullptr)
+        callback(name, elapsed, traceContext.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+class NBT;
+
+// counters of NBT::deserialize / NBT::serialize calls. collection is opt-in (setEnabled), while disabled the codec
+// only pays one relaxed atomic load per call. counters live in thread-local storage, nothing is shared per node
+struct NBTStats {
+    unsigned long calls = 0;
+
+    // gzip side and plain NBT side of the call
+    unsigned long compressedBytes = 0;
+    unsigned long uncompressedBytes = 0;
+
+    // time per phase, nested phases are not counted twice (serialize excludes the deflate it triggers)
+    unsigned long inflateNanos = 0;
+    unsigned long buildNanos = 0;
+    unsigned long serializeNanos = 0;
+    unsigned long deflateNanos = 0;
+
+    // indexed by tag id
+    unsigned long tagCounts[13] = {};
+    unsigned long maxDepth = 0;
+
+    // estimated heap footprint of the tree, and of everything alive at once during the call
+    unsigned long bytesAllocated = 0;
+    unsigned long peakBytes = 0;
+
+    // sums the counters, maxDepth and peakBytes take the maximum
+    NBTStats &operator+=(const NBTStats &other);
+
+    // adds node counts, depth and heap footprint of a tree
+    void countTree(const NBT &root);
+
+    static void setEnabled(bool enabled);
+
+    static bool enabled();
+
+    // the last call on this thread
+    static NBTStats last();
+
+    // every call on this thread / in the process since the last reset
+    static NBTStats threadTotal();
+
+    static NBTStats processTotal();
+
+    static void resetTotals();
+
+    // receives every finished trace span with its inclusive duration. nullptr turns tracing off
+    typedef void (*TraceCallback)(const char *span, unsigned long nanos, void *context);
+
+    static void setTraceCallback(TraceCallback callback, void *context = nullptr);
+};
+
+// brackets one instrumented call. calls nested in another one (serialize -> serializeInto) add to the outer record,
+// only the outermost publishes it to last() and the totals
+class NBTStatsCall {
+public:
+    NBTStatsCall();
+
+    ~NBTStatsCall();
+
+    NBTStatsCall(const NBTStatsCall &) = delete;
+
+    NBTStatsCall &operator=(const NBTStatsCall &) = delete;
+
+    // false while collection is disabled, nothing should be recorded then
+    bool active() const;
+
+    // record of the call in progress
+    NBTStats &stats();
+
+private:
+    bool recording;
+    bool outermost;
+};
+
+// times a phase of the current call into one of the *Nanos counters and reports it to the trace callback.
+// does nothing (not even read the clock) outside an active NBTStatsCall
+class NBTTraceSpan {
+public:
+    NBTTraceSpan(const char *name, unsigned long NBTStats::*counter);
+
+    ~NBTTraceSpan();
+
+    NBTTraceSpan(const NBTTraceSpan &) = delete;
+
+    NBTTraceSpan &operator=(const NBTTraceSpan &) = delete;
+
+private:
+    const char *name;
+    unsigned long NBTStats::*counter;
+    NBTTraceSpan *parent = nullptr;
+    unsigned long start = 0;
+    unsigned long childNanos = 0;
+    bool active;
+};
@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <zlib.h>
+#include "NBTStreamParser.h"
+#include "BigEndian.h"
+#include "ByteSwap.h"
+
+const unsigned long ARRAY_CHUNK_ELEMENTS = 8 * 1024;
+
+NBTStreamParser::NBTStreamParser(NBTHandler &handler, unsigned long windowSize)
+        : handler(handler), window(std::max(windowSize, MIN_WINDOW_SIZE)), intBuffer(ARRAY_CHUNK_ELEMENTS),
+          longBuffer(ARRAY_CHUNK_ELEMENTS) {
+}
+
+NBTStreamParser::~NBTStreamParser() {
+    if (zStream)
+        inflateEnd(zStream.get());
+}
+
+bool NBTStreamParser::feed(const char *bytes, unsigned long size) {
+    if (state == State::FAILED)
+        return false;
+
+    if (compression == Compression::UNKNOWN) {
+        // two bytes are enough to tell gzip (1f 8b) and zlib (78 xx) apart from a raw TAG_Compound
+        while (detectCount < 2 && size > 0) {
+            detectBytes[detectCount++] = *bytes;
+            bytes++;
+            size--;
+        }
+
+        if (detectCount < 2)
+            return true;
+
+        bool gzipped = (unsigned char) detectBytes[0] == 0x1f && (unsigned char) detectBytes[1] == 0x8b;
+        bool zlibWrapped = (unsigned char) detectBytes[0] == 0x78;
+
+        if (gzipped || zlibWrapped) {
+            zStream = std::make_unique<z_stream>();
+            // 32 lets zlib figure out the gzip/zlib header by itself
+            if (inflateInit2(zStream.get(), 32 + MAX_WBITS) != Z_OK) {
+                zStream.reset();
+                fail();
+                return false;
+            }
+            compression = Compression::DEFLATE;
+        } else {
+            compression = Compression::NONE;
+        }
+
+        state = State::ROOT_HEADER;
+        if (!feedDetected(detectBytes, detectCount))
+            return false;
+    }
+
+    return feedDetected(bytes, size);
+}
+
+bool NBTStreamParser::feedDetected(const char *bytes, unsigned long size) {
+    if (compression == Compression::DEFLATE)
+        return feedCompressed(bytes, size);
+
+    return feedInflated(bytes, size);
+}
+
+bool NBTStreamParser::feedInflated(const char *bytes, unsigned long size) {
+    while (size > 0 && state != State::FAILED) {
+        compactWindow();
+
+        unsigned long count = std::min(size, window.size() - writePos);
+        std::memcpy(window.data() + writePos, bytes, count);
+        writePos += count;
+        bytes += count;
+        size -= count;
+
+        parseWindow();
+    }
+
+    return state != State::FAILED;
+}
+
+bool NBTStreamParser::feedCompressed(const char *bytes, unsigned long size) {
+    z_stream *stream = zStream.get();
+
+    while (size > 0 && state != State::FAILED) {
+        // avail_in is only 32 bits, so huge inputs are handed to zlib in several rounds
+        unsigned long roundSize = std::min(size, 1ul << 30);
+        stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes));
+        stream->avail_in = roundSize;
+        bytes += roundSize;
+        size -= roundSize;
+
+        while (state != State::FAILED) {
+            compactWindow();
+
+            stream->next_out = reinterpret_cast<Bytef *>(window.data() + writePos);
+            stream->avail_out = window.size() - writePos;
+
+            int result = inflate(stream, Z_NO_FLUSH);
+            writePos = window.size() - stream->avail_out;
+
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                fail();
+                break;
+            }
+
+            parseWindow();
+
+            if (result == Z_STREAM_END) {
+                streamEnded = true;
+                // concatenated gzip members form one stream
+                if (stream->avail_in == 0)
+                    break;
+                inflateReset(stream);
+                streamEnded = false;
+                continue;
+            }
+
+            if (stream->avail_in == 0 && stream->avail_out > 0)
+                break;
+        }
+    }
+
+    return state != State::FAILED;
+}
+
+bool NBTStreamParser::finish() {
+    if (state == State::FAILED)
+        return false;
+
+    if (compression == Compression::UNKNOWN && detectCount > 0) {
+        // input too short to sniff, treat it as uncompressed
+        compression = Compression::NONE;
+        state = State::ROOT_HEADER;
+        feedInflated(detectBytes, detectCount);
+    }
+
+    // the document may be complete while the deflate stream or its trailer (and checksum) is cut off
+    if (compression == Compression::DEFLATE && !streamEnded)
+        fail();
+
+    return state == State::DONE;
+}
+
+bool NBTStreamParser::parse(std::istream &input, unsigned long chunkSize) {
+    std::vector<char> chunk(chunkSize);
+
+    while (input) {
+        input.read(chunk.data(), (std::streamsize) chunk.size());
+        if (input.gcount() > 0 && !feed(chunk.data(), input.gcount()))
+            return false;
+    }
+
+    if (input.bad())
+        return false;
+
+    return finish();
+}
+
+bool NBTStreamParser::parseFileDescriptor(int fd, unsigned long chunkSize) {
+    std::vector<char> chunk(chunkSize);
+
+    while (true) {
+        ssize_t count = read(fd, chunk.data(), chunk.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return false;
+        if (count == 0)
+            break;
+        if (!feed(chunk.data(), count))
+            return false;
+    }
+
+    return finish();
+}
+
+bool NBTStreamParser::done() const {
+    return state == State::DONE;
+}
+
+bool NBTStreamParser::failed() const {
+    return state == State::FAILED;
+}
+
+unsigned long long NBTStreamParser::bytesParsed() const {
+    return parsed;
+}
+
+void NBTStreamParser::compactWindow() {
+    if (readPos == 0)
+        return;
+
+    std::memmove(window.data(), window.data() + readPos, writePos - readPos);
+    writePos -= readPos;
+    readPos = 0;
+}
+
+void NBTStreamParser::parseWindow() {
+    while (true) {
+        bool progressed;
+
+        switch (state) {
+            case State::ROOT_HEADER:
+                progressed = parseHeader(false);
+                break;
+            case State::NAMED_HEADER:
+                progressed = parseHeader(true);
+                break;
+            case State::VALUE:
+                progressed = parseValue();
+                break;
+            case State::ARRAY_BODY:
+                progressed = parseArrayBody();
+                break;
+            default:
+                progressed = false;
+                break;
+        }
+
+        if (!progressed)
+            break;
+    }
+
+    // anything after the root compound is ignored, same as NBT::deserialize
+    if (state == State::DONE)
+        readPos = writePos;
+}
+
+bool NBTStreamParser::parseHeader(bool named) {
+    unsigned long available = writePos - readPos;
+    const char *bytes = window.data() + readPos;
+
+    if (available < 1)
+        return false;
+
+    char tagID = bytes[0];
+
+    if (named && tagID == TAG_End) {
+        consume(1);
+        handler.onCompoundEnd();
+        stack.pop_back();
+        afterValue();
+        return true;
+    }
+
+    if ((!named && tagID != TAG_Compound) || tagID < TAG_Byte || tagID > TAG_Long_Array) {
+        fail();
+        return false;
+    }
+
+    if (available < 3)
+        return false;
+
+    unsigned short nameLength = readBigEndian<unsigned short>(bytes + 1);
+    if (available < 3ul + nameLength)
+        return false;
+
+    handler.onName(std::string_view(bytes + 3, nameLength));
+    consume(3ul + nameLength);
+
+    pendingTag = tagID;
+    state = State::VALUE;
+    return true;
+}
+
+bool NBTStreamParser::parseValue() {
+    unsigned long available = writePos - readPos;
+    const char *bytes = window.data() + readPos;
+
+    switch (pendingTag) {
+        case TAG_Byte:
+            if (available < 1)
+                return false;
+            handler.onByte(bytes[0]);
+            consume(1);
+            break;
+        case TAG_Short:
+            if (available < 2)
+                return false;
+            handler.onShort(readBigEndian<signed short>(bytes));
+            consume(2);
+            break;
+        case TAG_Int:
+            if (available < 4)
+                return false;
+            handler.onInt(readBigEndian<signed int>(bytes));
+            consume(4);
+            break;
+        case TAG_Long:
+            if (available < 8)
+                return false;
+            handler.onLong(readBigEndian<signed long>(bytes));
+            consume(8);
+            break;
+        case TAG_Float:
+            if (available < 4)
+                return false;
+            handler.onFloat(readBigEndian<float>(bytes));
+            consume(4);
+            break;
+        case TAG_Double:
+            if (available < 8)
+                return false;
+            handler.onDouble(readBigEndian<double>(bytes));
+            consume(8);
+            break;
+        case TAG_String: {
+            if (available < 2)
+                return false;
+            unsigned short length = readBigEndian<unsigned short>(bytes);
+            if (available < 2ul + length)
+                return false;
+            handler.onString(std::string_view(bytes + 2, length));
+            consume(2ul + length);
+            break;
+        }
+        case TAG_List: {
+            if (available < 5)
+                return false;
+
+            char listType = bytes[0];
+            signed int count = std::max(readBigEndian<signed int>(bytes + 1), 0);
+            if (stack.size() >= MAX_DEPTH || (count > 0 && (listType < TAG_Byte || listType > TAG_Long_Array))) {
+                fail();
+                return false;
+            }
+
+            consume(5);
+            handler.onListBegin(listType, count);
+            stack.push_back(Frame{TAG_List, listType, count});
+            break;
+        }
+        case TAG_Compound: {
+            if (stack.size() >= MAX_DEPTH) {
+                fail();
+                return false;
+            }
+
+            handler.onCompoundBegin();
+            stack.push_back(Frame{TAG_Compound, TAG_End, 0});
+            state = State::NAMED_HEADER;
+            return true;
+        }
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array: {
+            if (available < 4)
+                return false;
+
+            signed int count = readBigEndian<signed int>(bytes);
+            if (count < 0) {
+                fail();
+                return false;
+            }
+            consume(4);
+
+            if (pendingTag == TAG_Byte_Array)
+                handler.onByteArrayBegin(count);
+            else if (pendingTag == TAG_Int_Array)
+                handler.onIntArrayBegin(count);
+            else
+                handler.onLongArrayBegin(count);
+
+            arrayRemaining = count;
+            state = State::ARRAY_BODY;
+            return true;
+        }
+        default:
+            fail();
+            return false;
+    }
+
+    afterValue();
+    return true;
+}
+
+bool NBTStreamParser::parseArrayBody() {
+    if (arrayRemaining == 0) {
+        if (pendingTag == TAG_Byte_Array)
+            handler.onByteArrayEnd();
+        else if (pendingTag == TAG_Int_Array)
+            handler.onIntArrayEnd();
+        else
+            handler.onLongArrayEnd();
+
+        afterValue();
+        return true;
+    }
+
+    unsigned long available = writePos - readPos;
+    const char *bytes = window.data() + readPos;
+
+    unsigned long elementSize = pendingTag == TAG_Byte_Array ? 1 : pendingTag == TAG_Int_Array ? 4 : 8;
+    unsigned long count = std::min(available / elementSize, (unsigned long) arrayRemaining);
+    if (count == 0)
+        return false;
+
+    if (pendingTag == TAG_Byte_Array) {
+        handler.onByteArrayChunk(bytes, count);
+    } else if (pendingTag == TAG_Int_Array) {
+        count = std::min(count, intBuffer.size());
+        readBigEndianArray(bytes, intBuffer.data(), count);
+        handler.onIntArrayChunk(intBuffer.data(), count);
+    } else {
+        count = std::min(count, longBuffer.size());
+        readBigEndianArray(bytes, longBuffer.data(), count);
+        handler.onLongArrayChunk(longBuffer.data(), count);
+    }
+
+    consume(count * elementSize);
+    arrayRemaining -= (signed int) count;
+    return true;
+}
+
+void NBTStreamParser::afterValue() {
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+
+        if (top.tagID == TAG_Compound) {
+            state = State::NAMED_HEADER;
+            return;
+        }
+
+        if (top.remaining > 0) {
+            top.remaining--;
+            pendingTag = top.listType;
+            state = State::VALUE;
+            return;
+        }
+
+        handler.onListEnd();
+        stack.pop_back();
+    }
+
+    state = State::DONE;
+}
+
+void NBTStreamParser::consume(unsigned long count) {
+    readPos += count;
+    parsed += count;
+}
+
+void NBTStreamParser::fail() {
+    state = State::FAILED;
+}
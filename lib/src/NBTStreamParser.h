@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <istream>
+#include <memory>
+#include "NBT.h"
+
+struct z_stream_s;
+
+// callbacks for NBTStreamParser. everything defaults to doing nothing, so handlers only override what they need.
+// views and pointers passed in are only valid for the duration of the call
+class NBTHandler {
+public:
+    virtual ~NBTHandler() = default;
+
+    // called before the value of every named tag (the root and compound elements, not list elements)
+    virtual void onName(std::string_view /*name*/) {}
+
+    virtual void onCompoundBegin() {}
+
+    virtual void onCompoundEnd() {}
+
+    virtual void onListBegin(char /*listType*/, signed int /*count*/) {}
+
+    virtual void onListEnd() {}
+
+    virtual void onByte(char /*value*/) {}
+
+    virtual void onShort(signed short /*value*/) {}
+
+    virtual void onInt(signed int /*value*/) {}
+
+    virtual void onLong(signed long /*value*/) {}
+
+    virtual void onFloat(float /*value*/) {}
+
+    virtual void onDouble(double /*value*/) {}
+
+    virtual void onString(std::string_view /*value*/) {}
+
+    // arrays arrive in chunks of whatever is currently inflated, already converted to native byte order
+    virtual void onByteArrayBegin(signed int /*count*/) {}
+
+    virtual void onByteArrayChunk(const char * /*values*/, unsigned long /*count*/) {}
+
+    virtual void onByteArrayEnd() {}
+
+    virtual void onIntArrayBegin(signed int /*count*/) {}
+
+    virtual void onIntArrayChunk(const signed int * /*values*/, unsigned long /*count*/) {}
+
+    virtual void onIntArrayEnd() {}
+
+    virtual void onLongArrayBegin(signed int /*count*/) {}
+
+    virtual void onLongArrayChunk(const signed long * /*values*/, unsigned long /*count*/) {}
+
+    virtual void onLongArrayEnd() {}
+};
+
+// push parser: input (gzip, zlib or uncompressed) is fed in pieces of any size, inflated into a fixed-size window
+// and turned into NBTHandler events. peak memory is bounded by the window, not by the document size
+class NBTStreamParser {
+public:
+    // the window always holds at least one maximum-length string/name
+    static constexpr unsigned long MIN_WINDOW_SIZE = 64 * 1024 + 16;
+
+    static constexpr unsigned long MAX_DEPTH = 512;
+
+    explicit NBTStreamParser(NBTHandler &handler, unsigned long windowSize = 256 * 1024);
+
+    ~NBTStreamParser();
+
+    NBTStreamParser(const NBTStreamParser &) = delete;
+
+    NBTStreamParser &operator=(const NBTStreamParser &) = delete;
+
+    // returns false as soon as the input turns out to be malformed
+    bool feed(const char *bytes, unsigned long size);
+
+    // call after the last feed, returns true if a complete document was parsed (and, for compressed input, the
+    // stream ended with a valid trailer). anything after the root compound is ignored
+    bool finish();
+
+    // feed everything from a stream/file descriptor and finish
+    bool parse(std::istream &input, unsigned long chunkSize = 64 * 1024);
+
+    bool parseFileDescriptor(int fd, unsigned long chunkSize = 64 * 1024);
+
+    bool done() const;
+
+    bool failed() const;
+
+    // number of (inflated) NBT bytes consumed so far
+    unsigned long long bytesParsed() const;
+
+private:
+    enum class State {
+        DETECT_COMPRESSION,
+        ROOT_HEADER,
+        NAMED_HEADER,
+        VALUE,
+        ARRAY_BODY,
+        DONE,
+        FAILED
+    };
+
+    enum class Compression {
+        UNKNOWN,
+        NONE,
+        DEFLATE
+    };
+
+    struct Frame {
+        char tagID;
+        char listType;
+        signed int remaining;
+    };
+
+    NBTHandler &handler;
+
+    std::vector<char> window;
+    unsigned long readPos = 0;
+    unsigned long writePos = 0;
+
+    // converted array elements are handed out from here
+    std::vector<signed int> intBuffer;
+    std::vector<signed long> longBuffer;
+
+    std::unique_ptr<z_stream_s> zStream;
+    Compression compression = Compression::UNKNOWN;
+    // the last gzip/zlib member was read up to and including its trailer
+    bool streamEnded = false;
+
+    char detectBytes[2]{};
+    unsigned long detectCount = 0;
+
+    State state = State::DETECT_COMPRESSION;
+    std::vector<Frame> stack{};
+    char pendingTag = TAG_End;
+    signed int arrayRemaining = 0;
+    unsigned long long parsed = 0;
+
+    bool feedDetected(const char *bytes, unsigned long size);
+
+    bool feedInflated(const char *bytes, unsigned long size);
+
+    bool feedCompressed(const char *bytes, unsigned long size);
+
+    void compactWindow();
+
+    // runs the state machine over the window until it needs more input
+    void parseWindow();
+
+    bool parseHeader(bool named);
+
+    bool parseValue();
+
+    bool parseArrayBody();
+
+    void afterValue();
+
+    void consume(unsigned long count);
+
+    void fail();
+};
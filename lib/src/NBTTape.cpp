@@ -0,0 +1,393 @@
+#include <algorithm>
+#include "NBTTape.h"
+#include "BigEndian.h"
+#include "Compression.h"
+
+static unsigned long scalarSize(char tagID) {
+    switch (tagID) {
+        case TAG_Byte:
+            return 1;
+        case TAG_Short:
+            return 2;
+        case TAG_Int:
+        case TAG_Float:
+            return 4;
+        case TAG_Long:
+        case TAG_Double:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+NBTTape::NBTTape() = default;
+
+namespace {
+    // compound or list whose children are still being indexed
+    struct OpenContainer {
+        uint32_t entry;
+        uint32_t lastChild; // 0 until the first child was added
+        signed int remaining; // list elements left
+        char listType;
+        uint32_t table; // its ChildTable
+    };
+}
+
+class TapeBuilder {
+public:
+    TapeBuilder(const char *bytes, unsigned long size, std::vector<NBTTape::Entry> &entries,
+                std::vector<NBTTape::ChildTable> &childTables, std::vector<uint32_t> &childIndices)
+            : bytes(bytes), size(size), entries(entries), childTables(childTables), childIndices(childIndices) {
+    }
+
+    bool run();
+
+private:
+    const char *bytes;
+    unsigned long size;
+    unsigned long position = 0;
+    std::vector<NBTTape::Entry> &entries;
+    std::vector<NBTTape::ChildTable> &childTables;
+    std::vector<uint32_t> &childIndices;
+    std::vector<OpenContainer> stack;
+
+    bool has(unsigned long count) const {
+        return count <= size - position;
+    }
+
+    bool addEntry(char tagID, uint16_t nameLength, bool named);
+
+    void closeContainer();
+};
+
+bool TapeBuilder::run() {
+    if (!has(3) || bytes[0] != TAG_Compound)
+        return false;
+
+    uint16_t nameLength = readBigEndian<uint16_t>(bytes + 1);
+    position = 3;
+    if (!has(nameLength))
+        return false;
+    position += nameLength;
+
+    if (!addEntry(TAG_Compound, nameLength, true))
+        return false;
+
+    while (!stack.empty()) {
+        OpenContainer &container = stack.back();
+        char tagID;
+        uint16_t childNameLength = 0;
+
+        if (entries[container.entry].tagID == TAG_Compound) {
+            if (!has(1))
+                return false;
+
+            tagID = bytes[position++];
+            if (tagID == TAG_End) {
+                closeContainer();
+                continue;
+            }
+
+            if (!has(2))
+                return false;
+            childNameLength = readBigEndian<uint16_t>(bytes + position);
+            position += 2;
+            if (!has(childNameLength))
+                return false;
+            position += childNameLength;
+        } else {
+            if (container.remaining == 0) {
+                closeContainer();
+                continue;
+            }
+
+            container.remaining--;
+            tagID = container.listType;
+        }
+
+        // the new entry is the sibling of the previous child
+        uint32_t index = entries.size();
+        if (container.lastChild != 0)
+            entries[container.lastChild].next = index;
+        else
+            entries[container.entry].flags |= NBTTape::HAS_CHILD_ENTRIES;
+        container.lastChild = index;
+
+        // list children go into the slots reserved when the list was opened, compounds only count theirs
+        NBTTape::ChildTable &table = childTables[container.table];
+        if (entries[container.entry].tagID == TAG_List)
+            childIndices[table.start + table.count - container.remaining - 1] = index;
+        else
+            table.count++;
+
+        if (!addEntry(tagID, childNameLength, entries[container.entry].tagID == TAG_Compound))
+            return false;
+    }
+
+    // trailing bytes after the root are tolerated, like NBT::deserialize does
+    return true;
+}
+
+// appends the entry for a tag whose payload starts at position, and either skips the payload or opens it
+bool TapeBuilder::addEntry(char tagID, uint16_t nameLength, bool named) {
+    NBTTape::Entry entry{};
+    entry.payloadOffset = position;
+    entry.nameLength = nameLength;
+    entry.tagID = tagID;
+    entry.flags = named ? NBTTape::NAMED : 0;
+
+    switch (tagID) {
+        case TAG_Byte:
+        case TAG_Short:
+        case TAG_Int:
+        case TAG_Long:
+        case TAG_Float:
+        case TAG_Double:
+            if (!has(scalarSize(tagID)))
+                return false;
+            position += scalarSize(tagID);
+            break;
+        case TAG_String: {
+            if (!has(2))
+                return false;
+            unsigned long length = readBigEndian<uint16_t>(bytes + position);
+            position += 2;
+            if (!has(length))
+                return false;
+            position += length;
+            break;
+        }
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array: {
+            if (!has(4))
+                return false;
+            signed int length = readBigEndian<signed int>(bytes + position);
+            position += 4;
+
+            unsigned long elementSize = tagID == TAG_Byte_Array ? 1 : tagID == TAG_Int_Array ? 4 : 8;
+            if (length < 0 || !has(elementSize * (unsigned long) length))
+                return false;
+            position += elementSize * (unsigned long) length;
+            break;
+        }
+        case TAG_List: {
+            if (!has(5))
+                return false;
+            char listType = bytes[position];
+            signed int count = readBigEndian<signed int>(bytes + position + 1);
+            position += 5;
+
+            if (count > 0 && (listType < TAG_Byte || listType > TAG_Long_Array))
+                return false;
+
+            // scalar elements don't get entries, the list is skipped as a whole
+            unsigned long elementSize = scalarSize(listType);
+            if (elementSize > 0 || count <= 0) {
+                unsigned long elementCount = count > 0 ? count : 0;
+                if (!has(elementSize * elementCount))
+                    return false;
+                position += elementSize * elementCount;
+                break;
+            }
+
+            // every element takes at least a byte, which also bounds the slots reserved below
+            if (stack.size() >= NBTTape::MAX_DEPTH || !has(count))
+                return false;
+            stack.push_back({(uint32_t) entries.size(), 0, count, listType, (uint32_t) childTables.size()});
+            childTables.push_back({(uint32_t) entries.size(), (uint32_t) childIndices.size(), (uint32_t) count});
+            childIndices.resize(childIndices.size() + count);
+            entries.push_back(entry);
+            return true;
+        }
+        case TAG_Compound:
+            if (stack.size() >= NBTTape::MAX_DEPTH)
+                return false;
+            stack.push_back({(uint32_t) entries.size(), 0, 0, TAG_End, (uint32_t) childTables.size()});
+            childTables.push_back({(uint32_t) entries.size(), 0, 0});
+            entries.push_back(entry);
+            return true;
+        default:
+            return false;
+    }
+
+    entry.endOffset = position;
+    entries.push_back(entry);
+    return true;
+}
+
+void TapeBuilder::closeContainer() {
+    entries[stack.back().entry].endOffset = position;
+    stack.pop_back();
+}
+
+bool NBTTape::build(const char *byteArray, unsigned long byteArraySize) {
+    clear();
+
+    // offsets are stored in 32 bits
+    if (byteArraySize >= (1ul << 32))
+        return false;
+
+    TapeBuilder builder(byteArray, byteArraySize, entries, childTables, childIndices);
+    if (!builder.run()) {
+        entries.clear();
+        childTables.clear();
+        childIndices.clear();
+        return false;
+    }
+
+    buffer = byteArray;
+    bufferSize = byteArraySize;
+    return true;
+}
+
+bool NBTTape::build(std::string bytes) {
+    CompressionFormat format = detectCompression(bytes.data(), bytes.size());
+    if (format != CompressionFormat::NONE) {
+        std::string inflated;
+        if (!decompressBuffer(bytes.data(), bytes.size(), format, inflated))
+            return false;
+        bytes = std::move(inflated);
+    }
+
+    if (!build(bytes.data(), bytes.size()))
+        return false;
+
+    // data() reads from owned from here on, so moving the tape around keeps it valid
+    owned = std::move(bytes);
+    buffer = nullptr;
+    return true;
+}
+
+void NBTTape::clear() {
+    owned.clear();
+    buffer = nullptr;
+    bufferSize = 0;
+    entries.clear();
+    childTables.clear();
+    childIndices.clear();
+}
+
+bool NBTTape::empty() const {
+    return entries.empty();
+}
+
+NBTTapeNode NBTTape::root() const {
+    return node(0);
+}
+
+NBTTapeNode NBTTape::node(unsigned long index) const {
+    if (index >= entries.size())
+        return NBTTapeNode();
+
+    return NBTTapeNode(this, index);
+}
+
+unsigned long NBTTape::size() const {
+    return entries.size();
+}
+
+const char *NBTTape::data() const {
+    return buffer != nullptr ? buffer : owned.data();
+}
+
+unsigned long NBTTape::dataSize() const {
+    return bufferSize;
+}
+
+unsigned long NBTTape::memoryUsage() const {
+    return entries.capacity() * sizeof(Entry) + childTables.capacity() * sizeof(ChildTable) +
+           childIndices.capacity() * sizeof(uint32_t) + owned.capacity();
+}
+
+// containers are opened in tape order, so their tables are sorted by entry
+const NBTTape::ChildTable &NBTTape::childTable(uint32_t entry) const {
+    auto table = std::lower_bound(childTables.begin(), childTables.end(), entry,
+                                  [](const ChildTable &table, uint32_t entry) { return table.entry < entry; });
+    assert(table != childTables.end() && table->entry == entry);
+    return *table;
+}
+
+NBTTapeNode::NBTTapeNode() = default;
+
+NBTTapeNode::NBTTapeNode(const NBTTape *tape, uint32_t position) : tape(tape), position(position) {
+}
+
+bool NBTTapeNode::valid() const {
+    return tape != nullptr;
+}
+
+char NBTTapeNode::tagID() const {
+    return tape->entries[position].tagID;
+}
+
+std::string_view NBTTapeNode::name() const {
+    const NBTTape::Entry &entry = tape->entries[position];
+    return std::string_view(tape->data() + entry.payloadOffset - entry.nameLength, entry.nameLength);
+}
+
+unsigned long NBTTapeNode::payloadOffset() const {
+    return tape->entries[position].payloadOffset;
+}
+
+unsigned long NBTTapeNode::endOffset() const {
+    return tape->entries[position].endOffset;
+}
+
+unsigned long NBTTapeNode::index() const {
+    return position;
+}
+
+signed int NBTTapeNode::childrenCount() const {
+    if (tagID() != TAG_Compound)
+        return view().childrenCount();
+
+    return (signed int) tape->childTable(position).count;
+}
+
+NBTTapeNode NBTTapeNode::firstChild() const {
+    if (!(tape->entries[position].flags & NBTTape::HAS_CHILD_ENTRIES))
+        return NBTTapeNode();
+
+    return NBTTapeNode(tape, position + 1);
+}
+
+NBTTapeNode NBTTapeNode::nextSibling() const {
+    uint32_t next = tape->entries[position].next;
+    if (next == 0)
+        return NBTTapeNode();
+
+    return NBTTapeNode(tape, next);
+}
+
+NBTTapeNode NBTTapeNode::operator[](std::string_view childName) const {
+    assert(tagID() == TAG_Compound);
+
+    for (NBTTapeNode child = firstChild(); child.valid(); child = child.nextSibling()) {
+        if (child.name() == childName)
+            return child;
+    }
+    return NBTTapeNode();
+}
+
+NBTTapeNode NBTTapeNode::operator[](signed int index) const {
+    assert(tagID() == TAG_List);
+
+    if (index < 0 || !(tape->entries[position].flags & NBTTape::HAS_CHILD_ENTRIES))
+        return NBTTapeNode();
+
+    const NBTTape::ChildTable &table = tape->childTable(position);
+    if ((uint32_t) index >= table.count)
+        return NBTTapeNode();
+
+    return NBTTapeNode(tape, tape->childIndices[table.start + index]);
+}
+
+NBTView NBTTapeNode::view() const {
+    const NBTTape::Entry &entry = tape->entries[position];
+    const char *payload = tape->data() + entry.payloadOffset;
+
+    // list elements have no name at all, as opposed to an empty one
+    const char *nameBytes = (entry.flags & NBTTape::NAMED) ? payload - entry.nameLength : nullptr;
+    return NBTView(entry.tagID, nameBytes, entry.nameLength, payload, tape->data() + tape->bufferSize);
+}
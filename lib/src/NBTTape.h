@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "NBTView.h"
+
+class NBTTape;
+
+// cursor into an NBTTape. moving to the first child or the next sibling is a single jump no matter how big the
+// subtree in between is, and so is picking a list element by index. values are read through view()
+class NBTTapeNode {
+public:
+    NBTTapeNode();
+
+    bool valid() const;
+
+    char tagID() const;
+
+    // empty for list elements
+    std::string_view name() const;
+
+    // position of the payload inside the buffer and of the first byte after it
+    unsigned long payloadOffset() const;
+
+    unsigned long endOffset() const;
+
+    // tape index, stable for as long as the tape isn't rebuilt
+    unsigned long index() const;
+
+    // number of list children, compound elements or array elements. compounds look theirs up in the tape's child
+    // tables (a binary search over the containers), everything else reads it from the payload
+    signed int childrenCount() const;
+
+    // compounds and lists of non-scalars only. elements of scalar lists and arrays have no tape entries, they are
+    // fixed size and read through view()
+    NBTTapeNode firstChild() const;
+
+    // invalid after the last element of the parent
+    NBTTapeNode nextSibling() const;
+
+    // compound lookup, skipping each sibling in one jump. invalid if there's no element with that name
+    NBTTapeNode operator[](std::string_view childName) const;
+
+    // list lookup for lists of compounds, lists, strings and arrays: a binary search for the list's child table,
+    // then a direct index into it
+    NBTTapeNode operator[](signed int index) const;
+
+    NBTView view() const;
+
+private:
+    friend class NBTTape;
+
+    const NBTTape *tape = nullptr;
+    uint32_t position = 0;
+
+    NBTTapeNode(const NBTTape *tape, uint32_t position);
+};
+
+// structural index over a serialized NBT buffer: one 16 byte entry per tag (except the elements of scalar lists)
+// holding its type, name, payload and subtree end, plus a child table per compound and list of non-scalars (and a
+// 4 byte slot per element of those lists). building it validates the whole buffer once, afterwards any node can
+// be reached without re-parsing, and nothing but the index is allocated
+class NBTTape {
+public:
+    NBTTape();
+
+    NBTTape(const NBTTape &) = delete;
+
+    NBTTape &operator=(const NBTTape &) = delete;
+
+    NBTTape(NBTTape &&) noexcept = default;
+
+    NBTTape &operator=(NBTTape &&) noexcept = default;
+
+    // index an uncompressed buffer that has to outlive the tape. returns false (and leaves the tape empty) if the
+    // buffer isn't well formed NBT or is 4 GiB or bigger
+    bool build(const char *byteArray, unsigned long byteArraySize);
+
+    // same, but the tape keeps the buffer. gzip'd input is inflated first
+    bool build(std::string bytes);
+
+    void clear();
+
+    bool empty() const;
+
+    NBTTapeNode root() const;
+
+    // random access by tape index
+    NBTTapeNode node(unsigned long index) const;
+
+    // number of entries
+    unsigned long size() const;
+
+    const char *data() const;
+
+    unsigned long dataSize() const;
+
+    // index plus owned buffer, in bytes
+    unsigned long memoryUsage() const;
+
+    static const unsigned long MAX_DEPTH = 512;
+
+private:
+    friend class NBTTapeNode;
+    friend class TapeBuilder;
+
+    struct Entry {
+        uint32_t payloadOffset;
+        uint32_t endOffset; // first byte after the payload
+        uint32_t next; // tape index of the next sibling, 0 for the last element of a compound/list
+        uint16_t nameLength; // the name sits right before the payload
+        char tagID;
+        char flags;
+    };
+
+    // the following entry is the first child
+    static const char HAS_CHILD_ENTRIES = 1;
+    // compound elements and the root, as opposed to list elements
+    static const char NAMED = 2;
+
+    static_assert(sizeof(Entry) == 16, "tape entries are meant to stay at 16 bytes");
+
+    // one per compound and list of non-scalars, in tape order
+    struct ChildTable {
+        uint32_t entry;
+        uint32_t start; // lists: position of the element's tape indices in childIndices
+        uint32_t count; // child entries
+    };
+
+    std::string owned{};
+    const char *buffer = nullptr;
+    unsigned long bufferSize = 0;
+    std::vector<Entry> entries{};
+    std::vector<ChildTable> childTables{};
+    std::vector<uint32_t> childIndices{};
+
+    const ChildTable &childTable(uint32_t entry) const;
+};
@@ -0,0 +1,435 @@
+#include <algorithm>
+#include "NBTView.h"
+#include "BigEndian.h"
+#include "ByteSwap.h"
+
+NBTView::NBTView() = default;
+
+NBTView::NBTView(char tagID, const char *nameBytes, unsigned short nameLength, const char *payload,
+                 const char *bufferEnd) : tag(tagID), nameLength(nameLength), nameBytes(nameBytes),
+                                          payload(payload), bufferEnd(bufferEnd) {
+}
+
+NBTView NBTView::root(const char *byteArray, unsigned long byteArraySize) {
+    // compressed input has to be inflated by the caller first, the view can't own the inflated copy
+    assert(byteArraySize >= 3);
+    assert(byteArray[0] == TAG_Compound);
+
+    const char *bufferEnd = byteArray + byteArraySize;
+    unsigned short nameLength = readBigEndian<unsigned short>(byteArray + 1);
+    assert(byteArray + 3 + nameLength <= bufferEnd);
+
+    return NBTView(byteArray[0], byteArray + 3, nameLength, byteArray + 3 + nameLength, bufferEnd);
+}
+
+NBTView NBTView::root(const std::string &buffer) {
+    return root(buffer.data(), buffer.size());
+}
+
+static unsigned long scalarSize(char tagID) {
+    switch (tagID) {
+        case TAG_Byte:
+            return 1;
+        case TAG_Short:
+            return 2;
+        case TAG_Int:
+        case TAG_Float:
+            return 4;
+        case TAG_Long:
+        case TAG_Double:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+const char *NBTView::skipPayload(char tagID, const char *payload, const char *bufferEnd) {
+    switch (tagID) {
+        case TAG_Byte:
+        case TAG_Short:
+        case TAG_Int:
+        case TAG_Long:
+        case TAG_Float:
+        case TAG_Double:
+            payload += scalarSize(tagID);
+            break;
+        case TAG_String:
+            assert(payload + 2 <= bufferEnd);
+            payload += 2 + readBigEndian<unsigned short>(payload);
+            break;
+        case TAG_Byte_Array:
+            assert(payload + 4 <= bufferEnd);
+            payload += 4 + (unsigned long) readBigEndian<signed int>(payload);
+            break;
+        case TAG_Int_Array:
+            assert(payload + 4 <= bufferEnd);
+            payload += 4 + 4 * (unsigned long) readBigEndian<signed int>(payload);
+            break;
+        case TAG_Long_Array:
+            assert(payload + 4 <= bufferEnd);
+            payload += 4 + 8 * (unsigned long) readBigEndian<signed int>(payload);
+            break;
+        case TAG_List: {
+            assert(payload + 5 <= bufferEnd);
+            char listType = payload[0];
+            signed int count = readBigEndian<signed int>(payload + 1);
+            payload += 5;
+
+            // lists of scalars can be skipped in one jump
+            unsigned long elementSize = scalarSize(listType);
+            if (elementSize > 0) {
+                payload += elementSize * (unsigned long) std::max(count, 0);
+                break;
+            }
+
+            for (signed int i = 0; i < count; i++) {
+                payload = skipPayload(listType, payload, bufferEnd);
+            }
+            break;
+        }
+        case TAG_Compound: {
+            while (true) {
+                assert(payload < bufferEnd);
+                char childTagID = *payload;
+                payload++;
+
+                if (childTagID == TAG_End)
+                    break;
+
+                assert(payload + 2 <= bufferEnd);
+                payload += 2 + readBigEndian<unsigned short>(payload);
+                payload = skipPayload(childTagID, payload, bufferEnd);
+            }
+            break;
+        }
+        default:
+            assert(false && "unsupported tag id");
+    }
+
+    assert(payload <= bufferEnd);
+    return payload;
+}
+
+bool NBTView::valid() const {
+    return payload != nullptr;
+}
+
+char NBTView::tagID() const {
+    return tag;
+}
+
+std::string_view NBTView::name() const {
+    return std::string_view(nameBytes, nameLength);
+}
+
+const char *NBTView::payloadBegin() const {
+    return payload;
+}
+
+const char *NBTView::payloadEnd() const {
+    return skipPayload(tag, payload, bufferEnd);
+}
+
+char NBTView::listType() const {
+    assert(tag == TAG_List);
+
+    return payload[0];
+}
+
+signed int NBTView::childrenCount() const {
+    switch (tag) {
+        case TAG_List:
+            return readBigEndian<signed int>(payload + 1);
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array:
+            return readBigEndian<signed int>(payload);
+        case TAG_Compound: {
+            signed int count = 0;
+            for (Iterator it = begin(); it != end(); ++it) {
+                count++;
+            }
+            return count;
+        }
+        default:
+            return 0;
+    }
+}
+
+char NBTView::getByte() const {
+    assert(tag == TAG_Byte);
+
+    return payload[0];
+}
+
+signed short NBTView::getShort() const {
+    assert(tag == TAG_Short);
+
+    return readBigEndian<signed short>(payload);
+}
+
+signed int NBTView::getInt() const {
+    assert(tag == TAG_Int);
+
+    return readBigEndian<signed int>(payload);
+}
+
+signed long NBTView::getLong() const {
+    assert(tag == TAG_Long);
+
+    return readBigEndian<signed long>(payload);
+}
+
+float NBTView::getFloat() const {
+    assert(tag == TAG_Float);
+
+    return readBigEndian<float>(payload);
+}
+
+double NBTView::getDouble() const {
+    assert(tag == TAG_Double);
+
+    return readBigEndian<double>(payload);
+}
+
+std::string_view NBTView::getString() const {
+    assert(tag == TAG_String);
+
+    return std::string_view(payload + 2, readBigEndian<unsigned short>(payload));
+}
+
+const char *NBTView::arrayData() const {
+    assert(tag == TAG_Byte_Array || tag == TAG_Int_Array || tag == TAG_Long_Array);
+
+    return payload + 4;
+}
+
+signed int NBTView::arraySize() const {
+    assert(tag == TAG_Byte_Array || tag == TAG_Int_Array || tag == TAG_Long_Array);
+
+    return readBigEndian<signed int>(payload);
+}
+
+char NBTView::getByteArrayElement(signed int index) const {
+    assert(tag == TAG_Byte_Array);
+    assert(index >= 0 && index < arraySize());
+
+    return arrayData()[index];
+}
+
+signed int NBTView::getIntArrayElement(signed int index) const {
+    assert(tag == TAG_Int_Array);
+    assert(index >= 0 && index < arraySize());
+
+    return readBigEndian<signed int>(arrayData() + 4 * (unsigned long) index);
+}
+
+signed long NBTView::getLongArrayElement(signed int index) const {
+    assert(tag == TAG_Long_Array);
+    assert(index >= 0 && index < arraySize());
+
+    return readBigEndian<signed long>(arrayData() + 8 * (unsigned long) index);
+}
+
+template<typename T>
+static unsigned long copyBigEndianValues(char tagID, const char *payload, char arrayTagID,
+                                         [[maybe_unused]] char elementTagID, T *out, unsigned long count) {
+    const char *values;
+    signed int available;
+
+    if (tagID == arrayTagID) {
+        available = readBigEndian<signed int>(payload);
+        values = payload + 4;
+    } else {
+        assert(tagID == TAG_List);
+        assert(payload[0] == elementTagID || readBigEndian<signed int>(payload + 1) <= 0);
+
+        available = readBigEndian<signed int>(payload + 1);
+        values = payload + 5;
+    }
+
+    count = std::min(count, (unsigned long) std::max(available, 0));
+    readBigEndianArray(values, out, count);
+    return count;
+}
+
+unsigned long NBTView::copyValues(signed short *out, unsigned long count) const {
+    return copyBigEndianValues(tag, payload, TAG_End, TAG_Short, out, count);
+}
+
+unsigned long NBTView::copyValues(signed int *out, unsigned long count) const {
+    return copyBigEndianValues(tag, payload, TAG_Int_Array, TAG_Int, out, count);
+}
+
+unsigned long NBTView::copyValues(signed long *out, unsigned long count) const {
+    return copyBigEndianValues(tag, payload, TAG_Long_Array, TAG_Long, out, count);
+}
+
+unsigned long NBTView::copyValues(float *out, unsigned long count) const {
+    return copyBigEndianValues(tag, payload, TAG_End, TAG_Float, out, count);
+}
+
+unsigned long NBTView::copyValues(double *out, unsigned long count) const {
+    return copyBigEndianValues(tag, payload, TAG_End, TAG_Double, out, count);
+}
+
+bool NBTView::unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count,
+                            PackedLayout layout) const {
+    assert(tag == TAG_Long_Array);
+
+    return ::unpackPalette(arrayData(), std::max(arraySize(), 0), bitsPerEntry, layout, out, count);
+}
+
+NBTView NBTView::operator[](std::string_view childName) const {
+    assert(tag == TAG_Compound);
+
+    for (Iterator it = begin(); it != end(); ++it) {
+        if (it->name() == childName)
+            return *it;
+    }
+
+    return NBTView();
+}
+
+NBTView NBTView::operator[](signed int index) const {
+    if (tag == TAG_Byte_Array || tag == TAG_Int_Array || tag == TAG_Long_Array) {
+        if (index < 0 || index >= arraySize())
+            return NBTView();
+
+        char elementTagID = tag == TAG_Byte_Array ? TAG_Byte : tag == TAG_Int_Array ? TAG_Int : TAG_Long;
+        return NBTView(elementTagID, nullptr, 0, payload + 4 + scalarSize(elementTagID) * (unsigned long) index,
+                       bufferEnd);
+    }
+
+    assert(tag == TAG_List);
+
+    if (index < 0 || index >= childrenCount())
+        return NBTView();
+
+    unsigned long elementSize = scalarSize(listType());
+    if (elementSize > 0) {
+        return NBTView(listType(), nullptr, 0, payload + 5 + elementSize * (unsigned long) index, bufferEnd);
+    }
+
+    Iterator it = begin();
+    for (signed int i = 0; i < index; i++) {
+        ++it;
+    }
+    return *it;
+}
+
+NBTView::Iterator NBTView::begin() const {
+    assert(tag == TAG_List || tag == TAG_Compound);
+
+    Iterator it;
+    it.bufferEnd = bufferEnd;
+    it.parentTagID = tag;
+
+    if (tag == TAG_List) {
+        it.listType = payload[0];
+        it.remaining = readBigEndian<signed int>(payload + 1);
+        it.position = payload + 5;
+    } else {
+        it.position = payload;
+    }
+
+    it.load();
+    return it;
+}
+
+NBTView::Iterator NBTView::end() const {
+    return Iterator();
+}
+
+NBT NBTView::toNBT() const {
+    NBT nbt(tag);
+    if (nameBytes != nullptr)
+        nbt.name = NBTAtom(std::string_view(nameBytes, nameLength));
+
+    switch (tag) {
+        case TAG_List: {
+            nbt.listType = listType();
+            nbt.childrenCount = childrenCount();
+            nbt.listChildren.reserve(std::max(nbt.childrenCount, 0));
+
+            for (const NBTView &child: *this) {
+                nbt.listChildren.push_back(child.toNBT());
+            }
+            break;
+        }
+        case TAG_Compound: {
+            for (const NBTView &child: *this) {
+                nbt.addCompoundChild(child.name(), child.toNBT());
+            }
+            break;
+        }
+        case TAG_String: {
+            std::string_view str = getString();
+            nbt.valueBytes.assign(str.begin(), str.end());
+            break;
+        }
+        case TAG_Byte_Array:
+        case TAG_Int_Array:
+        case TAG_Long_Array:
+            nbt.valueBytes.assign(arrayData(), payloadEnd());
+            break;
+        default:
+            nbt.valueBytes.assign(payload, payloadEnd());
+            break;
+    }
+
+    return nbt;
+}
+
+NBTView::Iterator::Iterator() = default;
+
+const NBTView &NBTView::Iterator::operator*() const {
+    return current;
+}
+
+const NBTView *NBTView::Iterator::operator->() const {
+    return &current;
+}
+
+NBTView::Iterator &NBTView::Iterator::operator++() {
+    assert(current.valid());
+
+    position = skipPayload(current.tag, current.payload, bufferEnd);
+    load();
+    return *this;
+}
+
+bool NBTView::Iterator::operator==(const Iterator &other) const {
+    return current.payload == other.current.payload;
+}
+
+bool NBTView::Iterator::operator!=(const Iterator &other) const {
+    return !(*this == other);
+}
+
+void NBTView::Iterator::load() {
+    if (parentTagID == TAG_List) {
+        if (remaining <= 0) {
+            current = NBTView();
+            return;
+        }
+
+        remaining--;
+        current = NBTView(listType, nullptr, 0, position, bufferEnd);
+        return;
+    }
+
+    assert(position < bufferEnd);
+    char childTagID = *position;
+    if (childTagID == TAG_End) {
+        current = NBTView();
+        return;
+    }
+
+    assert(position + 3 <= bufferEnd);
+    unsigned short childNameLength = readBigEndian<unsigned short>(position + 1);
+    const char *childNameBytes = position + 3;
+    assert(childNameBytes + childNameLength <= bufferEnd);
+
+    current = NBTView(childTagID, childNameBytes, childNameLength, childNameBytes + childNameLength, bufferEnd);
+}
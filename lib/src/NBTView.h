@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cassert>
+#include "NBT.h"
+
+// read-only view of a tag inside an (uncompressed) NBT buffer.
+// nothing gets copied or allocated, so the buffer has to outlive every view made from it
+class NBTView {
+public:
+    class Iterator;
+
+    NBTView();
+
+    // view of the named root tag at the start of the buffer
+    static NBTView root(const char *byteArray, unsigned long byteArraySize);
+
+    static NBTView root(const std::string &buffer);
+
+    // returns a pointer to the first byte after the payload of a tag of type tagID starting at payload
+    static const char *skipPayload(char tagID, const char *payload, const char *bufferEnd);
+
+    bool valid() const;
+
+    char tagID() const;
+
+    std::string_view name() const;
+
+    // pointers to the payload bytes of this tag inside the buffer
+    const char *payloadBegin() const;
+
+    const char *payloadEnd() const;
+
+    char listType() const;
+
+    // number of list children, compound elements or array elements
+    signed int childrenCount() const;
+
+    char getByte() const;
+
+    signed short getShort() const;
+
+    signed int getInt() const;
+
+    signed long getLong() const;
+
+    float getFloat() const;
+
+    double getDouble() const;
+
+    std::string_view getString() const;
+
+    // raw big endian array payload (after the length prefix)
+    const char *arrayData() const;
+
+    signed int arraySize() const;
+
+    char getByteArrayElement(signed int index) const;
+
+    signed int getIntArrayElement(signed int index) const;
+
+    signed long getLongArrayElement(signed int index) const;
+
+    // copy the elements of an Int/Long array, or of a list of shorts/ints/longs/floats/doubles, into out in native
+    // byte order. returns the number of elements copied (at most count)
+    unsigned long copyValues(signed short *out, unsigned long count) const;
+
+    unsigned long copyValues(signed int *out, unsigned long count) const;
+
+    unsigned long copyValues(signed long *out, unsigned long count) const;
+
+    unsigned long copyValues(float *out, unsigned long count) const;
+
+    unsigned long copyValues(double *out, unsigned long count) const;
+
+    // unpack count bit-packed palette indices from a TAG_Long_Array, false if it holds fewer or bitsPerEntry isn't
+    // 1 - 16
+    bool unpackPalette(unsigned int bitsPerEntry, uint16_t *out, unsigned long count,
+                       PackedLayout layout = PackedLayout::PADDED) const;
+
+    // compound lookup, returns an invalid view if there's no element with that name
+    NBTView operator[](std::string_view childName) const;
+
+    // list or array lookup (walks the list, so O(index) unless the elements are scalars).
+    // array elements come back as unnamed TAG_Byte/TAG_Int/TAG_Long views
+    NBTView operator[](signed int index) const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    // copy the viewed subtree into a regular NBT tree
+    NBT toNBT() const;
+
+private:
+    friend class NBTTapeNode;
+
+    char tag = TAG_End;
+    unsigned short nameLength = 0;
+    const char *nameBytes = nullptr;
+    const char *payload = nullptr;
+    const char *bufferEnd = nullptr;
+
+    NBTView(char tagID, const char *nameBytes, unsigned short nameLength, const char *payload, const char *bufferEnd);
+};
+
+class NBTView::Iterator {
+public:
+    Iterator();
+
+    const NBTView &operator*() const;
+
+    const NBTView *operator->() const;
+
+    Iterator &operator++();
+
+    bool operator==(const Iterator &other) const;
+
+    bool operator!=(const Iterator &other) const;
+
+private:
+    friend class NBTView;
+
+    // position of the next list element or named compound element
+    const char *position = nullptr;
+    const char *bufferEnd = nullptr;
+    char parentTagID = TAG_End;
+    char listType = TAG_End;
+    signed int remaining = 0;
+    NBTView current;
+
+    void load();
+};
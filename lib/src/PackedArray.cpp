@@ -0,0 +1,309 @@
+#include <cassert>
+#include <algorithm>
+#include "PackedArray.h"
+#include "ByteSwap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NBT_X86_KERNELS 1
+#endif
+
+// big endian input is converted in blocks of this many longs on the stack
+const unsigned long BLOCK_LONGS = 64;
+
+const unsigned int MAX_BITS_PER_ENTRY = 16;
+
+typedef void (*PaddedKernel)(const uint64_t *longs, unsigned long longCount, uint16_t *out);
+
+// with power of two widths nothing ever straddles two longs, so both layouts are the same
+static bool isPadded(unsigned int bitsPerEntry, PackedLayout layout) {
+    return layout == PackedLayout::PADDED || (bitsPerEntry & (bitsPerEntry - 1)) == 0;
+}
+
+static bool validBitsPerEntry(unsigned int bitsPerEntry) {
+    return bitsPerEntry >= 1 && bitsPerEntry <= MAX_BITS_PER_ENTRY;
+}
+
+static uint64_t entryMask(unsigned int bitsPerEntry) {
+    return (uint64_t(1) << bitsPerEntry) - 1;
+}
+
+unsigned long packedLongCount(unsigned long count, unsigned int bitsPerEntry, PackedLayout layout) {
+    assert(validBitsPerEntry(bitsPerEntry));
+
+    if (isPadded(bitsPerEntry, layout)) {
+        unsigned long perLong = 64 / bitsPerEntry;
+        return (count + perLong - 1) / perLong;
+    }
+    return (count * bitsPerEntry + 63) / 64;
+}
+
+// unpacks all 64 / Bits entries of each long, with the shifts and mask known at compile time
+template<unsigned int Bits>
+static void unpackPaddedScalar(const uint64_t *longs, unsigned long longCount, uint16_t *out) {
+    constexpr unsigned int perLong = 64 / Bits;
+    constexpr uint64_t mask = (uint64_t(1) << Bits) - 1;
+
+    for (unsigned long i = 0; i < longCount; i++) {
+        uint64_t value = longs[i];
+        for (unsigned int j = 0; j < perLong; j++) {
+            out[j] = (uint16_t) ((value >> (j * Bits)) & mask);
+        }
+        out += perLong;
+    }
+}
+
+#ifdef __SSE2__
+
+// 4 and 8 bit entries fill whole bytes, so on a little endian host the longs are just a nibble/byte stream
+static void unpackPadded4SSE2(const uint64_t *longs, unsigned long longCount, uint16_t *out) {
+    const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    unsigned long i = 0;
+
+    for (; i + 2 <= longCount; i += 2) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(longs + i));
+        __m128i low = _mm_and_si128(bytes, lowNibbles);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibbles);
+
+        // entry 2k is the low nibble of byte k, entry 2k + 1 the high one
+        __m128i first = _mm_unpacklo_epi8(low, high);
+        __m128i second = _mm_unpackhi_epi8(low, high);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(first, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(first, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), _mm_unpacklo_epi8(second, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 24), _mm_unpackhi_epi8(second, zero));
+        out += 32;
+    }
+
+    unpackPaddedScalar<4>(longs + i, longCount - i, out);
+}
+
+static void unpackPadded8SSE2(const uint64_t *longs, unsigned long longCount, uint16_t *out) {
+    const __m128i zero = _mm_setzero_si128();
+    unsigned long i = 0;
+
+    for (; i + 2 <= longCount; i += 2) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(longs + i));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+        out += 16;
+    }
+
+    unpackPaddedScalar<8>(longs + i, longCount - i, out);
+}
+
+#endif
+
+#ifdef NBT_X86_KERNELS
+
+static bool hasAVX2() {
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return supported;
+}
+
+// every long is broadcast and shifted by a different amount per lane (vpsrlvq), 8 entries per store.
+// the last store of a long may run past its entries, that garbage is overwritten by the next long, which is why
+// the final long goes through the scalar kernel
+template<unsigned int Bits>
+__attribute__((target("avx2")))
+static void unpackPaddedAVX2(const uint64_t *longs, unsigned long longCount, uint16_t *out) {
+    constexpr unsigned int perLong = 64 / Bits;
+    constexpr unsigned int groups = (perLong + 7) / 8;
+
+    if (longCount == 0)
+        return;
+
+    const __m256i mask = _mm256_set1_epi64x((long long) entryMask(Bits));
+    const __m256i lowDwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    __m256i shifts[2 * groups];
+    for (unsigned int g = 0; g < 2 * groups; g++) {
+        // shifts of 64 and more yield 0
+        shifts[g] = _mm256_setr_epi64x(Bits * (4 * g), Bits * (4 * g + 1), Bits * (4 * g + 2), Bits * (4 * g + 3));
+    }
+
+    unsigned long i = 0;
+    for (; i + 1 < longCount; i++) {
+        __m256i value = _mm256_set1_epi64x((long long) longs[i]);
+
+        for (unsigned int g = 0; g < groups; g++) {
+            __m256i first = _mm256_and_si256(_mm256_srlv_epi64(value, shifts[2 * g]), mask);
+            __m256i second = _mm256_and_si256(_mm256_srlv_epi64(value, shifts[2 * g + 1]), mask);
+
+            // low dword of each lane, then 32 -> 16 bit
+            __m128i firstDwords = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(first, lowDwords));
+            __m128i secondDwords = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(second, lowDwords));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8 * g), _mm_packus_epi32(firstDwords, secondDwords));
+        }
+        out += perLong;
+    }
+
+    unpackPaddedScalar<Bits>(longs + i, longCount - i, out);
+}
+
+#endif
+
+template<unsigned int Bits>
+static PaddedKernel selectPaddedKernel() {
+#ifdef __SSE2__
+    if (Bits == 4)
+        return unpackPadded4SSE2;
+    if (Bits == 8)
+        return unpackPadded8SSE2;
+#endif
+#ifdef NBT_X86_KERNELS
+    // 16 bit entries are a plain copy, nothing to win there
+    if (Bits < 16 && hasAVX2())
+        return unpackPaddedAVX2<Bits>;
+#endif
+    return unpackPaddedScalar<Bits>;
+}
+
+template<unsigned int Bits = 1>
+static PaddedKernel paddedKernel(unsigned int bitsPerEntry) {
+    if constexpr (Bits > MAX_BITS_PER_ENTRY) {
+        return nullptr;
+    } else {
+        if (bitsPerEntry == Bits)
+            return selectPaddedKernel<Bits>();
+        return paddedKernel<Bits + 1>(bitsPerEntry);
+    }
+}
+
+static void unpackSpanningScalar(const uint64_t *longs, unsigned int bitsPerEntry, uint16_t *out,
+                                 unsigned long count) {
+    const uint64_t mask = entryMask(bitsPerEntry);
+
+    for (unsigned long i = 0; i < count; i++) {
+        unsigned long bit = i * bitsPerEntry;
+        unsigned long index = bit / 64;
+        unsigned int shift = bit % 64;
+
+        uint64_t value = longs[index] >> shift;
+        if (shift + bitsPerEntry > 64)
+            value |= longs[index + 1] << (64 - shift);
+
+        out[i] = (uint16_t) (value & mask);
+    }
+}
+
+static void unpackNative(const uint64_t *longs, unsigned int bitsPerEntry, PackedLayout layout, uint16_t *out,
+                         unsigned long count) {
+    if (!isPadded(bitsPerEntry, layout)) {
+        unpackSpanningScalar(longs, bitsPerEntry, out, count);
+        return;
+    }
+
+    unsigned int perLong = 64 / bitsPerEntry;
+    unsigned long fullLongs = count / perLong;
+    paddedKernel(bitsPerEntry)(longs, fullLongs, out);
+
+    // partially used last long
+    const uint64_t mask = entryMask(bitsPerEntry);
+    for (unsigned long i = fullLongs * perLong, shift = 0; i < count; i++, shift += bitsPerEntry) {
+        out[i] = (uint16_t) ((longs[fullLongs] >> shift) & mask);
+    }
+}
+
+// blocks have to start on an entry boundary: padded blocks hold whole longs, spanning blocks a multiple of
+// bitsPerEntry longs (= 64 entries)
+static void blockSize(unsigned int bitsPerEntry, PackedLayout layout, unsigned long &blockLongs,
+                      unsigned long &blockEntries) {
+    if (isPadded(bitsPerEntry, layout)) {
+        blockLongs = BLOCK_LONGS;
+        blockEntries = BLOCK_LONGS * (64 / bitsPerEntry);
+    } else {
+        blockLongs = bitsPerEntry * (BLOCK_LONGS / MAX_BITS_PER_ENTRY);
+        blockEntries = 64 * (BLOCK_LONGS / MAX_BITS_PER_ENTRY);
+    }
+}
+
+bool unpackPalette(const char *bigEndianLongs, unsigned long longCount, unsigned int bitsPerEntry,
+                   PackedLayout layout, uint16_t *out, unsigned long count) {
+    if (!validBitsPerEntry(bitsPerEntry) || longCount < packedLongCount(count, bitsPerEntry, layout))
+        return false;
+
+    unsigned long blockLongs, blockEntries;
+    blockSize(bitsPerEntry, layout, blockLongs, blockEntries);
+
+    uint64_t block[BLOCK_LONGS];
+    unsigned long firstLong = 0;
+    for (unsigned long done = 0; done < count; done += blockEntries, firstLong += blockLongs) {
+        unsigned long entries = std::min(blockEntries, count - done);
+
+        byteSwapArray64(bigEndianLongs + 8 * firstLong, reinterpret_cast<char *>(block),
+                        packedLongCount(entries, bitsPerEntry, layout));
+        unpackNative(block, bitsPerEntry, layout, out + done, entries);
+    }
+
+    return true;
+}
+
+bool unpackPalette(const signed long *longs, unsigned long longCount, unsigned int bitsPerEntry,
+                   PackedLayout layout, uint16_t *out, unsigned long count) {
+    static_assert(sizeof(signed long) == sizeof(uint64_t), "longs are expected to be 64 bit");
+
+    if (!validBitsPerEntry(bitsPerEntry) || longCount < packedLongCount(count, bitsPerEntry, layout))
+        return false;
+
+    unpackNative(reinterpret_cast<const uint64_t *>(longs), bitsPerEntry, layout, out, count);
+    return true;
+}
+
+static void packNative(const uint16_t *entries, unsigned long count, unsigned int bitsPerEntry, PackedLayout layout,
+                       uint64_t *longs) {
+    const uint64_t mask = entryMask(bitsPerEntry);
+    unsigned long longCount = packedLongCount(count, bitsPerEntry, layout);
+
+    std::fill(longs, longs + longCount, 0);
+
+    if (isPadded(bitsPerEntry, layout)) {
+        unsigned int perLong = 64 / bitsPerEntry;
+
+        for (unsigned long i = 0; i < longCount; i++) {
+            unsigned long first = i * perLong;
+            unsigned long last = std::min(first + perLong, count);
+
+            uint64_t value = 0;
+            for (unsigned long e = first, shift = 0; e < last; e++, shift += bitsPerEntry) {
+                value |= (entries[e] & mask) << shift;
+            }
+            longs[i] = value;
+        }
+        return;
+    }
+
+    for (unsigned long i = 0; i < count; i++) {
+        unsigned long bit = i * bitsPerEntry;
+        unsigned long index = bit / 64;
+        unsigned int shift = bit % 64;
+        uint64_t value = entries[i] & mask;
+
+        longs[index] |= value << shift;
+        if (shift + bitsPerEntry > 64)
+            longs[index + 1] |= value >> (64 - shift);
+    }
+}
+
+bool packPalette(const uint16_t *entries, unsigned long count, unsigned int bitsPerEntry, PackedLayout layout,
+                 char *bigEndianLongs) {
+    if (!validBitsPerEntry(bitsPerEntry))
+        return false;
+
+    unsigned long blockLongs, blockEntries;
+    blockSize(bitsPerEntry, layout, blockLongs, blockEntries);
+
+    uint64_t block[BLOCK_LONGS];
+    unsigned long firstLong = 0;
+    for (unsigned long done = 0; done < count; done += blockEntries, firstLong += blockLongs) {
+        unsigned long blockCount = std::min(blockEntries, count - done);
+        unsigned long longCount = packedLongCount(blockCount, bitsPerEntry, layout);
+
+        packNative(entries + done, blockCount, bitsPerEntry, layout, block);
+        byteSwapArray64(reinterpret_cast<const char *>(block), bigEndianLongs + 8 * firstLong, longCount);
+    }
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// how entries (block state / biome palette indices, heightmaps) are bit-packed into the longs of a TAG_Long_Array.
+// both layouts fill every long starting at its least significant bit
+enum class PackedLayout {
+    // 1.16+: entries never straddle two longs, the leftover high bits of each long stay unused
+    PADDED,
+    // before 1.16: one continuous bit stream, entries may straddle two longs
+    SPANNING
+};
+
+// number of longs needed for count entries of bitsPerEntry (1 - 16) bits. the functions below return false for
+// any other width
+unsigned long packedLongCount(unsigned long count, unsigned int bitsPerEntry, PackedLayout layout);
+
+// unpack count entries from longCount big endian longs (e.g. a TAG_Long_Array payload).
+// returns false if the longs are too short to hold count entries
+bool unpackPalette(const char *bigEndianLongs, unsigned long longCount, unsigned int bitsPerEntry,
+                   PackedLayout layout, uint16_t *out, unsigned long count);
+
+// same for longs that are already in native order (NBTNode, getLongVector)
+bool unpackPalette(const signed long *longs, unsigned long longCount, unsigned int bitsPerEntry,
+                   PackedLayout layout, uint16_t *out, unsigned long count);
+
+// pack count entries into packedLongCount() big endian longs. entries are cut to bitsPerEntry bits and unused bits
+// are zeroed
+bool packPalette(const uint16_t *entries, unsigned long count, unsigned int bitsPerEntry, PackedLayout layout,
+                 char *bigEndianLongs);
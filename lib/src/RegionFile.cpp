@@ -0,0 +1,316 @@
+#include <ctime>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "RegionFile.h"
+#include "ThreadPool.h"
+#include "Compression.h"
+#include "BigEndian.h"
+
+const unsigned long HEADER_SIZE = 2 * RegionFile::SECTOR_SIZE;
+
+const unsigned long MAX_SECTORS_PER_CHUNK = 255;
+
+RegionFile::RegionFile() = default;
+
+bool RegionFile::open(const std::string &path, bool writable) {
+    this->writable = writable;
+
+    if (writable) {
+        // new regions start out as an empty header
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return false;
+
+        off_t fileSize = lseek(fd, 0, SEEK_END);
+        bool ok = fileSize >= (off_t) HEADER_SIZE || ftruncate(fd, HEADER_SIZE) == 0;
+        ::close(fd);
+
+        if (!ok)
+            return false;
+    }
+
+    if (!file.open(path, writable))
+        return false;
+
+    if (file.size() < HEADER_SIZE) {
+        file.close();
+        return false;
+    }
+
+    buildSectorMap();
+    return true;
+}
+
+void RegionFile::close() {
+    file.close();
+    usedSectors.clear();
+}
+
+bool RegionFile::isOpen() const {
+    return file.isOpen();
+}
+
+int RegionFile::chunkIndex(int x, int z) {
+    assert(x >= 0 && x < CHUNKS_PER_SIDE && z >= 0 && z < CHUNKS_PER_SIDE);
+
+    return x + z * CHUNKS_PER_SIDE;
+}
+
+unsigned int RegionFile::getLocation(int x, int z) const {
+    assert(isOpen());
+
+    return readBigEndian<unsigned int>(file.data() + 4 * chunkIndex(x, z));
+}
+
+bool RegionFile::hasChunk(int x, int z) const {
+    unsigned int location = getLocation(x, z);
+    return (location >> 8) != 0 && (location & 0xFF) != 0;
+}
+
+unsigned int RegionFile::getTimestamp(int x, int z) const {
+    assert(isOpen());
+
+    return readBigEndian<unsigned int>(file.data() + SECTOR_SIZE + 4 * chunkIndex(x, z));
+}
+
+bool RegionFile::readChunkBytes(int x, int z, std::string &out) const {
+    unsigned int location = getLocation(x, z);
+    unsigned long sectorOffset = location >> 8;
+    unsigned long sectorCount = location & 0xFF;
+
+    if (sectorOffset < 2 || sectorCount == 0)
+        return false;
+
+    unsigned long start = sectorOffset * SECTOR_SIZE;
+    if (start + 5 > file.size())
+        return false;
+
+    // length counts the compression byte too
+    unsigned long length = readBigEndian<unsigned int>(file.data() + start);
+    if (length == 0 || start + 4 + length > file.size())
+        return false;
+
+    const char *payload = file.data() + start + 5;
+    unsigned long payloadSize = length - 1;
+
+    // the high bit marks chunks too big for the region that live in a separate c.x.z.mcc file
+    switch (file.data()[start + 4]) {
+        case COMPRESSION_GZIP:
+            return decompressBuffer(payload, payloadSize, CompressionFormat::GZIP, out);
+        case COMPRESSION_ZLIB:
+            return decompressBuffer(payload, payloadSize, CompressionFormat::ZLIB, out);
+        case COMPRESSION_NONE:
+            return decompressBuffer(payload, payloadSize, CompressionFormat::NONE, out);
+        default:
+            return false;
+    }
+}
+
+std::optional<NBT> RegionFile::readChunk(int x, int z) const {
+    std::string inflated;
+    if (!readChunkBytes(x, z, inflated) || inflated.empty() || inflated[0] != TAG_Compound)
+        return std::nullopt;
+
+    return NBT::deserialize(inflated.data(), inflated.size());
+}
+
+void RegionFile::forEachChunkBytes(ThreadPool &pool,
+                                   const std::function<void(int, int, const char *, unsigned long)> &callback) const {
+    std::vector<int> presentChunks;
+    for (int index = 0; index < CHUNK_COUNT; index++) {
+        if (hasChunk(index % CHUNKS_PER_SIDE, index / CHUNKS_PER_SIDE))
+            presentChunks.push_back(index);
+    }
+
+    pool.parallelFor(presentChunks.size(), 1, [&](unsigned long begin, unsigned long end) {
+        // one inflate buffer per thread, reused across chunks and calls
+        thread_local std::string inflated;
+
+        for (unsigned long i = begin; i < end; i++) {
+            int x = presentChunks[i] % CHUNKS_PER_SIDE;
+            int z = presentChunks[i] / CHUNKS_PER_SIDE;
+
+            if (readChunkBytes(x, z, inflated))
+                callback(x, z, inflated.data(), inflated.size());
+        }
+    });
+}
+
+void RegionFile::forEachChunk(ThreadPool &pool, const std::function<void(int, int, NBT &)> &callback) const {
+    forEachChunkBytes(pool, [&callback](int x, int z, const char *bytes, unsigned long size) {
+        if (size == 0 || bytes[0] != TAG_Compound)
+            return;
+
+        NBT chunk = NBT::deserialize(bytes, size);
+        callback(x, z, chunk);
+    });
+}
+
+void RegionFile::buildSectorMap() {
+    usedSectors.assign((file.size() + SECTOR_SIZE - 1) / SECTOR_SIZE, false);
+    markSectors(0, HEADER_SIZE / SECTOR_SIZE, true);
+
+    for (int index = 0; index < CHUNK_COUNT; index++) {
+        unsigned int location = getLocation(index % CHUNKS_PER_SIDE, index / CHUNKS_PER_SIDE);
+        unsigned long sectorOffset = location >> 8;
+        unsigned long count = location & 0xFF;
+
+        if (sectorOffset >= 2 && count > 0)
+            markSectors(sectorOffset, count, true);
+    }
+}
+
+void RegionFile::markSectors(unsigned long sectorOffset, unsigned long count, bool used) {
+    if (sectorOffset + count > usedSectors.size())
+        usedSectors.resize(sectorOffset + count, false);
+
+    std::fill(usedSectors.begin() + (long) sectorOffset, usedSectors.begin() + (long) (sectorOffset + count), used);
+}
+
+unsigned long RegionFile::findFreeSectors(unsigned long count) const {
+    unsigned long runStart = 0;
+    unsigned long runLength = 0;
+
+    for (unsigned long sector = 0; sector < usedSectors.size(); sector++) {
+        if (usedSectors[sector]) {
+            runLength = 0;
+            continue;
+        }
+
+        if (runLength == 0)
+            runStart = sector;
+        runLength++;
+
+        if (runLength == count)
+            return runStart;
+    }
+
+    // a free run at the very end can be extended by growing the file
+    return runLength > 0 ? runStart : usedSectors.size();
+}
+
+static bool writeFully(int fd, const char *bytes, unsigned long size, unsigned long offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, (off_t) offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool RegionFile::writeHeaderEntry(int x, int z, unsigned int location, unsigned int timestamp) {
+    // each entry is a single aligned 4 byte write, so readers see either the old or the new value. the location
+    // goes last, it's what publishes the change, and the old timestamp is put back if it can't be written
+    char entry[4];
+    int index = chunkIndex(x, z);
+    unsigned int oldTimestamp = getTimestamp(x, z);
+
+    writeBigEndian(entry, timestamp);
+    if (!writeFully(file.fileDescriptor(), entry, 4, SECTOR_SIZE + 4ul * index))
+        return false;
+
+    writeBigEndian(entry, location);
+    if (writeFully(file.fileDescriptor(), entry, 4, 4ul * index))
+        return true;
+
+    writeBigEndian(entry, oldTimestamp);
+    writeFully(file.fileDescriptor(), entry, 4, SECTOR_SIZE + 4ul * index);
+    return false;
+}
+
+bool RegionFile::writeChunk(int x, int z, NBT &chunk, char compression, unsigned int timestamp) {
+    std::vector<char> serialized = NBT::serialize(chunk);
+
+    std::string payload;
+    CompressionFormat format = compression == COMPRESSION_GZIP ? CompressionFormat::GZIP :
+                               compression == COMPRESSION_ZLIB ? CompressionFormat::ZLIB : CompressionFormat::NONE;
+    if (!compressBuffer(serialized.data(), serialized.size(), format, payload))
+        return false;
+
+    return writeChunkBytes(x, z, payload.data(), payload.size(), compression, timestamp);
+}
+
+bool RegionFile::writeChunkBytes(int x, int z, const char *payload, unsigned long payloadSize, char compression,
+                                 unsigned int timestamp) {
+    assert(writable);
+
+    // 4 byte length + compression byte, padded to whole sectors
+    unsigned long neededSectors = (5 + payloadSize + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (neededSectors > MAX_SECTORS_PER_CHUNK)
+        return false;
+
+    unsigned int oldLocation = getLocation(x, z);
+    unsigned long oldOffset = oldLocation >> 8;
+    unsigned long oldCount = oldLocation & 0xFF;
+    bool hadChunk = oldOffset >= 2 && oldCount > 0;
+
+    unsigned long newOffset;
+    if (hadChunk && neededSectors <= oldCount) {
+        newOffset = oldOffset;
+    } else {
+        newOffset = findFreeSectors(neededSectors);
+    }
+
+    std::vector<char> sectors(neededSectors * SECTOR_SIZE, 0);
+    writeBigEndian(sectors.data(), (unsigned int) (payloadSize + 1));
+    sectors[4] = compression;
+    std::copy(payload, payload + payloadSize, sectors.begin() + 5);
+
+    if (!writeFully(file.fileDescriptor(), sectors.data(), sectors.size(), newOffset * SECTOR_SIZE))
+        return false;
+
+    if (syncOnWrite && fdatasync(file.fileDescriptor()) != 0)
+        return false;
+
+    // pwrite past the end grew the file, the mapping has to follow before the header can point there. until the
+    // header entry is written, a failure leaves nothing but unreferenced sectors behind
+    if ((newOffset + neededSectors) * SECTOR_SIZE > file.size() && !file.remap())
+        return false;
+
+    if (timestamp == 0)
+        timestamp = (unsigned int) std::time(nullptr);
+
+    if (!writeHeaderEntry(x, z, (unsigned int) ((newOffset << 8) | neededSectors), timestamp))
+        return false;
+
+    // the old sectors only become reusable once nothing points at them anymore
+    if (hadChunk)
+        markSectors(oldOffset, oldCount, false);
+    markSectors(newOffset, neededSectors, true);
+
+    return true;
+}
+
+bool RegionFile::removeChunk(int x, int z) {
+    assert(writable);
+
+    unsigned int location = getLocation(x, z);
+    if (!writeHeaderEntry(x, z, 0, 0))
+        return false;
+
+    if ((location >> 8) >= 2 && (location & 0xFF) > 0)
+        markSectors(location >> 8, location & 0xFF, false);
+
+    return true;
+}
+
+void RegionFile::setSyncOnWrite(bool sync) {
+    syncOnWrite = sync;
+}
+
+unsigned long RegionFile::sectorCount() const {
+    return (file.size() + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+unsigned long RegionFile::freeSectorCount() const {
+    return std::count(usedSectors.begin(), usedSectors.begin() + (long) std::min(usedSectors.size(), sectorCount()),
+                      false);
+}
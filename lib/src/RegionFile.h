@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+#include "NBT.h"
+#include "MappedFile.h"
+
+class ThreadPool;
+
+// Anvil region file (.mca): a 4 KiB location table and a 4 KiB timestamp table, followed by compressed chunk NBT
+// stored in 4 KiB sectors. the file is memory mapped and chunks are only decoded when asked for.
+// chunk coordinates are local to the region (0-31).
+// a region opened for writing can replace single chunks in place; writes must not overlap with reads from
+// other threads
+class RegionFile {
+public:
+    static const int CHUNKS_PER_SIDE = 32;
+    static const int CHUNK_COUNT = CHUNKS_PER_SIDE * CHUNKS_PER_SIDE;
+    static const unsigned long SECTOR_SIZE = 4096;
+
+    // compression byte in front of every chunk payload
+    static const char COMPRESSION_GZIP = 1;
+    static const char COMPRESSION_ZLIB = 2;
+    static const char COMPRESSION_NONE = 3;
+
+    RegionFile();
+
+    // writable creates the file if it doesn't exist yet
+    bool open(const std::string &path, bool writable = false);
+
+    void close();
+
+    bool isOpen() const;
+
+    bool hasChunk(int x, int z) const;
+
+    // last modification time of the chunk in epoch seconds, 0 if it was never written
+    unsigned int getTimestamp(int x, int z) const;
+
+    // inflate the chunk's NBT into out (whose capacity is reused). false if the chunk is missing, stored
+    // externally (.mcc), uses an unsupported compression or is corrupt
+    bool readChunkBytes(int x, int z, std::string &out) const;
+
+    std::optional<NBT> readChunk(int x, int z) const;
+
+    // decode every present chunk on the pool. callbacks run concurrently on the worker threads
+    // (and the calling thread), each with its own reused inflate buffer
+    void forEachChunkBytes(ThreadPool &pool,
+                           const std::function<void(int x, int z, const char *bytes, unsigned long size)> &callback) const;
+
+    void forEachChunk(ThreadPool &pool, const std::function<void(int x, int z, NBT &chunk)> &callback) const;
+
+    // serialize and compress the chunk, then store it with writeChunkBytes
+    bool writeChunk(int x, int z, NBT &chunk, char compression = COMPRESSION_ZLIB, unsigned int timestamp = 0);
+
+    // store an already compressed chunk payload. it's written over the old sectors when it fits, otherwise into
+    // the first free run of sectors (or appended). the location entry is only updated once the data is written
+    // and the old sectors are only reused after that, so a relocated chunk survives a crash either old or new.
+    // when false is returned the header entry and the sector map are unchanged. timestamp 0 means now
+    bool writeChunkBytes(int x, int z, const char *payload, unsigned long payloadSize, char compression,
+                         unsigned int timestamp = 0);
+
+    bool removeChunk(int x, int z);
+
+    // fdatasync between writing chunk data and publishing it in the header
+    void setSyncOnWrite(bool sync);
+
+    // number of sectors the file currently spans, including the header and free sectors
+    unsigned long sectorCount() const;
+
+    unsigned long freeSectorCount() const;
+
+private:
+    MappedFile file;
+    bool writable = false;
+    bool syncOnWrite = false;
+
+    // one entry per sector of the file, true if the header or a chunk uses it
+    std::vector<bool> usedSectors{};
+
+    static int chunkIndex(int x, int z);
+
+    unsigned int getLocation(int x, int z) const;
+
+    void buildSectorMap();
+
+    void markSectors(unsigned long sectorOffset, unsigned long count, bool used);
+
+    // first run of count free sectors, past the end of the file if there's none
+    unsigned long findFreeSectors(unsigned long count) const;
+
+    bool writeHeaderEntry(int x, int z, unsigned int location, unsigned int timestamp);
+};
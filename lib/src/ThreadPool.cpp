@@ -0,0 +1,125 @@
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty())
+                return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(unsigned long count, unsigned long grainSize,
+                             const std::function<void(unsigned long, unsigned long)> &body) {
+    if (count == 0)
+        return;
+
+    grainSize = std::max(grainSize, 1ul);
+    unsigned long blockCount = (count + grainSize - 1) / grainSize;
+
+    // shared with the helper tasks, which may only get to run after this call has returned
+    struct State {
+        std::atomic<unsigned long> nextBlock{0};
+        unsigned long finishedBlocks = 0;
+        std::mutex mutex;
+        std::condition_variable allFinished;
+
+        // first exception thrown by body, the blocks after it are skipped but still count as finished
+        std::atomic<bool> failed{false};
+        std::exception_ptr error{};
+    };
+    auto state = std::make_shared<State>();
+
+    auto runBlocks = [state, count, grainSize, blockCount, &body]() {
+        unsigned long finished = 0;
+
+        while (true) {
+            unsigned long block = state->nextBlock.fetch_add(1);
+            if (block >= blockCount)
+                break;
+
+            if (!state->failed.load(std::memory_order_relaxed)) {
+                unsigned long begin = block * grainSize;
+                try {
+                    body(begin, std::min(begin + grainSize, count));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->error)
+                        state->error = std::current_exception();
+                    state->failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            finished++;
+        }
+
+        if (finished == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->finishedBlocks += finished;
+        if (state->finishedBlocks == blockCount)
+            state->allFinished.notify_all();
+    };
+
+    // body is only touched while blocks are left, and the caller waits for all of them, so capturing it by
+    // reference is fine even for helpers that start late
+    unsigned long helpers = std::min<unsigned long>(workers.size(), blockCount - 1);
+    for (unsigned long i = 0; i < helpers; i++) {
+        enqueue(runBlocks);
+    }
+
+    runBlocks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->allFinished.wait(lock, [&state, blockCount]() { return state->finishedBlocks == blockCount; });
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+unsigned int ThreadPool::size() const {
+    return workers.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool {
+public:
+    // 0 means one thread per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    // finishes the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template<typename Function>
+    std::future<typename std::invoke_result<Function>::type> submit(Function function) {
+        using Result = typename std::invoke_result<Function>::type;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+        std::future<Result> result = task->get_future();
+
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // runs body(begin, end) over [0, count) in blocks of grainSize and blocks until everything is done.
+    // the calling thread works on blocks too, so this is safe to call from inside a pool task. if body throws, the
+    // blocks nobody started yet are skipped and the first exception is rethrown here once the others are done
+    void parallelFor(unsigned long count, unsigned long grainSize,
+                     const std::function<void(unsigned long begin, unsigned long end)> &body);
+
+    unsigned int size() const;
+
+private:
+    std::vector<std::thread> workers{};
+    std::deque<std::function<void()>> tasks{};
+    std::mutex mutex{};
+    std::condition_variable taskAvailable{};
+    bool stopping = false;
+
+    void enqueue(std::function<void()> task);
+
+    void workerLoop();
+};
@@ -0,0 +1,32 @@
+// behavior tests for the NBeeTea library, registered with TEST() in test/*.cpp.
+//
+// usage: NBeeTeaTest [filter]
+// only tests whose name contains filter run. exits non-zero if any CHECK failed
+
+#include <cstring>
+#include "Test.h"
+
+std::vector<TestCase> &testRegistry() {
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+unsigned long testFailures = 0;
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : "";
+
+    unsigned long run = 0;
+    for (const TestCase &test: testRegistry()) {
+        if (std::strstr(test.name, filter) == nullptr)
+            continue;
+
+        unsigned long failuresBefore = testFailures;
+        test.run();
+        run++;
+        std::cout << (testFailures == failuresBefore ? "ok   " : "FAIL ") << test.name << std::endl;
+    }
+
+    std::cout << run << " tests, " << testFailures << " failed checks" << std::endl;
+    return testFailures == 0 ? 0 : 1;
+}
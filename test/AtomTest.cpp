@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "NBT.h"
+
+TEST(atomTableIsBounded) {
+    // fill the table with long names until it stops taking new ones
+    std::string name(60000, 'a');
+    std::vector<NBTAtom> atoms;
+    for (unsigned long i = 0; i < NBTAtom::MAX_INTERNED_BYTES / name.size() + 2; i++) {
+        name.replace(0, 20, std::to_string(i + 100000000000000000ul));
+        atoms.emplace_back(name);
+    }
+    CHECK(!atoms.back().interned());
+    unsigned long interned = NBTAtom::internedCount();
+
+    // a peer sending fresh names doesn't grow it anymore, and names that don't fit still behave like atoms
+    for (unsigned long i = 0; i < 1000; i++) {
+        NBTAtom fresh("fresh name " + std::to_string(i));
+        NBTAtom again("fresh name " + std::to_string(i));
+        CHECK(!fresh.interned());
+        CHECK(fresh == again);
+        CHECK(fresh.hash() == again.hash());
+        CHECK(fresh != NBTAtom("fresh name"));
+    }
+    CHECK(NBTAtom::internedCount() == interned);
+
+    // found in compounds below and above the index threshold
+    for (unsigned long size: {4ul, 100ul}) {
+        NBT compound(TAG_Compound);
+        for (unsigned long i = 0; i < size; i++) {
+            compound.addCompoundChild("key " + std::to_string(i), NBT(TAG_Int, (signed int) i));
+        }
+        for (unsigned long i = 0; i < size; i++) {
+            CHECK(compound.compoundElements.at("key " + std::to_string(i)).getInt() == (signed int) i);
+        }
+
+        bool found;
+        NBTAtom key = NBTAtom::find("key 3", found);
+        CHECK(found);
+        CHECK(compound.compoundElements.count(key) == 1);
+        CHECK(compound.compoundElements.count("key 3 ") == 0);
+
+        std::vector<char> bytes = NBT::serialize(compound);
+        NBT back = NBT::deserialize(bytes.data(), bytes.size());
+        CHECK(NBT::serialize(back) == bytes);
+    }
+}
+
+TEST(interningIsStable) {
+    NBTAtom a("Pos");
+    NBTAtom b(std::string("Pos"));
+    CHECK(a == b);
+    CHECK(a == "Pos");
+    CHECK(a != NBTAtom("pos"));
+    CHECK(NBTAtom().empty());
+
+    NBTAtom moved(std::move(b));
+    CHECK(moved == a);
+}
+
+// also run on its own (see CMakeLists.txt), so the table overflows before the process made its first default atom
+TEST(emptyAtomAfterOverflow) {
+    std::vector<NBTAtom> atoms;
+    for (unsigned long i = 0; i < NBTAtom::MAX_INTERNED_NAMES + 10; i++) {
+        atoms.emplace_back("overflow " + std::to_string(i));
+    }
+    CHECK(!atoms.back().interned());
+
+    std::vector<NBTAtom> empties;
+    for (int i = 0; i < 3; i++) {
+        NBTAtom empty;
+        NBTAtom moved(std::move(empty));
+        empties.push_back(moved);
+        empties.push_back(NBTAtom());
+    }
+    empties.clear();
+
+    NBTAtom empty;
+    CHECK(empty.interned());
+    CHECK(empty == NBTAtom(""));
+    CHECK(empty.size() == 0);
+}
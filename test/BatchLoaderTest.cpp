@@ -0,0 +1,94 @@
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTBatchLoader.h"
+#include "ThreadPool.h"
+
+// every third buffer gzip'd, every seventh a truncated gzip
+static std::vector<std::string> batchBuffers(signed int count) {
+    std::vector<std::string> buffers;
+    for (signed int i = 0; i < count; i++) {
+        NBT root(TAG_Compound);
+        root.emplaceCompoundChild("index", TAG_Int).writeVal(i);
+        std::vector<char> bytes = NBT::serialize(root, i % 3 == 0 || i % 7 == 6);
+        if (i % 7 == 6)
+            bytes.resize(bytes.size() / 2);
+        buffers.emplace_back(bytes.data(), bytes.size());
+    }
+    return buffers;
+}
+
+static bool expectedTree(unsigned long index, std::optional<NBT> &tree) {
+    if (index % 7 == 6)
+        return !tree.has_value();
+    return tree.has_value() && tree->compoundElements.at("index").getInt() == (signed int) index;
+}
+
+TEST(batchLoaderDeliversEveryBuffer) {
+    ThreadPool pool(4);
+    std::vector<std::string> buffers = batchBuffers(200);
+    std::vector<std::string_view> views(buffers.begin(), buffers.end());
+
+    for (bool ordered: {false, true}) {
+        NBTBatchOptions options;
+        options.ordered = ordered;
+        options.maxInFlight = ordered ? 3 : 0;
+        NBTBatchLoader loader(pool, options);
+
+        std::mutex mutex;
+        std::vector<unsigned long> order;
+        bool allExpected = true;
+        loader.loadBuffers(views, [&](unsigned long index, std::optional<NBT> &tree) {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(index);
+            allExpected &= expectedTree(index, tree);
+        });
+
+        CHECK(allExpected);
+        CHECK(order.size() == views.size());
+        if (ordered) {
+            bool inOrder = true;
+            for (unsigned long i = 0; i < order.size(); i++) {
+                inOrder &= order[i] == i;
+            }
+            CHECK(inOrder);
+        }
+    }
+}
+
+TEST(batchLoaderRethrowsCallbackExceptions) {
+    ThreadPool pool(4);
+    std::vector<std::string> buffers = batchBuffers(100);
+    std::vector<std::string_view> views(buffers.begin(), buffers.end());
+
+    for (bool ordered: {false, true}) {
+        NBTBatchOptions options;
+        options.ordered = ordered;
+        options.maxInFlight = 4;
+        NBTBatchLoader loader(pool, options);
+
+        std::atomic<unsigned long> delivered{0};
+        bool caught = false;
+        try {
+            loader.loadBuffers(views, [&](unsigned long index, std::optional<NBT> &) {
+                // give the other workers time to fill the window and block on it
+                if (index == 3) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    throw std::runtime_error("callback failed");
+                }
+                delivered++;
+            });
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+
+        CHECK(caught);
+        CHECK(delivered < views.size());
+        // ordered delivery stops right at the failing file
+        CHECK(!ordered || delivered == 3);
+    }
+}
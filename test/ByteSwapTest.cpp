@@ -0,0 +1,69 @@
+#include <random>
+#include "Test.h"
+#include "ByteSwap.h"
+
+// big endian to native one byte at a time
+static std::vector<char> referenceSwap(const char *src, unsigned long elementSize, unsigned long count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return std::vector<char>(src, src + elementSize * count);
+#endif
+    std::vector<char> swapped(elementSize * count);
+    for (unsigned long i = 0; i < count; i++) {
+        for (unsigned long b = 0; b < elementSize; b++) {
+            swapped[i * elementSize + b] = src[i * elementSize + elementSize - 1 - b];
+        }
+    }
+    return swapped;
+}
+
+TEST(byteSwapKernelsAgree) {
+    std::mt19937 random(3);
+    std::vector<char> input(8 * 300 + 1);
+    for (char &c: input) {
+        c = (char) random();
+    }
+
+    bool scalarRan = false;
+    for (ByteSwapKernel kernel: {ByteSwapKernel::SCALAR, ByteSwapKernel::SSSE3, ByteSwapKernel::AVX2}) {
+        for (unsigned long elementSize: {2ul, 4ul, 8ul}) {
+            // every length around the 16/32/64 byte block edges, from aligned and unaligned sources
+            for (unsigned long count = 0; count <= 300; count++) {
+                for (unsigned long offset: {0ul, 1ul}) {
+                    const char *src = input.data() + offset;
+                    std::vector<char> expected = referenceSwap(src, elementSize, count);
+
+                    std::vector<char> out(elementSize * count);
+                    if (!byteSwapArrayWith(kernel, elementSize, src, out.data(), count))
+                        continue;
+                    scalarRan |= kernel == ByteSwapKernel::SCALAR;
+                    CHECK(out == expected);
+
+                    std::vector<char> inPlace(src, src + elementSize * count);
+                    byteSwapArrayWith(kernel, elementSize, inPlace.data(), inPlace.data(), count);
+                    CHECK(inPlace == expected);
+                }
+            }
+        }
+    }
+    CHECK(scalarRan);
+}
+
+TEST(byteSwapDispatchMatchesReference) {
+    std::vector<char> input(8 * 100);
+    for (unsigned long i = 0; i < input.size(); i++) {
+        input[i] = (char) (i * 7 + 3);
+    }
+
+    std::vector<char> out(input.size());
+    byteSwapArray16(input.data(), out.data(), 400);
+    CHECK(out == referenceSwap(input.data(), 2, 400));
+    byteSwapArray32(input.data(), out.data(), 200);
+    CHECK(out == referenceSwap(input.data(), 4, 200));
+    byteSwapArray64(input.data(), out.data(), 100);
+    CHECK(out == referenceSwap(input.data(), 8, 100));
+
+    signed int values[3];
+    const char bigEndian[12] = {0, 0, 0, 1, (char) 0xFF, (char) 0xFF, (char) 0xFF, (char) 0xFE, 0x12, 0x34, 0x56, 0x78};
+    readBigEndianArray(bigEndian, values, 3);
+    CHECK(values[0] == 1 && values[1] == -2 && values[2] == 0x12345678);
+}
@@ -0,0 +1,55 @@
+#include <type_traits>
+#include "Test.h"
+#include "NBT.h"
+
+static_assert(std::is_const<NBTCompoundMap<NBT>::value_type::first_type>::value, "keys can't be renamed in place");
+static_assert(std::is_nothrow_move_constructible<NBTCompoundMap<NBT>::value_type>::value,
+              "growing the entries must not copy whole subtrees");
+
+static NBTCompoundMap<NBT> numbered(unsigned long count) {
+    NBTCompoundMap<NBT> map;
+    for (unsigned long i = 0; i < count; i++) {
+        map.emplace("key" + std::to_string(i), NBT(TAG_Int, (signed int) i));
+    }
+    return map;
+}
+
+TEST(compoundEraseKeepsOrderAndLookups) {
+    // below and above the index threshold
+    for (unsigned long count: {8ul, 100ul}) {
+        NBTCompoundMap<NBT> map = numbered(count);
+
+        auto next = map.erase(map.find("key3"));
+        CHECK(next != map.end() && next->first == "key4");
+        CHECK(map.erase("key0") == 1);
+        CHECK(map.erase("key0") == 0);
+        CHECK(map.size() == count - 2);
+
+        unsigned long expected = 1;
+        bool ordered = true;
+        for (auto &element: map) {
+            if (expected == 3)
+                expected++;
+            ordered &= element.first == "key" + std::to_string(expected) &&
+                       element.second.getInt() == (signed int) expected;
+            expected++;
+        }
+        CHECK(ordered);
+
+        CHECK(map.count("key3") == 0);
+        CHECK(map.find("key" + std::to_string(count - 1)) != map.end());
+    }
+}
+
+TEST(compoundCopyAssignIsIndependent) {
+    NBTCompoundMap<NBT> copy = numbered(4);
+    NBTCompoundMap<NBT> original = numbered(50);
+
+    copy = original;
+    copy.at("key7") = NBT(TAG_Int, -1);
+    copy.erase("key8");
+
+    CHECK(copy.size() == 49 && original.size() == 50);
+    CHECK(original.at("key7").getInt() == 7);
+    CHECK(copy.find("key49") != copy.end() && copy.find("key49")->second.getInt() == 49);
+}
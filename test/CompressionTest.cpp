@@ -0,0 +1,40 @@
+#include <stdexcept>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTDocument.h"
+#include "NBTDialect.h"
+
+static NBT numberedDocument(signed int count) {
+    NBT root(TAG_Compound);
+    NBT &numbers = root.emplaceCompoundChild("numbers", TAG_List);
+    numbers.listType = TAG_Compound;
+    for (signed int i = 0; i < count; i++) {
+        numbers.emplaceListChild(TAG_Compound).emplaceCompoundChild("i", TAG_Int).writeVal(i);
+    }
+    return root;
+}
+
+template<typename Parse>
+static bool throwsRuntimeError(Parse parse) {
+    try {
+        parse();
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+TEST(truncatedGzipIsNeverParsed) {
+    std::vector<char> compressed = NBT::serialize(numberedDocument(2000), true);
+
+    // cut inside the deflate stream and just before the trailer
+    for (unsigned long size: {compressed.size() / 3, compressed.size() / 2, compressed.size() - 5}) {
+        CHECK(throwsRuntimeError([&]() { NBT::deserialize(compressed.data(), size); }));
+
+        NBTDocument document;
+        CHECK(throwsRuntimeError([&]() { document.parse(compressed.data(), size); }));
+    }
+
+    std::optional<NBT> whole = NBT::deserialize(compressed.data(), compressed.size(), NBTDialect::JAVA);
+    CHECK(whole.has_value() && whole->compoundElements.at("numbers").listChildren.size() == 2000);
+}
@@ -0,0 +1,121 @@
+#include <climits>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTDialect.h"
+#include "NBTStats.h"
+
+// the values varints and little endian swaps get wrong: negatives (zigzag), extremes, multi-byte lengths and
+// empty arrays and lists
+static NBT dialectDocument() {
+    NBT root(TAG_Compound);
+    root.name = NBTAtom("level");
+
+    root.emplaceCompoundChild("byte", TAG_Byte).writeVal((char) -7);
+    root.emplaceCompoundChild("short", TAG_Short).writeVal((signed short) -12345);
+    root.emplaceCompoundChild("float", TAG_Float).writeVal(-1.5f);
+    root.emplaceCompoundChild("double", TAG_Double).writeVal(6.02e23);
+
+    NBT &ints = root.emplaceCompoundChild("ints", TAG_List);
+    ints.listType = TAG_Int;
+    for (signed int value: {0, -1, 1, -64, 64, INT_MIN, INT_MAX}) {
+        ints.emplaceListChild(TAG_Int).writeVal(value);
+    }
+
+    NBT &longs = root.emplaceCompoundChild("longs", TAG_List);
+    longs.listType = TAG_Long;
+    for (signed long value: {0l, -1l, 300l, -300l, LONG_MIN, LONG_MAX}) {
+        longs.emplaceListChild(TAG_Long).writeVal(value);
+    }
+
+    root.emplaceCompoundChild("intArray", TAG_Int_Array).writeVal(std::vector<int>{-1, 0, INT_MIN, INT_MAX, 200});
+    root.emplaceCompoundChild("longArray", TAG_Long_Array).writeVal(std::vector<long>{LONG_MIN, -2, LONG_MAX});
+    root.emplaceCompoundChild("emptyBytes", TAG_Byte_Array).writeVal(std::vector<char>{});
+    root.emplaceCompoundChild("emptyInts", TAG_Int_Array).writeVal(std::vector<int>{});
+    root.emplaceCompoundChild("emptyLongs", TAG_Long_Array).writeVal(std::vector<long>{});
+    root.emplaceCompoundChild("emptyList", TAG_List).listType = TAG_End;
+    root.emplaceCompoundChild("emptyCompound", TAG_Compound);
+
+    // 300 bytes takes a two byte varint length
+    root.emplaceCompoundChild(std::string(130, 'k'), TAG_String).writeVal(std::string(300, 'v'));
+
+    NBT &nested = root.emplaceCompoundChild("nested", TAG_List);
+    nested.listType = TAG_Compound;
+    for (signed int i = -2; i <= 2; i++) {
+        nested.emplaceListChild(TAG_Compound).emplaceCompoundChild("i", TAG_Int).writeVal(i);
+    }
+    return root;
+}
+
+TEST(dialectsRoundTrip) {
+    NBT document = dialectDocument();
+    std::vector<char> expected = NBT::serialize(document);
+
+    for (NBTDialect dialect: {NBTDialect::JAVA, NBTDialect::BEDROCK, NBTDialect::NETWORK}) {
+        for (bool compressed: {false, true}) {
+            std::vector<char> encoded = NBT::serialize(document, dialect, compressed);
+            std::optional<NBT> decoded = NBT::deserialize(encoded.data(), encoded.size(), dialect);
+            CHECK(decoded.has_value() && NBT::serialize(*decoded) == expected);
+        }
+    }
+}
+
+TEST(dialectsRejectTruncatedInput) {
+    NBT document = dialectDocument();
+
+    for (NBTDialect dialect: {NBTDialect::JAVA, NBTDialect::BEDROCK, NBTDialect::NETWORK}) {
+        std::vector<char> encoded = NBT::serialize(document, dialect);
+
+        bool allRejected = true;
+        for (unsigned long size = 0; size < encoded.size(); size++) {
+            allRejected &= !NBT::deserialize(encoded.data(), size, dialect).has_value();
+        }
+        CHECK(allRejected);
+    }
+}
+
+TEST(networkRejectsOversizedAndUnterminatedVarints) {
+    // string length 65536
+    const char longString[] = {TAG_Compound, 0, TAG_String, 0, (char) 0x80, (char) 0x80, 0x04, TAG_End};
+    CHECK(!NBT::deserialize(longString, sizeof(longString), NBTDialect::NETWORK).has_value());
+
+    // int varint without an end within 5 bytes
+    const char longInt[] = {TAG_Compound, 0, TAG_Int, 0, (char) 0xFF, (char) 0xFF, (char) 0xFF, (char) 0xFF,
+                            (char) 0xFF, 0x01, TAG_End};
+    CHECK(!NBT::deserialize(longInt, sizeof(longInt), NBTDialect::NETWORK).has_value());
+
+    // 5 byte int varint above 32 bits
+    const char wideInt[] = {TAG_Compound, 0, TAG_Int, 0, (char) 0xFF, (char) 0xFF, (char) 0xFF, (char) 0xFF, 0x7F,
+                            TAG_End};
+    CHECK(!NBT::deserialize(wideInt, sizeof(wideInt), NBTDialect::NETWORK).has_value());
+
+    // list of compounds claiming far more elements than there are bytes
+    const char longList[] = {TAG_Compound, 0, TAG_List, 0, TAG_Compound, (char) 0xFE, (char) 0xFF, 0x03, TAG_End,
+                             TAG_End};
+    CHECK(!NBT::deserialize(longList, sizeof(longList), NBTDialect::NETWORK).has_value());
+
+    // the largest valid int still decodes
+    const char maxInt[] = {TAG_Compound, 0, TAG_Int, 1, 'i', (char) 0xFE, (char) 0xFF, (char) 0xFF, (char) 0xFF,
+                           0x0F, TAG_End};
+    std::optional<NBT> decoded = NBT::deserialize(maxInt, sizeof(maxInt), NBTDialect::NETWORK);
+    CHECK(decoded.has_value() && decoded->compoundElements.at("i").getInt() == INT_MAX);
+}
+
+TEST(dialectDeserializeRecordsInflate) {
+    NBT document = dialectDocument();
+
+    for (NBTDialect dialect: {NBTDialect::JAVA, NBTDialect::BEDROCK, NBTDialect::NETWORK}) {
+        std::vector<char> plain = NBT::serialize(document, dialect);
+        std::vector<char> compressed = NBT::serialize(document, dialect, true);
+
+        NBTStats::setEnabled(true);
+        std::optional<NBT> decoded = NBT::deserialize(compressed.data(), compressed.size(), dialect);
+        NBTStats stats = NBTStats::last();
+        NBTStats::setEnabled(false);
+
+        CHECK(decoded.has_value());
+        CHECK(stats.calls == 1);
+        CHECK(stats.compressedBytes == compressed.size());
+        CHECK(stats.uncompressedBytes == plain.size());
+        CHECK(stats.inflateNanos > 0 && stats.peakBytes > stats.bytesAllocated);
+    }
+}
@@ -0,0 +1,99 @@
+#include <stdexcept>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTDocument.h"
+
+static bool rejects(NBTDocument &document, const char *bytes, unsigned long size) {
+    try {
+        document.parse(bytes, size);
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+TEST(documentMatchesDeserialize) {
+    NBTDocument document(256);
+
+    for (const char *fixture: {"bigtest.nbt", "hello_world.nbt", "Player-nan-value.dat"}) {
+        std::string bytes = readFixture(fixture);
+        NBT expected = NBT::deserialize(bytes.data(), bytes.size());
+
+        const NBTNode &root = document.parse(bytes.data(), bytes.size());
+        CHECK(root.tagID() == TAG_Compound);
+        CHECK(expected.name.has_value() && *expected.name == root.name());
+        CHECK(root.childrenCount() == (signed int) expected.compoundElements.size());
+        CHECK(NBT::serialize(root.toNBT()) == NBT::serialize(expected));
+    }
+}
+
+TEST(documentTypedGetters) {
+    std::string bytes = readFixture("bigtest.nbt");
+    NBTDocument document;
+    const NBTNode &root = document.parse(bytes.data(), bytes.size());
+
+    CHECK(root.find("byteTest")->getByte() == 127);
+    CHECK(root.find("shortTest")->getShort() == 32767);
+    CHECK(root.find("intTest")->getInt() == 2147483647);
+    CHECK(root.find("longTest")->getLong() == 9223372036854775807l);
+    CHECK(root.find("doubleTest")->getDouble() == 0.49312871321823148);
+    CHECK(root.find("floatTest")->getFloat() == 0.49823147058486938f);
+    CHECK(root.find("stringTest")->getString() == "HELLO WORLD THIS IS A TEST STRING \xc3\x85\xc3\x84\xc3\x96!");
+    CHECK(root.find("missing") == nullptr);
+
+    const NBTNode *longs = root.find("listTest (long)");
+    CHECK(longs->listType() == TAG_Long && longs->childrenCount() == 5);
+    signed long expected = 11;
+    for (const NBTNode &element: *longs) {
+        CHECK(element.name().empty() && element.getLong() == expected++);
+    }
+
+    const NBTNode *byteArray = root.find(
+            "byteArrayTest (the first 1000 values of (n*n*255+n*7)%100, starting with n=0 (0, 62, 34, 16, 8, ...))");
+    std::vector<char> byteValues = byteArray->getByteVector();
+    CHECK(byteValues.size() == 1000);
+    bool matches = true;
+    for (signed int n = 0; n < 1000; n++) {
+        matches &= byteValues[n] == (char) ((n * n * 255 + n * 7) % 100);
+    }
+    CHECK(matches);
+}
+
+TEST(documentRejectsMalformedInput) {
+    NBT root(TAG_Compound);
+    root.emplaceCompoundChild("ints", TAG_Int_Array).writeVal(std::vector<int>{1, 2, 3});
+    NBT &list = root.emplaceCompoundChild("list", TAG_List);
+    list.listType = TAG_Compound;
+    list.emplaceListChild(TAG_Compound).emplaceCompoundChild("s", TAG_String).writeVal(std::string("value"));
+    std::vector<char> bytes = NBT::serialize(root);
+
+    NBTDocument document;
+    bool allRejected = true;
+    for (unsigned long size = 0; size < bytes.size(); size++) {
+        allRejected &= rejects(document, bytes.data(), size);
+    }
+    CHECK(allRejected);
+    CHECK(document.parse(bytes.data(), bytes.size()).find("list")->childrenCount() == 1);
+
+    // a list of compounds claiming a billion elements in a 14 byte document
+    const char longList[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Compound, 0x40, 0, 0, 0, TAG_End, TAG_End};
+    CHECK(rejects(document, longList, sizeof(longList)));
+
+    // an int array claiming more values than there are bytes
+    const char longArray[] = {TAG_Compound, 0, 0, TAG_Int_Array, 0, 0, 0, 0, 0, 2, 0, 0, 0, 1, TAG_End};
+    CHECK(rejects(document, longArray, sizeof(longArray)));
+
+    const char unknownTag[] = {TAG_Compound, 0, 0, 42, 0, 0, TAG_End};
+    CHECK(rejects(document, unknownTag, sizeof(unknownTag)));
+
+    const char notCompound[] = {TAG_Int, 0, 0, 0, 0, 0, 1};
+    CHECK(rejects(document, notCompound, sizeof(notCompound)));
+
+    // compounds nested past the depth limit
+    std::vector<char> deep = {TAG_Compound, 0, 0};
+    for (unsigned long i = 0; i < NBTDocument::MAX_DEPTH + 1; i++) {
+        deep.insert(deep.end(), {TAG_Compound, 0, 0});
+    }
+    deep.insert(deep.end(), NBTDocument::MAX_DEPTH + 2, TAG_End);
+    CHECK(rejects(document, deep.data(), deep.size()));
+}
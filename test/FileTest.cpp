@@ -0,0 +1,88 @@
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTStats.h"
+
+static std::string tempDirectory() {
+    char path[] = "/tmp/NBeeTeaTest.XXXXXX";
+    return mkdtemp(path) != nullptr ? path : "/tmp";
+}
+
+static void writeRaw(const std::string &path, const std::vector<char> &bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), (std::streamsize) bytes.size());
+}
+
+TEST(saveAndLoadFileRoundTrip) {
+    std::string directory = tempDirectory();
+    std::string fixture = readFixture("bigtest.nbt");
+    NBT root = NBT::deserialize(fixture.data(), fixture.size());
+    std::vector<char> expected = NBT::serialize(root);
+
+    for (bool compressed: {false, true}) {
+        std::string path = directory + "/level.dat";
+        CHECK(NBT::saveFile(path, root, compressed, false));
+
+        std::optional<NBT> loaded = NBT::loadFile(path);
+        CHECK(loaded.has_value());
+        CHECK(loaded.has_value() && NBT::serialize(*loaded) == expected);
+
+        std::optional<NBT> kept = NBT::loadFile(path, true);
+        CHECK(kept.has_value() && kept->isSpliceable() && NBT::serialize(*kept) == expected);
+        unlink(path.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+TEST(loadFileRejectsBadFiles) {
+    std::string directory = tempDirectory();
+    std::string path = directory + "/bad.dat";
+    std::string fixture = readFixture("bigtest.nbt");
+    std::vector<char> compressed(fixture.begin(), fixture.end());
+
+    CHECK(!NBT::loadFile(directory + "/missing.dat").has_value());
+
+    // corrupt deflate data, a truncated member and plain garbage
+    std::vector<char> corrupt = compressed;
+    for (unsigned long i = 20; i < corrupt.size() - 8; i += 3) {
+        corrupt[i] ^= 0x5A;
+    }
+    writeRaw(path, corrupt);
+    CHECK(!NBT::loadFile(path).has_value());
+
+    writeRaw(path, std::vector<char>(compressed.begin(), compressed.begin() + compressed.size() / 2));
+    CHECK(!NBT::loadFile(path).has_value());
+
+    writeRaw(path, {'n', 'o', 't', ' ', 'n', 'b', 't'});
+    CHECK(!NBT::loadFile(path).has_value());
+
+    writeRaw(path, {});
+    CHECK(!NBT::loadFile(path).has_value());
+
+    unlink(path.c_str());
+    rmdir(directory.c_str());
+}
+
+TEST(loadFileRecordsInflate) {
+    std::string directory = tempDirectory();
+    std::string path = directory + "/level.dat";
+    std::string fixture = readFixture("bigtest.nbt");
+    writeRaw(path, std::vector<char>(fixture.begin(), fixture.end()));
+    unsigned long plainSize = NBT::serializedSize(NBT::deserialize(fixture.data(), fixture.size()));
+
+    NBTStats::setEnabled(true);
+    std::optional<NBT> loaded = NBT::loadFile(path);
+    NBTStats stats = NBTStats::last();
+    NBTStats::setEnabled(false);
+
+    CHECK(loaded.has_value());
+    CHECK(stats.calls == 1);
+    CHECK(stats.compressedBytes == fixture.size());
+    CHECK(stats.uncompressedBytes == plainSize);
+    CHECK(stats.inflateNanos > 0);
+
+    unlink(path.c_str());
+    rmdir(directory.c_str());
+}
@@ -0,0 +1,42 @@
+#include "Test.h"
+#include "NBT.h"
+#include "PackedArray.h"
+
+TEST(paletteRoundTripsEveryWidth) {
+    std::vector<uint16_t> entries(4096);
+    for (unsigned long i = 0; i < entries.size(); i++) {
+        entries[i] = (uint16_t) (i * 2654435761u >> 7);
+    }
+
+    for (PackedLayout layout: {PackedLayout::PADDED, PackedLayout::SPANNING}) {
+        for (unsigned int bits = 1; bits <= 16; bits++) {
+            std::optional<NBT> packed = NBT::packPalette(entries.data(), entries.size(), bits, layout);
+            CHECK(packed.has_value());
+            if (!packed.has_value())
+                continue;
+
+            std::vector<uint16_t> unpacked(entries.size());
+            CHECK(packed->unpackPalette(bits, unpacked.data(), unpacked.size(), layout));
+
+            bool same = true;
+            for (unsigned long i = 0; i < entries.size(); i++) {
+                same &= unpacked[i] == (entries[i] & ((1u << bits) - 1));
+            }
+            CHECK(same);
+        }
+    }
+}
+
+TEST(paletteRejectsBadWidths) {
+    uint16_t entries[64] = {};
+    char longs[8 * 64] = {};
+    signed long nativeLongs[64] = {};
+    uint16_t out[64];
+
+    for (unsigned int bits: {0u, 17u, 64u, 1000u}) {
+        CHECK(!NBT::packPalette(entries, 64, bits).has_value());
+        CHECK(!packPalette(entries, 64, bits, PackedLayout::PADDED, longs));
+        CHECK(!unpackPalette(longs, 64, bits, PackedLayout::PADDED, out, 64));
+        CHECK(!unpackPalette(nativeLongs, 64, bits, PackedLayout::SPANNING, out, 64));
+    }
+}
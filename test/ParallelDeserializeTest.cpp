@@ -0,0 +1,64 @@
+#include "Test.h"
+#include "NBT.h"
+#include "ThreadPool.h"
+
+// nested lists of compounds and lists of lists, big enough to be split at every grain size tested
+static void fillEntity(NBT &entity, signed int id, unsigned int depth) {
+    entity.emplaceCompoundChild("id", TAG_Int).writeVal(id);
+    entity.emplaceCompoundChild("name", TAG_String).writeVal("entity" + std::to_string(id % 97));
+
+    NBT &pos = entity.emplaceCompoundChild("pos", TAG_List);
+    pos.listType = TAG_Double;
+    for (int i = 0; i < 3; i++) {
+        pos.emplaceListChild(TAG_Double).writeVal((double) id + i);
+    }
+
+    if (depth == 0)
+        return;
+
+    NBT &passengers = entity.emplaceCompoundChild("passengers", TAG_List);
+    passengers.listType = TAG_Compound;
+    for (signed int i = 0; i < 90; i++) {
+        fillEntity(passengers.emplaceListChild(TAG_Compound), i, depth - 1);
+    }
+
+    NBT &lists = entity.emplaceCompoundChild("lists", TAG_List);
+    lists.listType = TAG_List;
+    for (signed int i = 0; i < 70; i++) {
+        NBT &list = lists.emplaceListChild(TAG_List);
+        list.listType = TAG_Int;
+        for (signed int j = 0; j < i; j++) {
+            list.emplaceListChild(TAG_Int).writeVal(j);
+        }
+    }
+}
+
+static NBT entityDocument() {
+    NBT root(TAG_Compound);
+    NBT &entities = root.emplaceCompoundChild("entities", TAG_List);
+    entities.listType = TAG_Compound;
+    for (signed int i = 0; i < 200; i++) {
+        fillEntity(entities.emplaceListChild(TAG_Compound), i, 1);
+    }
+    root.emplaceCompoundChild("empty", TAG_List).listType = TAG_Compound;
+    return root;
+}
+
+TEST(parallelDeserializeMatchesSerial) {
+    ThreadPool pool(4);
+    NBT root = entityDocument();
+    std::vector<char> plain = NBT::serialize(root);
+    std::vector<char> compressed = NBT::serialize(root, true);
+
+    NBT serial = NBT::deserialize(plain.data(), plain.size());
+    CHECK(NBT::serialize(serial) == plain);
+
+    for (unsigned long grainSize: {1ul, 2ul, 7ul, 64ul, 1000ul}) {
+        NBT fromPlain = NBT::deserialize(plain.data(), plain.size(), pool, grainSize);
+        NBT fromCompressed = NBT::deserialize(compressed.data(), compressed.size(), pool, grainSize);
+
+        CHECK(fromPlain.compoundElements.at("entities").listChildren.size() == 200);
+        CHECK(NBT::serialize(fromPlain) == plain);
+        CHECK(NBT::serialize(fromCompressed) == plain);
+    }
+}
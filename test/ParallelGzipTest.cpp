@@ -0,0 +1,134 @@
+#include <random>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTSink.h"
+#include "Compression.h"
+#include "ThreadPool.h"
+#include "NBTStats.h"
+
+// a few hundred kilobytes serialized, so it spans several 64k blocks
+static NBT counterDocument(signed int count) {
+    NBT root(TAG_Compound);
+    NBT &counters = root.emplaceCompoundChild("counters", TAG_List);
+    counters.listType = TAG_Compound;
+    for (signed int i = 0; i < count; i++) {
+        NBT &counter = counters.emplaceListChild(TAG_Compound);
+        counter.emplaceCompoundChild("i", TAG_Int).writeVal(i);
+        counter.emplaceCompoundChild("square", TAG_Long).writeVal((signed long) i * i);
+    }
+    return root;
+}
+
+TEST(parallelGzipRoundTrip) {
+    ThreadPool pool(4);
+    std::mt19937 random(1);
+
+    for (unsigned long size: {0ul, 1ul, 1000ul, 32768ul, 300000ul}) {
+        std::string input(size, 0);
+        for (char &c: input) {
+            c = "abcdefgh"[random() % 8];
+        }
+
+        for (CompressionFormat format: {CompressionFormat::GZIP, CompressionFormat::ZLIB, CompressionFormat::DEFLATE}) {
+            for (bool independentBlocks: {false, true}) {
+                ParallelCompressionOptions options;
+                options.compression.format = format;
+                options.blockSize = 16 * 1024;
+                options.independentBlocks = independentBlocks;
+
+                std::vector<char> compressed;
+                VectorSink sink(compressed);
+                CHECK(compressBufferParallel(input.data(), input.size(), options, pool, sink));
+
+                std::string serial;
+                CHECK(decompressBuffer(compressed.data(), compressed.size(), format, serial));
+                CHECK(serial == input);
+
+                std::string parallel;
+                CHECK(decompressBufferParallel(compressed.data(), compressed.size(), format, pool, parallel));
+                CHECK(parallel == input);
+            }
+        }
+    }
+}
+
+TEST(parallelGzipRejectsCorruptMember) {
+    ThreadPool pool(4);
+    std::mt19937 random(2);
+    std::string input(300000, 0);
+    for (char &c: input) {
+        c = (char) random();
+    }
+
+    ParallelCompressionOptions options;
+    options.independentBlocks = true;
+    std::vector<char> compressed;
+    VectorSink sink(compressed);
+    CHECK(compressBufferParallel(input.data(), input.size(), options, pool, sink));
+
+    compressed[compressed.size() / 2] ^= 0x55;
+    std::string out;
+    CHECK(!decompressBufferParallel(compressed.data(), compressed.size(), CompressionFormat::GZIP, pool, out));
+    CHECK(!decompressBuffer(compressed.data(), compressed.size(), CompressionFormat::GZIP, out));
+}
+
+TEST(parallelGzipRejectsForgedMemberSize) {
+    ThreadPool pool(4);
+    std::string input(300000, 'a');
+
+    ParallelCompressionOptions options;
+    options.blockSize = 16 * 1024;
+    options.independentBlocks = true;
+    std::vector<char> compressed;
+    VectorSink sink(compressed);
+    CHECK(compressBufferParallel(input.data(), input.size(), options, pool, sink));
+
+    // the first member claims to inflate to almost 4 GiB. its size is in the header's extra field
+    unsigned long memberSize = 0;
+    for (int i = 3; i >= 0; i--) {
+        memberSize = memberSize << 8 | (unsigned char) compressed[16 + i];
+    }
+    for (int i = 0; i < 4; i++) {
+        compressed[memberSize - 4 + i] = (char) 0xFF;
+    }
+
+    std::string out;
+    CHECK(!decompressBufferParallel(compressed.data(), compressed.size(), CompressionFormat::GZIP, pool, out));
+    CHECK(out.capacity() < 64 * 1024 * 1024);
+}
+
+TEST(parallelSerializeRoundTrip) {
+    ThreadPool pool(4);
+    NBT root = counterDocument(20000);
+    std::vector<char> plain = NBT::serialize(root);
+
+    for (bool independentBlocks: {false, true}) {
+        ParallelCompressionOptions options;
+        options.blockSize = 64 * 1024;
+        options.independentBlocks = independentBlocks;
+
+        std::vector<char> compressed = NBT::serialize(root, options, pool);
+        CHECK(NBT::serialize(NBT::deserialize(compressed.data(), compressed.size())) == plain);
+        CHECK(NBT::serialize(NBT::deserialize(compressed.data(), compressed.size(), pool)) == plain);
+    }
+}
+
+TEST(parallelSerializeRecordsOneCall) {
+    ThreadPool pool(4);
+    NBT root = counterDocument(20000);
+    std::vector<char> plain = NBT::serialize(root);
+
+    ParallelCompressionOptions options;
+    options.blockSize = 64 * 1024;
+
+    NBTStats::resetTotals();
+    NBTStats::setEnabled(true);
+    std::vector<char> compressed = NBT::serialize(root, options, pool);
+    NBTStats::setEnabled(false);
+
+    NBTStats total = NBTStats::threadTotal();
+    CHECK(total.calls == 1);
+    CHECK(total.uncompressedBytes == plain.size());
+    CHECK(total.compressedBytes == compressed.size());
+    NBTStats::resetTotals();
+}
@@ -0,0 +1,33 @@
+#include <atomic>
+#include <stdexcept>
+#include "Test.h"
+#include "ThreadPool.h"
+
+TEST(parallelForRethrowsOnCaller) {
+    ThreadPool pool(4);
+
+    for (unsigned long failing: {0ul, 17ul, 99ul}) {
+        std::atomic<unsigned long> ran{0};
+        bool caught = false;
+        try {
+            pool.parallelFor(100, 1, [&](unsigned long begin, unsigned long) {
+                ran++;
+                if (begin == failing)
+                    throw std::runtime_error("block failed");
+            });
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+        CHECK(caught);
+        CHECK(ran <= 100);
+    }
+
+    // the pool is still usable afterwards
+    std::atomic<unsigned long> sum{0};
+    pool.parallelFor(100, 3, [&](unsigned long begin, unsigned long end) {
+        for (unsigned long i = begin; i < end; i++) {
+            sum += i;
+        }
+    });
+    CHECK(sum == 4950);
+}
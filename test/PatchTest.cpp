@@ -0,0 +1,98 @@
+#include "Test.h"
+#include "NBT.h"
+#include "NBTPatch.h"
+#include "Compression.h"
+
+static NBT bigtest(bool keepSource) {
+    std::string compressed = readFixture("bigtest.nbt");
+    return NBT::deserialize(compressed.data(), compressed.size(), keepSource);
+}
+
+// the elements of compound in the given order, everything else dropped
+static NBT reordered(const NBT &compound, const std::vector<std::string> &order) {
+    NBT result(TAG_Compound);
+    result.name = compound.name;
+    for (const std::string &key: order) {
+        result.addCompoundChild(key, compound.compoundElements.at(key));
+    }
+    return result;
+}
+
+// a bit of everything: edited scalars, a removed key, new keys in front of old ones, reordered keys in a nested
+// compound, list elements inserted in the middle and a few changed array elements
+static NBT editedBigtest() {
+    NBT from = bigtest(false);
+
+    NBT nested = reordered(from.compoundElements.at("nested compound test"), {"ham", "egg"});
+    nested.compoundElements.at("egg").compoundElements.at("value").writeVal(0.25f);
+
+    NBT longs = from.compoundElements.at("listTest (long)");
+    longs.listChildren.insert(longs.listChildren.begin() + 2, NBT(TAG_Long, (signed long) -7));
+
+    NBT bytes;
+    for (const auto &element: from.compoundElements) {
+        if (element.second.tagID == TAG_Byte_Array)
+            bytes = element.second;
+    }
+    bytes.valueBytes[10] ^= 1;
+    bytes.valueBytes[500] ^= 1;
+
+    NBT to(TAG_Compound);
+    to.name = NBTAtom("Level (patched)");
+    to.addCompoundChild("brand new", NBT(TAG_String, std::string("first")));
+    to.addCompoundChild("nested compound test", nested);
+    to.addCompoundChild("intTest", NBT(TAG_Int, (signed int) 12345));
+    to.addCompoundChild("listTest (long)", longs);
+    to.addCompoundChild("another new", NBT(TAG_Double, 0.5));
+    to.addCompoundChild(bytes.name.value(), bytes);
+    for (const auto &element: from.compoundElements) {
+        if (to.compoundElements.count(element.first) == 0 && element.first != "shortTest")
+            to.addCompoundChild(element.first, element.second);
+    }
+    return to;
+}
+
+TEST(patchRoundTripIsByteIdentical) {
+    NBT to = editedBigtest();
+    std::vector<char> expected = NBT::serialize(to);
+
+    for (bool keepSource: {false, true}) {
+        NBT from = bigtest(keepSource);
+        std::vector<char> patch = NBTPatch::diff(from, to);
+        CHECK(patch.size() < expected.size());
+
+        CHECK(NBTPatch::apply(from, patch));
+        CHECK(NBT::serialize(from) == expected);
+
+        // and the patched tree diffs as equal
+        std::vector<char> empty = NBTPatch::diff(from, to);
+        NBT again = from;
+        CHECK(NBTPatch::apply(again, empty));
+        CHECK(NBT::serialize(again) == expected);
+    }
+}
+
+TEST(patchOfSerializedDocumentsRoundTrips) {
+    std::vector<char> fromBytes = NBT::serialize(bigtest(false), true);
+    std::vector<char> toBytes = NBT::serialize(editedBigtest());
+
+    std::vector<char> patch = NBTPatch::diff(fromBytes.data(), fromBytes.size(), toBytes.data(), toBytes.size());
+    NBT patched = NBT::deserialize(fromBytes.data(), fromBytes.size());
+    CHECK(NBTPatch::apply(patched, patch));
+    CHECK(NBT::serialize(patched) == toBytes);
+}
+
+TEST(patchRejectsMalformedInput) {
+    NBT to = editedBigtest();
+    std::vector<char> patch = NBTPatch::diff(bigtest(false), to);
+
+    for (unsigned long size = 0; size < patch.size(); size += 7) {
+        NBT from = bigtest(false);
+        CHECK(!NBTPatch::apply(from, patch.data(), size));
+    }
+
+    // a patch against a document that doesn't have the keys it edits
+    NBT other(TAG_Compound);
+    other.addCompoundChild("intTest", NBT(TAG_Int, (signed int) 1));
+    CHECK(!NBTPatch::apply(other, patch));
+}
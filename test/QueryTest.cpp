@@ -0,0 +1,116 @@
+#include "Test.h"
+#include "NBT.h"
+#include "NBTQuery.h"
+
+static NBT chunkDocument() {
+    NBT root(TAG_Compound);
+    NBT &level = root.emplaceCompoundChild("Level", TAG_Compound);
+    level.emplaceCompoundChild("xPos", TAG_Int).writeVal(3);
+
+    NBT &sections = level.emplaceCompoundChild("Sections", TAG_List);
+    sections.listType = TAG_Compound;
+    for (signed int y = -4; y < 4; y++) {
+        NBT &section = sections.emplaceListChild(TAG_Compound);
+        section.emplaceCompoundChild("Y", TAG_Byte).writeVal((char) y);
+        section.emplaceCompoundChild("BlockStates", TAG_Long_Array).writeVal(std::vector<long>{y * 10l, y * 10l + 1});
+    }
+
+    NBT &pos = root.emplaceCompoundChild("Pos", TAG_List);
+    pos.listType = TAG_Double;
+    for (double value: {1.5, 64.0, -2.25}) {
+        pos.emplaceListChild(TAG_Double).writeVal(value);
+    }
+
+    NBT &inventory = root.emplaceCompoundChild("Inventory", TAG_List);
+    inventory.listType = TAG_Compound;
+    for (const char *id: {"minecraft:stone", "minecraft:dirt"}) {
+        inventory.emplaceListChild(TAG_Compound).emplaceCompoundChild("id", TAG_String).writeVal(std::string(id));
+    }
+
+    root.emplaceCompoundChild("some.name", TAG_Int).writeVal(7);
+    root.emplaceCompoundChild("ints", TAG_Int_Array).writeVal(std::vector<int>{10, 20, 30});
+    return root;
+}
+
+TEST(queryPathsCompile) {
+    for (const char *valid: {"Level.Sections[*].Y", "Pos[1]", "Inventory[*].id", "\"some.name\"", "*", "a.*.b",
+                             "ints[2]", "Level.\"quoted \\\"name\\\"\""}) {
+        CHECK(NBTPath::compile(valid).has_value());
+    }
+    for (const char *invalid: {"", ".a", "a.", "a..b", "a[", "a[]", "a[x]", "a[-1]", "a[99999999999]", "\"open",
+                               "a[0]b", "a*"}) {
+        CHECK(!NBTPath::compile(invalid).has_value());
+    }
+
+    CHECK(NBTPath::compile("Level.Sections[*].Y")->hasWildcard());
+    CHECK(NBTPath::compile("Level.*")->hasWildcard());
+    CHECK(!NBTPath::compile("Pos[1]")->hasWildcard());
+}
+
+TEST(queryMatchesInDocumentOrder) {
+    std::vector<char> bytes = NBT::serialize(chunkDocument());
+
+    NBTQuery query;
+    unsigned int sectionY = *query.add("Level.Sections[*].Y");
+    unsigned int posY = *query.add("Pos[1]");
+    unsigned int ids = *query.add("Inventory[*].id");
+    unsigned int quoted = *query.add("\"some.name\"");
+    unsigned int arrayElement = *query.add("ints[2]");
+    unsigned int levelChildren = *query.add("Level.*");
+    CHECK(!query.add("Level..Sections").has_value());
+    CHECK(query.size() == 6);
+
+    std::vector<signed int> ys;
+    std::vector<std::string> matches;
+    query.run(bytes.data(), bytes.size(), [&](unsigned int path, const NBTView &match) {
+        if (path == sectionY) {
+            ys.push_back(match.getByte());
+        } else if (path == posY) {
+            matches.push_back("pos " + std::to_string(match.getDouble()));
+        } else if (path == ids) {
+            matches.push_back(std::string(match.getString()));
+        } else if (path == quoted) {
+            matches.push_back("quoted " + std::to_string(match.getInt()));
+        } else if (path == arrayElement) {
+            matches.push_back("int " + std::to_string(match.getInt()));
+        } else if (path == levelChildren) {
+            matches.push_back(std::string(match.name()));
+        }
+    });
+
+    CHECK((ys == std::vector<signed int>{-4, -3, -2, -1, 0, 1, 2, 3}));
+    CHECK((matches == std::vector<std::string>{"xPos", "Sections", "pos 64.000000", "minecraft:stone",
+                                               "minecraft:dirt", "quoted 7", "int 30"}));
+}
+
+TEST(queryFirstReportsMissingPaths) {
+    std::vector<char> bytes = NBT::serialize(chunkDocument());
+
+    NBTQuery query;
+    query.add("Level.Sections[*].BlockStates");
+    query.add("Level.Sections[8].Y");
+    query.add("Pos[3]");
+    query.add("Missing.*");
+    query.add("Level.xPos.deeper");
+
+    std::vector<NBTView> first = query.first(bytes.data(), bytes.size());
+    CHECK(first.size() == 5);
+    CHECK(first[0].valid() && first[0].getLongArrayElement(0) == -40);
+    for (unsigned long i = 1; i < first.size(); i++) {
+        CHECK(!first[i].valid());
+    }
+
+    // the same through a view of a fixture
+    std::string stored = readFixture("bigtest.nbt");
+    std::vector<char> bigtest = NBT::serialize(NBT::deserialize(stored.data(), stored.size()));
+    NBTQuery fixtureQuery;
+    fixtureQuery.add("\"nested compound test\".egg.name");
+    fixtureQuery.add("\"listTest (long)\"[2]");
+    fixtureQuery.add("\"listTest (compound)\"[*].name");
+
+    std::vector<std::string> found;
+    fixtureQuery.run(NBTView::root(bigtest.data(), bigtest.size()), [&](unsigned int, const NBTView &match) {
+        found.push_back(match.tagID() == TAG_Long ? std::to_string(match.getLong()) : std::string(match.getString()));
+    });
+    CHECK((found == std::vector<std::string>{"Eggbert", "13", "Compound tag #0", "Compound tag #1"}));
+}
@@ -0,0 +1,52 @@
+#include <cstdlib>
+#include <unistd.h>
+#include "Test.h"
+#include "NBT.h"
+#include "RegionFile.h"
+
+static std::string tempRegionPath() {
+    char path[] = "/tmp/NBeeTeaTest.XXXXXX";
+    return std::string(mkdtemp(path) != nullptr ? path : "/tmp") + "/r.0.0.mca";
+}
+
+static NBT chunkOfSize(unsigned long bytes, signed int tag) {
+    NBT chunk(TAG_Compound);
+    chunk.compoundElements.emplace("tag", NBT(TAG_Int, tag));
+    chunk.compoundElements.emplace("filler", NBT(TAG_String, std::string(bytes, 'a' + tag % 26)));
+    return chunk;
+}
+
+TEST(regionWritesGrowRelocateAndRemove) {
+    std::string path = tempRegionPath();
+    RegionFile region;
+    CHECK(region.open(path, true));
+
+    // uncompressed so the sizes below decide the sector counts: 1 sector, then 3 (relocated past the end), then
+    // back to 1 in place
+    for (unsigned long size: {100ul, 10000ul, 50ul}) {
+        for (int x = 0; x < 3; x++) {
+            NBT chunk = chunkOfSize(size, x);
+            CHECK(region.writeChunk(x, 1, chunk, RegionFile::COMPRESSION_NONE, 1234));
+        }
+
+        for (int x = 0; x < 3; x++) {
+            std::optional<NBT> read = region.readChunk(x, 1);
+            CHECK(read.has_value() && read->compoundElements.at("tag").getInt() == x &&
+                  read->compoundElements.at("filler").getString().size() == size);
+            CHECK(region.getTimestamp(x, 1) == 1234);
+        }
+    }
+
+    CHECK(region.removeChunk(1, 1));
+    CHECK(!region.hasChunk(1, 1) && region.hasChunk(0, 1) && region.hasChunk(2, 1));
+    region.close();
+
+    // everything was published through the header
+    RegionFile reopened;
+    CHECK(reopened.open(path));
+    CHECK(!reopened.hasChunk(1, 1));
+    std::optional<NBT> read = reopened.readChunk(2, 1);
+    CHECK(read.has_value() && read->compoundElements.at("tag").getInt() == 2);
+
+    unlink(path.c_str());
+}
@@ -0,0 +1,161 @@
+#include <stdexcept>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTSchema.h"
+#include "NBTSink.h"
+
+struct SchemaItem {
+    std::string id;
+    char count = 0;
+    std::optional<char> slot;
+
+    bool operator==(const SchemaItem &other) const {
+        return id == other.id && count == other.count && slot == other.slot;
+    }
+};
+
+template<>
+struct NBTSchema<SchemaItem> {
+    static constexpr auto fields = std::make_tuple(
+            nbtField("id", &SchemaItem::id),
+            nbtField("Count", &SchemaItem::count),
+            nbtField("Slot", &SchemaItem::slot));
+};
+
+struct SchemaPlayer {
+    std::string name;
+    signed short level = 0;
+    signed int health = 0;
+    signed long uuid = 0;
+    float yaw = 0;
+    double x = 0;
+    bool flying = false;
+    std::vector<char> flags;
+    std::vector<signed int> scores;
+    std::vector<signed long> states;
+    std::vector<double> pos;
+    std::vector<SchemaItem> inventory;
+    std::vector<std::vector<signed int>> history;
+    std::optional<SchemaItem> cursor;
+
+    bool operator==(const SchemaPlayer &other) const {
+        return name == other.name && level == other.level && health == other.health && uuid == other.uuid &&
+               yaw == other.yaw && x == other.x && flying == other.flying && flags == other.flags &&
+               scores == other.scores && states == other.states && pos == other.pos &&
+               inventory == other.inventory && history == other.history && cursor == other.cursor;
+    }
+};
+
+template<>
+struct NBTSchema<SchemaPlayer> {
+    static constexpr auto fields = std::make_tuple(
+            nbtField("Name", &SchemaPlayer::name),
+            nbtField("Level", &SchemaPlayer::level),
+            nbtField("Health", &SchemaPlayer::health),
+            nbtField("UUID", &SchemaPlayer::uuid),
+            nbtField("Yaw", &SchemaPlayer::yaw),
+            nbtField("X", &SchemaPlayer::x),
+            nbtField("Flying", &SchemaPlayer::flying),
+            nbtField("Flags", &SchemaPlayer::flags),
+            nbtField("Scores", &SchemaPlayer::scores),
+            nbtField("States", &SchemaPlayer::states),
+            nbtField("Pos", &SchemaPlayer::pos),
+            nbtField("Inventory", &SchemaPlayer::inventory),
+            nbtField("History", &SchemaPlayer::history),
+            nbtField("Cursor", &SchemaPlayer::cursor));
+};
+
+static SchemaPlayer samplePlayer() {
+    SchemaPlayer player;
+    player.name = "Steve";
+    player.level = -3;
+    player.health = 20;
+    player.uuid = -1234567890123l;
+    player.yaw = 90.5f;
+    player.x = -1e9;
+    player.flying = true;
+    player.flags = {1, 0, -1};
+    player.scores = {-5, 0, 70000};
+    player.states = {1l << 40, -1};
+    player.pos = {1.5, 64.0, -2.25};
+    player.inventory = {{"minecraft:stone", 64, 0}, {"minecraft:dirt", 3, std::nullopt}};
+    player.history = {{1, 2}, {}, {3}};
+    player.cursor = SchemaItem{"minecraft:torch", 1, std::nullopt};
+    return player;
+}
+
+TEST(schemaRoundTrips) {
+    SchemaPlayer player = samplePlayer();
+
+    for (bool compressed: {false, true}) {
+        std::vector<char> bytes = NBTBinding<SchemaPlayer>::serialize(player, compressed, "player");
+        SchemaPlayer decoded;
+        CHECK(NBTBinding<SchemaPlayer>::deserialize(bytes.data(), bytes.size(), decoded));
+        CHECK(decoded == player);
+
+        // the same document through the tree API
+        NBT tree = NBT::deserialize(bytes.data(), bytes.size());
+        CHECK(tree.name.has_value() && *tree.name == "player");
+        CHECK(tree.compoundElements.at("Health").getInt() == 20);
+        CHECK(tree.compoundElements.at("Inventory").listChildren[1].compoundElements.count("Slot") == 0);
+        CHECK(tree.compoundElements.at("History").listChildren[2].getIntVector() == std::vector<signed int>{3});
+    }
+
+    // and from a tree built by hand, with keys the schema doesn't know and keys of another tag type
+    NBT root(TAG_Compound);
+    root.emplaceCompoundChild("Health", TAG_Int).writeVal(7);
+    root.emplaceCompoundChild("Name", TAG_Int).writeVal(1);
+    root.emplaceCompoundChild("Unknown", TAG_Compound).emplaceCompoundChild("deep", TAG_List).listType = TAG_End;
+    NBT &pos = root.emplaceCompoundChild("Pos", TAG_List);
+    pos.listType = TAG_Float;
+    pos.emplaceListChild(TAG_Float).writeVal(1.0f);
+    std::vector<char> handBuilt = NBT::serialize(root);
+
+    SchemaPlayer decoded = samplePlayer();
+    CHECK(NBTBinding<SchemaPlayer>::deserialize(handBuilt.data(), handBuilt.size(), decoded));
+    CHECK(decoded.health == 7 && decoded.name == "Steve" && decoded.pos == player.pos);
+}
+
+TEST(schemaRejectsMalformedInput) {
+    std::vector<char> bytes = NBTBinding<SchemaPlayer>::serialize(samplePlayer());
+    SchemaPlayer decoded;
+
+    bool allRejected = true;
+    for (unsigned long size = 0; size < bytes.size(); size++) {
+        allRejected &= !NBTBinding<SchemaPlayer>::deserialize(bytes.data(), size, decoded);
+    }
+    CHECK(allRejected);
+
+    std::vector<char> compressed = NBTBinding<SchemaPlayer>::serialize(samplePlayer(), true);
+    CHECK(!NBTBinding<SchemaPlayer>::deserialize(compressed.data(), compressed.size() - 4, decoded));
+
+    const char notCompound[] = {TAG_Int, 0, 0, 0, 0, 0, 1};
+    CHECK(!NBTBinding<SchemaPlayer>::deserialize(notCompound, sizeof(notCompound), decoded));
+
+    // a list of compounds claiming a billion elements, known and unknown key
+    for (char name: {'I', 'Q'}) {
+        const char longList[] = {TAG_Compound, 0, 0, TAG_List, 0, 9, name, 'n', 'v', 'e', 'n', 't', 'o', 'r', 'y',
+                                 TAG_Compound, 0x40, 0, 0, 0, TAG_End, TAG_End};
+        CHECK(!NBTBinding<SchemaPlayer>::deserialize(longList, sizeof(longList), decoded));
+    }
+
+    // an unknown key nested past the depth limit
+    std::vector<char> deep = {TAG_Compound, 0, 0};
+    for (unsigned long i = 0; i < NBTSchemaDetail::MAX_DEPTH + 1; i++) {
+        deep.insert(deep.end(), {TAG_Compound, 0, 1, 'd'});
+    }
+    deep.insert(deep.end(), NBTSchemaDetail::MAX_DEPTH + 2, TAG_End);
+    CHECK(!NBTBinding<SchemaPlayer>::deserialize(deep.data(), deep.size(), decoded));
+}
+
+TEST(schemaSerializeIntoReportsSinkFailure) {
+    SchemaPlayer player = samplePlayer();
+    std::vector<char> expected = NBTBinding<SchemaPlayer>::serialize(player);
+
+    std::vector<char> buffer(expected.size());
+    BufferSink fits(buffer.data(), buffer.size());
+    CHECK(NBTBinding<SchemaPlayer>::serializeInto(player, fits) && buffer == expected);
+
+    BufferSink tooSmall(buffer.data(), buffer.size() - 1);
+    CHECK(!NBTBinding<SchemaPlayer>::serializeInto(player, tooSmall));
+}
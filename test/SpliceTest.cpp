@@ -0,0 +1,104 @@
+#include "Test.h"
+#include "NBT.h"
+#include "Compression.h"
+
+static std::string inflatedBigtest() {
+    std::string compressed = readFixture("bigtest.nbt");
+    std::string raw;
+    decompressBuffer(compressed.data(), compressed.size(), CompressionFormat::GZIP, raw);
+    return raw;
+}
+
+TEST(keepSourceRoundTripIsByteIdentical) {
+    std::string raw = inflatedBigtest();
+    CHECK(!raw.empty());
+
+    NBT root = NBT::deserialize(raw.data(), raw.size(), true);
+    CHECK(root.isSpliceable());
+    CHECK(NBT::serializedSize(root) == raw.size());
+    CHECK(bytesOf(NBT::serialize(root)) == raw);
+}
+
+TEST(editedNodeIsReencoded) {
+    std::string raw = inflatedBigtest();
+    NBT root = NBT::deserialize(raw.data(), raw.size(), true);
+
+    root.editCompoundChild("nested compound test").editCompoundChild("egg").editCompoundChild("value").writeVal(1.5f);
+    CHECK(!root.isSpliceable());
+    CHECK(root.compoundElements.at("nested compound test").compoundElements.at("ham").isSpliceable());
+
+    std::vector<char> bytes = NBT::serialize(root);
+    CHECK(bytes.size() == NBT::serializedSize(root));
+    CHECK(bytes.size() == raw.size());
+
+    NBT back = NBT::deserialize(bytes.data(), bytes.size());
+    CHECK(back.compoundElements.at("nested compound test").compoundElements.at("egg").compoundElements.at("value")
+                  .getFloat() == 1.5f);
+    CHECK(back.compoundElements.at("stringTest").getString() == root.compoundElements.at("stringTest").getString());
+}
+
+// edits through the public members only flag the node they're made on, the ancestors must still notice
+TEST(deepEditThroughPublicMembersIsWritten) {
+    std::string raw = inflatedBigtest();
+    NBT root = NBT::deserialize(raw.data(), raw.size(), true);
+
+    NBT &egg = root.compoundElements.at("nested compound test").compoundElements.at("egg");
+    egg.compoundElements.at("value").writeVal(2.5f);
+    root.compoundElements.at("listTest (compound)").listChildren.at(1).compoundElements.at("name")
+            .writeVal(std::string("edited"));
+
+    CHECK(!root.isSpliceable());
+    CHECK(!root.compoundElements.at("nested compound test").isSpliceable());
+    CHECK(egg.compoundElements.at("name").isSpliceable());
+    CHECK(root.compoundElements.at("listTest (long)").isSpliceable());
+
+    std::vector<char> bytes = NBT::serialize(root);
+    CHECK(bytes.size() == NBT::serializedSize(root));
+
+    NBT back = NBT::deserialize(bytes.data(), bytes.size());
+    CHECK(back.compoundElements.at("nested compound test").compoundElements.at("egg").compoundElements.at("value")
+                  .getFloat() == 2.5f);
+    CHECK(back.compoundElements.at("listTest (compound)").listChildren.at(1).compoundElements.at("name")
+                  .getString() == "edited");
+
+    // the same edits on a tree without source bytes encode identically
+    NBT plain = NBT::deserialize(raw.data(), raw.size());
+    plain.compoundElements.at("nested compound test").compoundElements.at("egg").compoundElements.at("value")
+            .writeVal(2.5f);
+    plain.compoundElements.at("listTest (compound)").listChildren.at(1).compoundElements.at("name")
+            .writeVal(std::string("edited"));
+    CHECK(NBT::serialize(plain) == bytes);
+}
+
+TEST(childrenChangedThroughPublicMembersAreWritten) {
+    std::string raw = inflatedBigtest();
+
+    // reordered
+    NBT swapped = NBT::deserialize(raw.data(), raw.size(), true);
+    std::vector<NBT> &longs = swapped.compoundElements.at("listTest (long)").listChildren;
+    std::swap(longs.front(), longs.back());
+    CHECK(!swapped.isSpliceable());
+    std::vector<char> bytes = NBT::serialize(swapped);
+    NBT back = NBT::deserialize(bytes.data(), bytes.size());
+    CHECK(back.compoundElements.at("listTest (long)").listChildren.front().getLong() == longs.front().getLong());
+
+    // removed
+    NBT removed = NBT::deserialize(raw.data(), raw.size(), true);
+    removed.compoundElements.at("listTest (compound)").listChildren.pop_back();
+    removed.compoundElements.erase("shortTest");
+    CHECK(!removed.isSpliceable());
+    bytes = NBT::serialize(removed);
+    back = NBT::deserialize(bytes.data(), bytes.size());
+    CHECK(back.compoundElements.at("listTest (compound)").listChildren.size() == 1);
+    CHECK(back.compoundElements.count("shortTest") == 0);
+
+    // replaced by an untouched node from another document
+    NBT other = NBT::deserialize(raw.data(), raw.size(), true);
+    NBT replaced = NBT::deserialize(raw.data(), raw.size(), true);
+    replaced.compoundElements.at("intTest") = other.compoundElements.at("longTest");
+    CHECK(!replaced.isSpliceable());
+    bytes = NBT::serialize(replaced);
+    back = NBT::deserialize(bytes.data(), bytes.size());
+    CHECK(back.compoundElements.at("intTest").tagID == TAG_Long);
+    CHECK(back.compoundElements.at("intTest").getLong() == other.compoundElements.at("longTest").getLong());
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <string>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTStats.h"
+
+static void expectedCounts(const NBT &nbt, unsigned long depth, NBTStats &stats) {
+    stats.tagCounts[(unsigned char) nbt.tagID]++;
+    stats.maxDepth = std::max(stats.maxDepth, depth);
+    for (const NBT &child: nbt.listChildren) {
+        expectedCounts(child, depth + 1, stats);
+    }
+    for (const auto &element: nbt.compoundElements) {
+        expectedCounts(element.second, depth + 1, stats);
+    }
+}
+
+static void recordSpan(const char *span, unsigned long, void *context) {
+    static_cast<std::vector<std::string> *>(context)->push_back(span);
+}
+
+static bool traced(const std::vector<std::string> &spans, const char *span) {
+    return std::find(spans.begin(), spans.end(), span) != spans.end();
+}
+
+TEST(statsRecordDeserializeAndSerialize) {
+    std::string stored = readFixture("bigtest.nbt");
+    NBT expectedTree = NBT::deserialize(stored.data(), stored.size());
+    std::vector<char> plain = NBT::serialize(expectedTree);
+    NBTStats expected;
+    expectedCounts(expectedTree, 1, expected);
+
+    // nothing is recorded while disabled
+    NBTStats::resetTotals();
+    NBTStats::setEnabled(false);
+    NBT::deserialize(stored.data(), stored.size());
+    CHECK(NBTStats::threadTotal().calls == 0);
+
+    std::vector<std::string> spans;
+    NBTStats::setEnabled(true);
+    NBTStats::setTraceCallback(recordSpan, &spans);
+
+    NBT root = NBT::deserialize(stored.data(), stored.size());
+    NBTStats deserialized = NBTStats::last();
+    CHECK(deserialized.calls == 1);
+    CHECK(deserialized.compressedBytes == stored.size());
+    CHECK(deserialized.uncompressedBytes == plain.size());
+    CHECK(std::equal(std::begin(expected.tagCounts), std::end(expected.tagCounts),
+                     std::begin(deserialized.tagCounts)));
+    CHECK(deserialized.maxDepth == expected.maxDepth);
+    CHECK(deserialized.bytesAllocated > 0 && deserialized.peakBytes >= deserialized.bytesAllocated);
+    CHECK(traced(spans, "inflate") && traced(spans, "build"));
+
+    // serialize -> serializeInto -> deflate sink is one call
+    spans.clear();
+    std::vector<char> compressed = NBT::serialize(root, true);
+    NBTStats serialized = NBTStats::last();
+    CHECK(serialized.calls == 1);
+    CHECK(serialized.uncompressedBytes == plain.size());
+    CHECK(serialized.compressedBytes == compressed.size());
+    CHECK(serialized.maxDepth == expected.maxDepth);
+    CHECK(traced(spans, "serialize") && traced(spans, "deflate") && !traced(spans, "inflate"));
+
+    NBTStats total = NBTStats::threadTotal();
+    CHECK(total.calls == 2);
+    CHECK(total.compressedBytes == stored.size() + compressed.size());
+    CHECK(total.uncompressedBytes == 2 * plain.size());
+    CHECK(total.maxDepth == expected.maxDepth);
+    CHECK(NBTStats::processTotal().calls == 2);
+
+    NBTStats::setTraceCallback(nullptr);
+    NBTStats::setEnabled(false);
+    NBTStats::resetTotals();
+    CHECK(NBTStats::threadTotal().calls == 0 && NBTStats::processTotal().calls == 0);
+}
+
+TEST(statsSumRecords) {
+    NBTStats a;
+    a.calls = 1;
+    a.compressedBytes = 10;
+    a.tagCounts[TAG_Int] = 3;
+    a.maxDepth = 4;
+    a.peakBytes = 100;
+
+    NBTStats b;
+    b.calls = 2;
+    b.compressedBytes = 5;
+    b.tagCounts[TAG_Int] = 1;
+    b.maxDepth = 2;
+    b.peakBytes = 300;
+
+    a += b;
+    CHECK(a.calls == 3 && a.compressedBytes == 15 && a.tagCounts[TAG_Int] == 4);
+    CHECK(a.maxDepth == 4 && a.peakBytes == 300);
+}
@@ -0,0 +1,215 @@
+#include <optional>
+#include <sstream>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTStreamParser.h"
+#include "BigEndian.h"
+
+// writes the events back out as uncompressed NBT, so a parse can be compared byte for byte with NBT::serialize
+class ReserializingHandler : public NBTHandler {
+public:
+    std::string bytes;
+
+    void onName(std::string_view name) override {
+        pendingName = std::string(name);
+    }
+
+    void onCompoundBegin() override {
+        header(TAG_Compound);
+    }
+
+    void onCompoundEnd() override {
+        bytes.push_back(TAG_End);
+    }
+
+    void onListBegin(char listType, signed int count) override {
+        header(TAG_List);
+        bytes.push_back(listType);
+        put(count);
+    }
+
+    void onByte(char value) override {
+        header(TAG_Byte);
+        bytes.push_back(value);
+    }
+
+    void onShort(signed short value) override {
+        header(TAG_Short);
+        put(value);
+    }
+
+    void onInt(signed int value) override {
+        header(TAG_Int);
+        put(value);
+    }
+
+    void onLong(signed long value) override {
+        header(TAG_Long);
+        put(value);
+    }
+
+    void onFloat(float value) override {
+        header(TAG_Float);
+        put(value);
+    }
+
+    void onDouble(double value) override {
+        header(TAG_Double);
+        put(value);
+    }
+
+    void onString(std::string_view value) override {
+        header(TAG_String);
+        put((unsigned short) value.size());
+        bytes.append(value);
+    }
+
+    void onByteArrayBegin(signed int count) override {
+        header(TAG_Byte_Array);
+        put(count);
+    }
+
+    void onByteArrayChunk(const char *values, unsigned long count) override {
+        bytes.append(values, count);
+        chunks++;
+    }
+
+    void onIntArrayBegin(signed int count) override {
+        header(TAG_Int_Array);
+        put(count);
+    }
+
+    void onIntArrayChunk(const signed int *values, unsigned long count) override {
+        for (unsigned long i = 0; i < count; i++) {
+            put(values[i]);
+        }
+        chunks++;
+    }
+
+    void onLongArrayBegin(signed int count) override {
+        header(TAG_Long_Array);
+        put(count);
+    }
+
+    void onLongArrayChunk(const signed long *values, unsigned long count) override {
+        for (unsigned long i = 0; i < count; i++) {
+            put(values[i]);
+        }
+        chunks++;
+    }
+
+    unsigned long chunks = 0;
+
+private:
+    // list elements come without a name and without a header
+    std::optional<std::string> pendingName;
+
+    void header(char tagID) {
+        if (!pendingName)
+            return;
+        bytes.push_back(tagID);
+        put((unsigned short) pendingName->size());
+        bytes.append(*pendingName);
+        pendingName.reset();
+    }
+
+    template<typename T>
+    void put(const T &value) {
+        char buffer[sizeof(T)];
+        writeBigEndian(buffer, value);
+        bytes.append(buffer, sizeof(T));
+    }
+};
+
+static bool feedInChunks(NBTStreamParser &parser, const char *bytes, unsigned long size, unsigned long chunkSize) {
+    for (unsigned long offset = 0; offset < size; offset += chunkSize) {
+        if (!parser.feed(bytes + offset, std::min(chunkSize, size - offset)))
+            return false;
+    }
+    return parser.finish();
+}
+
+// arrays several times the smallest window, so they arrive in many chunks
+static NBT largeArrayDocument() {
+    NBT root(TAG_Compound);
+    root.name = NBTAtom("arrays");
+    std::vector<long> longs(100000);
+    std::vector<int> ints(70000);
+    std::vector<char> bytes(300000);
+    for (unsigned long i = 0; i < longs.size(); i++) {
+        longs[i] = (long) (i * 0x9E3779B97F4A7C15ul);
+    }
+    for (unsigned long i = 0; i < ints.size(); i++) {
+        ints[i] = (int) (i * 2654435761u);
+    }
+    for (unsigned long i = 0; i < bytes.size(); i++) {
+        bytes[i] = (char) (i * 31);
+    }
+    root.emplaceCompoundChild("longs", TAG_Long_Array).writeVal(longs);
+    root.emplaceCompoundChild("ints", TAG_Int_Array).writeVal(ints);
+    root.emplaceCompoundChild("bytes", TAG_Byte_Array).writeVal(bytes);
+    root.emplaceCompoundChild("after", TAG_String).writeVal(std::string(60000, 'x'));
+    return root;
+}
+
+TEST(streamParserMatchesSerialize) {
+    std::vector<std::pair<std::string, std::string>> inputs;
+    for (const char *fixture: {"bigtest.nbt", "hello_world.nbt", "Player-nan-value.dat"}) {
+        std::string stored = readFixture(fixture);
+        inputs.emplace_back(stored, bytesOf(NBT::serialize(NBT::deserialize(stored.data(), stored.size()))));
+    }
+    std::string large = bytesOf(NBT::serialize(largeArrayDocument()));
+    inputs.emplace_back(large, large);
+    inputs.emplace_back(bytesOf(NBT::serialize(largeArrayDocument(), true)), large);
+
+    for (auto &[input, expected]: inputs) {
+        // single bytes only on the small inputs, the large ones would take a while
+        for (unsigned long chunkSize: {1ul, 7ul, 4096ul, input.size()}) {
+            if (chunkSize == 1 && input.size() > 10000)
+                continue;
+
+            ReserializingHandler handler;
+            NBTStreamParser parser(handler, NBTStreamParser::MIN_WINDOW_SIZE);
+            CHECK(feedInChunks(parser, input.data(), input.size(), chunkSize));
+            CHECK(parser.done() && !parser.failed());
+            CHECK(parser.bytesParsed() == expected.size());
+            CHECK(handler.bytes == expected);
+        }
+    }
+
+    ReserializingHandler handler;
+    NBTStreamParser parser(handler, NBTStreamParser::MIN_WINDOW_SIZE);
+    std::istringstream stream(inputs.back().first);
+    CHECK(parser.parse(stream, 1000));
+    CHECK(handler.bytes == large && handler.chunks > 3);
+}
+
+TEST(streamParserRejectsTruncatedInput) {
+    std::string stored = readFixture("bigtest.nbt");
+    NBT document = NBT::deserialize(stored.data(), stored.size());
+    std::vector<char> plain = NBT::serialize(document);
+    std::vector<char> compressed = NBT::serialize(document, true);
+
+    bool allRejected = true;
+    for (unsigned long size = 0; size < plain.size(); size++) {
+        ReserializingHandler handler;
+        NBTStreamParser parser(handler);
+        allRejected &= !feedInChunks(parser, plain.data(), size, 64) && !parser.done();
+    }
+    CHECK(allRejected);
+
+    // cut inside the deflate stream, inside the trailer and between the two
+    for (unsigned long size: {compressed.size() / 2, compressed.size() - 8, compressed.size() - 3}) {
+        ReserializingHandler handler;
+        NBTStreamParser parser(handler);
+        CHECK(!feedInChunks(parser, compressed.data(), size, 100) && !parser.done());
+    }
+
+    // anything after the root compound is ignored, as NBT::deserialize does
+    std::vector<char> twice = plain;
+    twice.insert(twice.end(), plain.begin(), plain.end());
+    ReserializingHandler handler;
+    NBTStreamParser parser(handler);
+    CHECK(feedInChunks(parser, twice.data(), twice.size(), 64));
+    CHECK(handler.bytes == bytesOf(plain));
+}
@@ -0,0 +1,84 @@
+#include "Test.h"
+#include "NBT.h"
+#include "NBTTape.h"
+
+// lists of lists of strings and lists of compounds holding lists, so the children of nested lists interleave on
+// the tape
+static NBT nestedDocument() {
+    NBT root(TAG_Compound);
+
+    NBT &outer = root.emplaceCompoundChild("outer", TAG_List);
+    outer.listType = TAG_List;
+    for (signed int i = 0; i < 20; i++) {
+        NBT &inner = outer.emplaceListChild(TAG_List);
+        inner.listType = TAG_String;
+        for (signed int j = 0; j < i; j++) {
+            inner.emplaceListChild(TAG_String).writeVal("s" + std::to_string(i) + "." + std::to_string(j));
+        }
+    }
+
+    NBT &compounds = root.emplaceCompoundChild("compounds", TAG_List);
+    compounds.listType = TAG_Compound;
+    for (signed int i = 0; i < 30; i++) {
+        NBT &compound = compounds.emplaceListChild(TAG_Compound);
+        compound.emplaceCompoundChild("id", TAG_Int).writeVal(i);
+
+        NBT &items = compound.emplaceCompoundChild("items", TAG_List);
+        items.listType = TAG_Compound;
+        for (signed int j = 0; j < i % 5; j++) {
+            items.emplaceListChild(TAG_Compound).emplaceCompoundChild("slot", TAG_Byte).writeVal((char) j);
+        }
+    }
+
+    root.emplaceCompoundChild("emptyCompound", TAG_Compound);
+    root.emplaceCompoundChild("emptyList", TAG_List).listType = TAG_Compound;
+    return root;
+}
+
+// counts and indexed lookups agree with walking the siblings, everywhere in the tree
+static bool matchesSiblingWalk(const NBTTapeNode &node) {
+    if (node.tagID() != TAG_Compound && node.tagID() != TAG_List)
+        return true;
+
+    bool ok = true;
+    signed int walked = 0;
+    for (NBTTapeNode child = node.firstChild(); child.valid(); child = child.nextSibling()) {
+        if (node.tagID() == TAG_List)
+            ok &= node[walked].index() == child.index();
+        ok &= matchesSiblingWalk(child);
+        walked++;
+    }
+
+    if (node.tagID() == TAG_Compound) {
+        ok &= node.childrenCount() == walked;
+    } else if (walked > 0) {
+        ok &= node.childrenCount() == walked && !node[walked].valid() && !node[-1].valid();
+    }
+    return ok;
+}
+
+TEST(tapeIndexesListsAndCountsCompounds) {
+    std::vector<char> nested = NBT::serialize(nestedDocument());
+    std::string bigtest = readFixture("bigtest.nbt");
+
+    NBTTape tape;
+    CHECK(tape.build(nested.data(), nested.size()));
+    CHECK(matchesSiblingWalk(tape.root()));
+    CHECK(tape.root()["outer"][7][3].view().getString() == "s7.3");
+    CHECK(tape.root()["compounds"][29]["id"].view().getInt() == 29);
+    CHECK(tape.root()["emptyCompound"].childrenCount() == 0);
+    CHECK(!tape.root()["emptyList"][0].valid());
+
+    NBTTape fixtureTape;
+    CHECK(fixtureTape.build(bigtest));
+    CHECK(matchesSiblingWalk(fixtureTape.root()));
+}
+
+TEST(tapeRejectsListCountsPastTheBuffer) {
+    // a list of compounds claiming a billion elements in a 14 byte document
+    const char bytes[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Compound, 0x40, 0, 0, 0, TAG_End, TAG_End};
+
+    NBTTape tape;
+    CHECK(!tape.build(bytes, sizeof(bytes)));
+    CHECK(tape.empty());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef NBT_DATA_DIR
+#define NBT_DATA_DIR "lib/nbtdata"
+#endif
+
+// just enough of a harness for NBeeTeaTest: TEST(name) registers a test, CHECK records a failure and carries on
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testRegistry();
+
+extern unsigned long testFailures;
+
+struct TestRegistration {
+    TestRegistration(const char *name, void (*run)()) {
+        testRegistry().push_back({name, run});
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures++; \
+        } \
+    } while (false)
+
+// a file from lib/nbtdata, empty if it's missing (which the tests using it then fail on)
+inline std::string readFixture(const std::string &name) {
+    std::ifstream file(std::string(NBT_DATA_DIR) + "/" + name, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+inline std::string bytesOf(const std::vector<char> &bytes) {
+    return std::string(bytes.begin(), bytes.end());
+}
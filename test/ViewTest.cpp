@@ -0,0 +1,144 @@
+#include <cmath>
+#include "Test.h"
+#include "NBT.h"
+#include "NBTView.h"
+
+static bool sameFloat(double a, double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+template<typename T, typename Get>
+static bool copiesListValues(const NBTView &view, NBT &list, Get get) {
+    std::vector<T> values(list.listChildren.size() + 1);
+    if (view.copyValues(values.data(), values.size()) != list.listChildren.size())
+        return false;
+
+    bool ok = true;
+    for (unsigned long i = 0; i < list.listChildren.size(); i++) {
+        ok &= sameFloat((double) values[i], (double) get(list.listChildren[i]));
+    }
+    return ok;
+}
+
+// the view agrees with the deserialized tree on every tag, name, value and count, walking both
+static bool matchesTree(const NBTView &view, NBT &nbt) {
+    if (!view.valid() || view.tagID() != nbt.tagID)
+        return false;
+
+    switch (nbt.tagID) {
+        case TAG_Byte:
+            return view.getByte() == nbt.getByte();
+        case TAG_Short:
+            return view.getShort() == nbt.getShort();
+        case TAG_Int:
+            return view.getInt() == nbt.getInt();
+        case TAG_Long:
+            return view.getLong() == nbt.getLong();
+        case TAG_Float:
+            return sameFloat(view.getFloat(), nbt.getFloat());
+        case TAG_Double:
+            return sameFloat(view.getDouble(), nbt.getDouble());
+        case TAG_String:
+            return view.getString() == nbt.getString();
+        case TAG_Byte_Array: {
+            std::vector<char> bytes = nbt.getByteVector();
+            bool ok = view.arraySize() == (signed int) bytes.size();
+            for (signed int i = 0; ok && i < view.arraySize(); i++) {
+                ok &= view.getByteArrayElement(i) == bytes[i] && view[i].getByte() == bytes[i];
+            }
+            return ok;
+        }
+        case TAG_Int_Array: {
+            std::vector<signed int> ints = nbt.getIntVector();
+            std::vector<signed int> copied(ints.size());
+            bool ok = view.copyValues(copied.data(), copied.size()) == ints.size() && copied == ints;
+            for (signed int i = 0; ok && i < view.arraySize(); i++) {
+                ok &= view.getIntArrayElement(i) == ints[i] && view[i].getInt() == ints[i];
+            }
+            return ok;
+        }
+        case TAG_Long_Array: {
+            std::vector<signed long> longs = nbt.getLongVector();
+            std::vector<signed long> copied(longs.size());
+            bool ok = view.copyValues(copied.data(), copied.size()) == longs.size() && copied == longs;
+            for (signed int i = 0; ok && i < view.arraySize(); i++) {
+                ok &= view.getLongArrayElement(i) == longs[i] && view[i].getLong() == longs[i];
+            }
+            return ok;
+        }
+        case TAG_List: {
+            bool ok = view.listType() == nbt.listType && view.childrenCount() == (signed int) nbt.listChildren.size();
+            unsigned long index = 0;
+            for (const NBTView &child: view) {
+                ok &= index < nbt.listChildren.size() && child.name().empty() &&
+                      matchesTree(child, nbt.listChildren[index]);
+                index++;
+            }
+            ok &= index == nbt.listChildren.size();
+            if (!ok || index == 0)
+                return ok;
+
+            ok &= matchesTree(view[(signed int) index - 1], nbt.listChildren.back());
+            switch (nbt.listType) {
+                case TAG_Short:
+                    return ok && copiesListValues<signed short>(view, nbt, [](NBT &e) { return e.getShort(); });
+                case TAG_Int:
+                    return ok && copiesListValues<signed int>(view, nbt, [](NBT &e) { return e.getInt(); });
+                case TAG_Long:
+                    return ok && copiesListValues<signed long>(view, nbt, [](NBT &e) { return e.getLong(); });
+                case TAG_Float:
+                    return ok && copiesListValues<float>(view, nbt, [](NBT &e) { return e.getFloat(); });
+                case TAG_Double:
+                    return ok && copiesListValues<double>(view, nbt, [](NBT &e) { return e.getDouble(); });
+                default:
+                    return ok;
+            }
+        }
+        case TAG_Compound: {
+            bool ok = view.childrenCount() == (signed int) nbt.compoundElements.size();
+            for (const NBTView &child: view) {
+                auto element = nbt.compoundElements.find(NBTAtom(child.name()));
+                ok &= element != nbt.compoundElements.end() && matchesTree(child, element->second) &&
+                      view[child.name()].payloadBegin() == child.payloadBegin();
+            }
+            return ok;
+        }
+        default:
+            return false;
+    }
+}
+
+TEST(viewMatchesDeserialize) {
+    for (const char *fixture: {"bigtest.nbt", "hello_world.nbt", "Player-nan-value.dat"}) {
+        std::string stored = readFixture(fixture);
+        NBT expected = NBT::deserialize(stored.data(), stored.size());
+        // views read uncompressed buffers
+        std::vector<char> bytes = NBT::serialize(expected);
+
+        NBTView root = NBTView::root(bytes.data(), bytes.size());
+        CHECK(root.valid() && expected.name.has_value() && *expected.name == root.name());
+        CHECK(root.payloadEnd() == bytes.data() + bytes.size());
+        CHECK(matchesTree(root, expected));
+        CHECK(NBT::serialize(root.toNBT()) == bytes);
+        CHECK(!root["missing"].valid());
+    }
+}
+
+TEST(viewCopyValuesStopsAtCount) {
+    NBT root(TAG_Compound);
+    root.emplaceCompoundChild("longs", TAG_Long_Array).writeVal(std::vector<long>{1, -2, 3, -4, 5});
+    NBT &doubles = root.emplaceCompoundChild("doubles", TAG_List);
+    doubles.listType = TAG_Double;
+    for (signed int i = 0; i < 9; i++) {
+        doubles.emplaceListChild(TAG_Double).writeVal(i * 0.5);
+    }
+    std::vector<char> bytes = NBT::serialize(root);
+    NBTView view = NBTView::root(bytes.data(), bytes.size());
+
+    signed long longs[3] = {};
+    CHECK(view["longs"].copyValues(longs, 3) == 3 && longs[0] == 1 && longs[1] == -2 && longs[2] == 3);
+
+    double values[4] = {};
+    CHECK(view["doubles"].copyValues(values, 4) == 4 && values[3] == 1.5);
+    CHECK(view["doubles"][8].getDouble() == 4.0 && !view["doubles"][9].valid());
+}